@@ -0,0 +1,78 @@
+#include "BenchCommon.hpp"
+#include "vcm/BufferArena.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Buffers allocated, then released, per iteration
+constexpr size_t BATCH = 256;
+
+constexpr int64_t MIN_BYTES = 256;
+constexpr int64_t MAX_BYTES = 64 << 10;
+
+constexpr auto USAGE = vk::BufferUsageFlagBits::eStorageBuffer |
+                       vk::BufferUsageFlagBits::eTransferSrc |
+                       vk::BufferUsageFlagBits::eTransferDst;
+
+// A VkBuffer and VMA allocation per tensor, as createBuffer() does
+void BM_AllocateBuffers(benchmark::State &state) {
+  const auto bytes = static_cast<size_t>(state.range(0));
+  auto &manager = vcm::bench::manager();
+  std::vector<vcm::Buffer<std::byte>> buffers;
+  buffers.reserve(BATCH);
+  for (auto _ : state) {
+    for (size_t i = 0; i < BATCH; ++i) {
+      buffers.push_back(manager.createBuffer<std::byte>(bytes, USAGE));
+    }
+    buffers.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH);
+}
+BENCHMARK(BM_AllocateBuffers)
+    ->RangeMultiplier(4)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->Unit(benchmark::kMicrosecond);
+
+// Slices of an arena's blocks, allocated and freed one by one
+void BM_AllocateArena(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  vcm::BufferArena arena(vcm::bench::manager());
+  std::vector<vcm::ArenaSlice> slices;
+  slices.reserve(BATCH);
+  for (auto _ : state) {
+    for (size_t i = 0; i < BATCH; ++i) {
+      slices.push_back(arena.allocate(bytes));
+    }
+    for (const auto &slice : slices) {
+      arena.free(slice);
+    }
+    slices.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH);
+}
+BENCHMARK(BM_AllocateArena)
+    ->RangeMultiplier(4)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->Unit(benchmark::kMicrosecond);
+
+// Frame slices of an arena, bump allocated and released by one reset
+void BM_AllocateArenaFrame(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  vcm::BufferArena arena(vcm::bench::manager());
+  for (auto _ : state) {
+    for (size_t i = 0; i < BATCH; ++i) {
+      benchmark::DoNotOptimize(arena.allocateFrame(bytes));
+    }
+    arena.resetFrame();
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH);
+}
+BENCHMARK(BM_AllocateArenaFrame)
+    ->RangeMultiplier(4)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
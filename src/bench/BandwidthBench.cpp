@@ -0,0 +1,113 @@
+#include "BenchCommon.hpp"
+#include "vcm/TypedElementwise.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+namespace {
+
+using vcm::bench::BenchBuffer;
+
+constexpr int64_t MIN_BYTES = 1 << 20;  // 1 MiB
+constexpr int64_t MAX_BYTES = 1 << 28;  // 256 MiB
+
+/*
+Bytes/s of large device to device copies, read plus written, as the peak
+memory throughput. Vulkan does not report the theoretical peak, and a
+copyBuffer is the closest to it the driver offers. Measured once.
+*/
+double referenceBytesPerSecond() {
+  static const double reference = [] {
+    constexpr vk::DeviceSize bytes = MAX_BYTES;
+    constexpr int copies = 4;
+    const BenchBuffer src(bytes);
+    const BenchBuffer dst(bytes);
+    if (!src.valid() || !dst.valid()) {
+      return 0.0;
+    }
+
+    auto &manager = vcm::bench::manager();
+    double best = 0.0;
+    for (int run = 0; run < 3; ++run) {
+      auto commandBuffer = manager.beginOneTimeCommands();
+      for (int i = 0; i < copies; ++i) {
+        commandBuffer.copyBuffer(src.buffer(), dst.buffer(),
+                                 vk::BufferCopy(0, 0, bytes));
+      }
+      const auto start = std::chrono::steady_clock::now();
+      manager.submitOneTime(commandBuffer).wait();
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      best = std::max(best, 2.0 * copies * static_cast<double>(bytes) /
+                                elapsed.count());
+    }
+    return best;
+  }();
+  return reference;
+}
+
+// out = in * in over state.range(0) bytes of elements of type, with 4 or 1
+// words per thread
+void BM_TypedSquare(benchmark::State &state, std::string_view type,
+                    bool vectorized) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  const BenchBuffer in(bytes);
+  const BenchBuffer out(bytes);
+  if (!in.valid() || !out.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+
+  auto &manager = vcm::bench::manager();
+  auto &kernel = vcm::getTypedKernel(manager, vcm::ElementwiseOp::Square,
+                                     type, vectorized);
+  state.counters["workgroupSize"] = kernel.workgroupSize()[0];
+  const auto units = static_cast<uint32_t>(
+      bytes / (vectorized ? 4 * sizeof(uint32_t) : sizeof(uint32_t)));
+
+  auto commandBuffer = manager.get_device()
+                           .allocateCommandBuffers(
+                               {manager.get_commandPool(),
+                                vk::CommandBufferLevel::ePrimary, 1})
+                           .front();
+  commandBuffer.begin(vk::CommandBufferBeginInfo{});
+  kernel.dispatchElements(commandBuffer, kernel.bind(in.buffer(), out.buffer()),
+                          units);
+  commandBuffer.end();
+
+  for (auto _ : state) {
+    manager.submitAsync(commandBuffer).wait();
+  }
+
+  // Read and written
+  const auto traffic = static_cast<double>(2 * bytes);
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(traffic));
+  if (const auto reference = referenceBytesPerSecond(); reference > 0) {
+    state.counters["peakFraction"] = benchmark::Counter(
+        traffic / reference, benchmark::Counter::kIsIterationInvariantRate);
+  }
+
+  manager.get_device().freeCommandBuffers(manager.get_commandPool(),
+                                          commandBuffer);
+}
+
+#define VCM_TYPED_BENCHMARK(type)                                              \
+  BENCHMARK_CAPTURE(BM_TypedSquare, type##_x4, #type, true)                    \
+      ->RangeMultiplier(4)                                                     \
+      ->Range(MIN_BYTES, MAX_BYTES)                                            \
+      ->UseRealTime()                                                          \
+      ->Unit(benchmark::kMicrosecond);                                         \
+  BENCHMARK_CAPTURE(BM_TypedSquare, type##_x1, #type, false)                   \
+      ->RangeMultiplier(4)                                                     \
+      ->Range(MIN_BYTES, MAX_BYTES)                                            \
+      ->UseRealTime()                                                          \
+      ->Unit(benchmark::kMicrosecond)
+
+VCM_TYPED_BENCHMARK(float);
+VCM_TYPED_BENCHMARK(half);
+VCM_TYPED_BENCHMARK(int16);
+VCM_TYPED_BENCHMARK(uint8);
+
+} // namespace
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "vcm/Buffer.hpp"
+#include "vcm/VulkanComputeManager.hpp"
+#include <cstddef>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm::bench {
+
+// One manager for the whole run, so instance and device creation are not
+// measured by every benchmark
+VulkanComputeManager &manager();
+
+/*
+Buffer for a benchmark's lifetime. Device local unless hostVisible, usable
+as a storage buffer and copy source/destination. Allocation failure (sizes
+beyond what the device has) leaves it invalid rather than throwing, so
+benchmarks can skip that size.
+*/
+class BenchBuffer {
+public:
+  explicit BenchBuffer(vk::DeviceSize bytes, bool hostVisible = false);
+
+  BenchBuffer(const BenchBuffer &) = delete;
+  BenchBuffer(BenchBuffer &&) = delete;
+  BenchBuffer &operator=(const BenchBuffer &) = delete;
+  BenchBuffer &operator=(BenchBuffer &&) = delete;
+
+  ~BenchBuffer();
+
+  [[nodiscard]] bool valid() const { return m_buffer.buffer != VK_NULL_HANDLE; }
+  [[nodiscard]] vk::Buffer buffer() const { return m_buffer.buffer; }
+  [[nodiscard]] VmaAllocation allocation() const {
+    return m_buffer.allocation;
+  }
+  [[nodiscard]] vk::DeviceSize size() const { return m_size; }
+
+private:
+  VcmBuffer m_buffer;
+  vk::DeviceSize m_size;
+};
+
+} // namespace vcm::bench
@@ -0,0 +1,79 @@
+#include "BenchCommon.hpp"
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vcm::bench {
+
+VulkanComputeManager &manager() {
+  static VulkanComputeManager instance;
+  return instance;
+}
+
+namespace {
+
+VcmBuffer createBuffer(vk::DeviceSize bytes, bool hostVisible) {
+  vk::BufferCreateInfo createInfo{vk::BufferCreateFlags(), bytes,
+                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                      vk::BufferUsageFlagBits::eTransferSrc |
+                                      vk::BufferUsageFlagBits::eTransferDst,
+                                  vk::SharingMode::eExclusive};
+  VmaAllocationCreateInfo allocInfo{};
+  if (hostVisible) {
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+  } else {
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+  }
+  return {manager().get_allocator(), createInfo, allocInfo};
+}
+
+} // namespace
+
+BenchBuffer::BenchBuffer(vk::DeviceSize bytes, bool hostVisible)
+    : m_buffer(createBuffer(bytes, hostVisible)), m_size(bytes) {}
+
+BenchBuffer::~BenchBuffer() {
+  if (valid()) {
+    manager().get_descriptorSetCache().forget(m_buffer.buffer);
+    m_buffer.destroy(manager().get_allocator());
+  }
+}
+
+} // namespace vcm::bench
+
+// Google Benchmark's main, writing JSON results to vcm_bench.json unless the
+// command line already chooses an output file
+int main(int argc, char **argv) {
+  std::vector<char *> args(argv, argv + argc);
+  bool hasOut = false;
+  for (const char *arg : args) {
+    hasOut |= std::string_view(arg).starts_with("--benchmark_out=");
+  }
+  std::string out = "--benchmark_out=vcm_bench.json";
+  std::string format = "--benchmark_out_format=json";
+  if (!hasOut) {
+    args.push_back(out.data());
+    args.push_back(format.data());
+  }
+  int count = static_cast<int>(args.size());
+
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+    return 1;
+  }
+
+  // Record which device the numbers are for
+  const auto properties =
+      vcm::bench::manager().get_physicalDevice().getProperties();
+  benchmark::AddCustomContext("vcm_device",
+                              std::string(properties.deviceName.data()));
+  benchmark::AddCustomContext(
+      "vcm_driver_version", fmt::format("{:#x}", properties.driverVersion));
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "BenchCommon.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Elements of each small buffer
+constexpr uint32_t ELEMENTS = 1024;
+
+constexpr auto USAGE = vk::BufferUsageFlagBits::eStorageBuffer;
+
+// Distinct input and output buffers for each launch, as with many small
+// tensors
+struct Launches {
+  std::vector<vcm::Buffer<int>> in1;
+  std::vector<vcm::Buffer<int>> in2;
+  std::vector<vcm::Buffer<int>> out;
+
+  explicit Launches(size_t count) {
+    auto &manager = vcm::bench::manager();
+    for (size_t i = 0; i < count; ++i) {
+      in1.push_back(manager.createBuffer<int>(ELEMENTS, USAGE));
+      in2.push_back(manager.createBuffer<int>(ELEMENTS, USAGE));
+      out.push_back(manager.createBuffer<int>(ELEMENTS, USAGE));
+    }
+  }
+};
+
+// A fresh descriptor set allocated and written for every launch, recycled
+// once the batch is done
+void BM_LaunchDescriptorSets(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel("shaders/add.spv");
+  const Launches launches(count);
+
+  for (auto _ : state) {
+    auto commandBuffer = manager.beginOneTimeCommands();
+    for (size_t i = 0; i < count; ++i) {
+      const auto descriptorSet =
+          manager.allocateDescriptorSet(kernel.descriptorSetLayout());
+      kernel.write(descriptorSet, launches.in1[i], launches.in2[i],
+                   launches.out[i]);
+      kernel.dispatchElements(commandBuffer, descriptorSet, ELEMENTS);
+    }
+    manager.submitOneTime(commandBuffer).wait();
+    manager.resetDescriptorPools();
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_LaunchDescriptorSets)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// Sets from the descriptor set cache: written once, then a lookup per launch
+void BM_LaunchCachedSets(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel("shaders/add.spv");
+  const Launches launches(count);
+
+  for (auto _ : state) {
+    auto commandBuffer = manager.beginOneTimeCommands();
+    for (size_t i = 0; i < count; ++i) {
+      kernel.dispatchElements(
+          commandBuffer,
+          kernel.bind(launches.in1[i], launches.in2[i], launches.out[i]),
+          ELEMENTS);
+    }
+    manager.submitOneTime(commandBuffer).wait();
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_LaunchCachedSets)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// Buffer addresses in push constants: no descriptors at all
+void BM_LaunchAddresses(benchmark::State &state) {
+  auto &manager = vcm::bench::manager();
+  if (!manager.supportsBufferDeviceAddress()) {
+    state.SkipWithError("buffer device addresses not supported");
+    return;
+  }
+  const auto count = static_cast<size_t>(state.range(0));
+  auto &kernel = manager.getKernel("shaders/bindless_add.spv");
+  const Launches launches(count);
+
+  for (auto _ : state) {
+    auto commandBuffer = manager.beginOneTimeCommands();
+    for (size_t i = 0; i < count; ++i) {
+      kernel.dispatchAddresses(commandBuffer, ELEMENTS, launches.in1[i],
+                               launches.in2[i], launches.out[i]);
+    }
+    manager.submitOneTime(commandBuffer).wait();
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_LaunchAddresses)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,126 @@
+#include "BenchCommon.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <thread>
+
+namespace {
+
+using vcm::bench::BenchBuffer;
+
+// Record, submit and wait for a single empty dispatch: the round trip
+// latency of the smallest possible unit of GPU work
+void BM_EmptyDispatchLatency(benchmark::State &state) {
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel("shaders/empty.spv");
+  const auto descriptorSet = kernel.bind();
+
+  for (auto _ : state) {
+    auto commandBuffer = manager.beginOneTimeCommands();
+    kernel.dispatch(commandBuffer, descriptorSet, 1);
+    manager.submitOneTime(commandBuffer).wait();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EmptyDispatchLatency)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Submit and wait for a pre-recorded command buffer with an empty dispatch:
+// latency without recording
+void BM_EmptySubmitLatency(benchmark::State &state) {
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel("shaders/empty.spv");
+  const auto descriptorSet = kernel.bind();
+
+  auto commandBuffer = manager.get_device()
+                           .allocateCommandBuffers(
+                               {manager.get_commandPool(),
+                                vk::CommandBufferLevel::ePrimary, 1})
+                           .front();
+  commandBuffer.begin(vk::CommandBufferBeginInfo{});
+  kernel.dispatch(commandBuffer, descriptorSet, 1);
+  commandBuffer.end();
+
+  for (auto _ : state) {
+    manager.submitAsync(commandBuffer).wait();
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  manager.get_device().freeCommandBuffers(manager.get_commandPool(),
+                                          commandBuffer);
+}
+BENCHMARK(BM_EmptySubmitLatency)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Throughput of recording dispatches into secondary command buffers, one
+// task per thread, each on its thread's own command pool
+void BM_RecordParallel(benchmark::State &state) {
+  constexpr size_t dispatchesPerIteration = 1 << 14;
+  const auto threads = static_cast<size_t>(state.range(0));
+
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel("shaders/empty.spv");
+  const auto descriptorSet = kernel.bind();
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    manager.resetCommandPools();
+    auto primary = manager.allocateCommandBuffer();
+    primary.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    state.ResumeTiming();
+
+    manager.recordParallel(
+        primary, threads, [&](vk::CommandBuffer secondary, size_t) {
+          for (size_t i = 0; i < dispatchesPerIteration / threads; ++i) {
+            kernel.dispatch(secondary, descriptorSet, 1);
+          }
+        });
+    primary.end();
+  }
+  manager.resetCommandPools();
+
+  state.SetItemsProcessed(state.iterations() * dispatchesPerIteration);
+}
+BENCHMARK(BM_RecordParallel)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1U, std::thread::hardware_concurrency()))
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Descriptor set per dispatch from the cache: a hash lookup, no writes
+void BM_DescriptorSetCached(benchmark::State &state) {
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel("shaders/square.spv");
+  const BenchBuffer in(1024);
+  const BenchBuffer out(1024);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(kernel.bind(in.buffer(), out.buffer()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DescriptorSetCached);
+
+// Descriptor set per dispatch allocated from the per-frame allocator and
+// written every time
+void BM_DescriptorSetAllocateWrite(benchmark::State &state) {
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel("shaders/square.spv");
+  const BenchBuffer in(1024);
+  const BenchBuffer out(1024);
+
+  size_t allocated = 0;
+  for (auto _ : state) {
+    const auto descriptorSet =
+        manager.allocateDescriptorSet(kernel.descriptorSetLayout());
+    kernel.write(descriptorSet, in.buffer(), out.buffer());
+
+    // Recycle like a frame boundary would
+    if (++allocated == 4096) {
+      manager.resetDescriptorPools();
+      allocated = 0;
+    }
+  }
+  manager.resetDescriptorPools();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DescriptorSetAllocateWrite);
+
+} // namespace
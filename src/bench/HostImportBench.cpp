@@ -0,0 +1,139 @@
+#include "BenchCommon.hpp"
+#include "vcm/HostImport.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+constexpr int64_t MIN_BYTES = 64 << 10;  // 64 KiB
+constexpr int64_t MAX_BYTES = 256 << 20; // 256 MiB
+
+enum class Path {
+  // Device copies made once, data staged in and out every frame
+  Staged,
+  // Host frames imported once
+  Imported,
+  // Host frames imported every frame, as when each frame arrives in a new
+  // allocation
+  ImportedPerFrame,
+};
+
+struct AlignedFree {
+  void operator()(std::byte *pointer) const {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer); // NOLINT
+#endif
+  }
+};
+
+// Page aligned host allocation, like frames from a capture API
+std::unique_ptr<std::byte, AlignedFree> alignedHostAlloc(size_t bytes,
+                                                         size_t alignment) {
+#ifdef _WIN32
+  void *pointer = _aligned_malloc(bytes, alignment);
+#else
+  void *pointer = std::aligned_alloc(alignment, bytes);
+#endif
+  return std::unique_ptr<std::byte, AlignedFree>(
+      static_cast<std::byte *>(pointer));
+}
+
+// Host frame -> square kernel -> host frame. Items are int32 elements.
+void runHostFrames(benchmark::State &state, Path path) {
+  auto &manager = vcm::bench::manager();
+  if (path != Path::Staged && !manager.supportsHostImport()) {
+    state.SkipWithError("VK_EXT_external_memory_host not supported");
+    return;
+  }
+
+  const auto alignment = std::max<size_t>(
+      manager.get_minImportedHostPointerAlignment(), size_t{4096});
+  const auto bytes = (static_cast<size_t>(state.range(0)) + alignment - 1) /
+                     alignment * alignment;
+  const auto elements = static_cast<uint32_t>(bytes / sizeof(int32_t));
+
+  auto &kernel = manager.getKernel("shaders/square.spv");
+
+  const auto inHost = alignedHostAlloc(bytes, alignment);
+  const auto outHost = alignedHostAlloc(bytes, alignment);
+  if (!inHost || !outHost) {
+    state.SkipWithError("host allocation failed");
+    return;
+  }
+  std::fill_n(inHost.get(), bytes, std::byte{1});
+  const std::span in(inHost.get(), bytes);
+  const std::span out(outHost.get(), bytes);
+
+  const bool allowImport = path != Path::Staged;
+  vcm::HostBuffer inBuffer;
+  vcm::HostBuffer outBuffer;
+  const auto import = [&] {
+    inBuffer = manager.importHostMemory(
+        in, vk::BufferUsageFlagBits::eStorageBuffer, allowImport);
+    outBuffer = manager.importHostMemory(
+        out, vk::BufferUsageFlagBits::eStorageBuffer, allowImport);
+  };
+  import();
+  if (allowImport && !inBuffer.imported()) {
+    state.SkipWithError("host memory import failed");
+    return;
+  }
+
+  for (auto _ : state) {
+    if (path == Path::ImportedPerFrame) {
+      import();
+    }
+    inBuffer.upload();
+
+    auto commandBuffer = manager.beginOneTimeCommands();
+    kernel.dispatchElements(commandBuffer,
+                            kernel.bind(inBuffer.buffer(), outBuffer.buffer()),
+                            elements);
+    vcm::memoryBarrierComputeThenHost(commandBuffer);
+    manager.submitOneTime(commandBuffer).wait();
+
+    outBuffer.download();
+  }
+
+  state.SetItemsProcessed(state.iterations() * elements);
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+}
+
+void BM_HostFrameStaged(benchmark::State &state) {
+  runHostFrames(state, Path::Staged);
+}
+BENCHMARK(BM_HostFrameStaged)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_HostFrameImported(benchmark::State &state) {
+  runHostFrames(state, Path::Imported);
+}
+BENCHMARK(BM_HostFrameImported)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_HostFrameImportedPerFrame(benchmark::State &state) {
+  runHostFrames(state, Path::ImportedPerFrame);
+}
+BENCHMARK(BM_HostFrameImportedPerFrame)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
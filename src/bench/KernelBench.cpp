@@ -0,0 +1,92 @@
+#include "BenchCommon.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace {
+
+using vcm::bench::BenchBuffer;
+
+constexpr int64_t MIN_ELEMENTS = 1 << 10;
+constexpr int64_t MAX_ELEMENTS = 1 << 26;
+
+// Elements/s of an element-wise int32 kernel with the given number of
+// buffers. The command buffer is recorded once and resubmitted, so this is
+// GPU execution plus one submit round trip per iteration.
+void runElementwise(benchmark::State &state, const char *shader,
+                    size_t bufferCount) {
+  const auto elements = static_cast<uint32_t>(state.range(0));
+  const vk::DeviceSize bytes = vk::DeviceSize{elements} * sizeof(int32_t);
+
+  auto &manager = vcm::bench::manager();
+  auto &kernel = manager.getKernel(shader);
+  state.counters["workgroupSize"] = kernel.workgroupSize()[0];
+
+  std::vector<std::unique_ptr<BenchBuffer>> buffers;
+  std::vector<vk::DescriptorBufferInfo> infos;
+  for (size_t i = 0; i < bufferCount; ++i) {
+    buffers.push_back(std::make_unique<BenchBuffer>(bytes));
+    if (!buffers.back()->valid()) {
+      state.SkipWithError("buffer allocation failed");
+      return;
+    }
+    infos.emplace_back(buffers.back()->buffer(), 0, vk::WholeSize);
+  }
+
+  const auto descriptorSet =
+      kernel.bind(std::span<const vk::DescriptorBufferInfo>(infos));
+
+  // Defined inputs
+  {
+    auto commandBuffer = manager.beginOneTimeCommands();
+    for (const auto &buffer : buffers) {
+      commandBuffer.fillBuffer(buffer->buffer(), 0, vk::WholeSize, 1);
+    }
+    manager.submitOneTime(commandBuffer).wait();
+  }
+
+  auto commandBuffer = manager.get_device()
+                           .allocateCommandBuffers(
+                               {manager.get_commandPool(),
+                                vk::CommandBufferLevel::ePrimary, 1})
+                           .front();
+  commandBuffer.begin(vk::CommandBufferBeginInfo{});
+  vcm::memoryBarrierTransferThenCompute(commandBuffer);
+  kernel.dispatchElements(commandBuffer, descriptorSet, elements);
+  commandBuffer.end();
+
+  for (auto _ : state) {
+    manager.submitAsync(commandBuffer).wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * elements);
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(bytes * bufferCount));
+
+  manager.get_device().freeCommandBuffers(manager.get_commandPool(),
+                                          commandBuffer);
+}
+
+// out = in * in
+void BM_Square(benchmark::State &state) {
+  runElementwise(state, "shaders/square.spv", 2);
+}
+BENCHMARK(BM_Square)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// out = a + b
+void BM_Add(benchmark::State &state) {
+  runElementwise(state, "shaders/add.spv", 3);
+}
+BENCHMARK(BM_Add)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
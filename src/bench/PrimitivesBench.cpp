@@ -0,0 +1,170 @@
+#include "BenchCommon.hpp"
+#include "vcm/Primitives.hpp"
+#include "vcm/StagingEngine.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace {
+
+using vcm::bench::BenchBuffer;
+
+constexpr int64_t MIN_ELEMENTS = 1 << 16;
+constexpr int64_t MAX_ELEMENTS = 1 << 26;
+
+vcm::Primitives &primitives() {
+  static vcm::Primitives instance(vcm::bench::manager());
+  return instance;
+}
+
+std::vector<uint32_t> randomElements(size_t count) {
+  std::vector<uint32_t> elements(count);
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<uint32_t> distribution(0, 1U << 20U);
+  std::ranges::generate(elements, [&] { return distribution(generator); });
+  return elements;
+}
+
+enum class Primitive { Reduce, ArgMax, InclusiveScan };
+
+// Elements/s of a GPU primitive over device local data. Recorded once and
+// resubmitted, as in KernelBench: GPU execution plus one submit round trip.
+void runGpu(benchmark::State &state, Primitive primitive) {
+  const auto count = static_cast<uint32_t>(state.range(0));
+  auto &gpu = primitives();
+  if (count > gpu.maxElements()) {
+    state.SkipWithError("input beyond maxStorageBufferRange");
+    return;
+  }
+  const vk::DeviceSize bytes = vk::DeviceSize{count} * sizeof(uint32_t);
+  const BenchBuffer input(bytes);
+  const BenchBuffer output(bytes);
+  if (!input.valid() || !output.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+
+  auto &manager = vcm::bench::manager();
+  const auto elements = randomElements(count);
+  vcm::StagingEngine(manager).upload(std::as_bytes(std::span(elements)),
+                                     input.buffer());
+
+  auto commandBuffer = manager.get_device()
+                           .allocateCommandBuffers(
+                               {manager.get_commandPool(),
+                                vk::CommandBufferLevel::ePrimary, 1})
+                           .front();
+  commandBuffer.begin(vk::CommandBufferBeginInfo{});
+  vcm::memoryBarrierTransferThenCompute(commandBuffer);
+  const vk::DescriptorBufferInfo in(input.buffer(), 0, bytes);
+  const vk::DescriptorBufferInfo out(output.buffer(), 0, bytes);
+  switch (primitive) {
+  case Primitive::Reduce:
+    gpu.recordReduce(commandBuffer, vcm::ReduceOp::Sum, in, count, out);
+    break;
+  case Primitive::ArgMax:
+    gpu.recordReduce(commandBuffer, vcm::ReduceOp::ArgMax, in, count, out);
+    break;
+  case Primitive::InclusiveScan:
+    gpu.recordScan(commandBuffer, in, out, count, true);
+    break;
+  }
+  commandBuffer.end();
+
+  for (auto _ : state) {
+    manager.submitAsync(commandBuffer).wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+
+  manager.get_device().freeCommandBuffers(manager.get_commandPool(),
+                                          commandBuffer);
+}
+
+// Single threaded standard library baselines over the same data
+void runCpu(benchmark::State &state, Primitive primitive) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const auto elements = randomElements(count);
+  std::vector<uint32_t> output(count);
+
+  for (auto _ : state) {
+    switch (primitive) {
+    case Primitive::Reduce:
+      benchmark::DoNotOptimize(
+          std::reduce(elements.begin(), elements.end(), uint32_t{0}));
+      break;
+    case Primitive::ArgMax:
+      benchmark::DoNotOptimize(
+          std::max_element(elements.begin(), elements.end()));
+      break;
+    case Primitive::InclusiveScan:
+      std::inclusive_scan(elements.begin(), elements.end(), output.begin());
+      benchmark::DoNotOptimize(output.data());
+      benchmark::ClobberMemory();
+      break;
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          static_cast<int64_t>(sizeof(uint32_t)));
+}
+
+void BM_GpuReduceSum(benchmark::State &state) {
+  runGpu(state, Primitive::Reduce);
+}
+BENCHMARK(BM_GpuReduceSum)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_CpuReduceSum(benchmark::State &state) {
+  runCpu(state, Primitive::Reduce);
+}
+BENCHMARK(BM_CpuReduceSum)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_GpuArgMax(benchmark::State &state) {
+  runGpu(state, Primitive::ArgMax);
+}
+BENCHMARK(BM_GpuArgMax)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_CpuArgMax(benchmark::State &state) {
+  runCpu(state, Primitive::ArgMax);
+}
+BENCHMARK(BM_CpuArgMax)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_GpuInclusiveScan(benchmark::State &state) {
+  runGpu(state, Primitive::InclusiveScan);
+}
+BENCHMARK(BM_GpuInclusiveScan)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_CpuInclusiveScan(benchmark::State &state) {
+  runCpu(state, Primitive::InclusiveScan);
+}
+BENCHMARK(BM_CpuInclusiveScan)
+    ->RangeMultiplier(4)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
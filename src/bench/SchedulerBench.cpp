@@ -0,0 +1,82 @@
+#include "BenchCommon.hpp"
+#include "vcm/Scheduler.hpp"
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace {
+
+constexpr int64_t MIN_ELEMENTS = 1 << 4;
+constexpr int64_t MAX_ELEMENTS = 1 << 24;
+
+vcm::Scheduler &scheduler() {
+  static vcm::Scheduler instance(vcm::bench::manager());
+  return instance;
+}
+
+enum class Run { Cpu, Gpu, Scheduled };
+
+// out = in * in over host arrays of state.range(0) floats, including the
+// GPU's staging both ways. The crossover of Cpu and Gpu is where Scheduled
+// should switch.
+void runSquare(benchmark::State &state, Run run) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::vector<float> in(count, 1.5F);
+  std::vector<float> out(count);
+  auto &sched = scheduler();
+  vcm::ElementwiseRunner runner(vcm::bench::manager());
+
+  int64_t gpuRuns = 0;
+  for (auto _ : state) {
+    switch (run) {
+    case Run::Cpu:
+      sched.cpu().square<float>(in, out);
+      break;
+    case Run::Gpu: {
+      const std::array inputs{std::as_bytes(std::span(in))};
+      runner.run(vcm::ElementwiseOp::Square, "float", sizeof(float), inputs,
+                 std::as_writable_bytes(std::span(out)), count);
+      break;
+    }
+    case Run::Scheduled:
+      sched.square<float>(in, out);
+      gpuRuns += sched.lastBackend() == vcm::Backend::Gpu ? 1 : 0;
+      break;
+    }
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  if (run == Run::Scheduled) {
+    state.counters["gpuFraction"] = static_cast<double>(gpuRuns) /
+                                    static_cast<double>(state.iterations());
+  }
+}
+
+void BM_SquareCpu(benchmark::State &state) { runSquare(state, Run::Cpu); }
+BENCHMARK(BM_SquareCpu)
+    ->RangeMultiplier(8)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_SquareGpu(benchmark::State &state) { runSquare(state, Run::Gpu); }
+BENCHMARK(BM_SquareGpu)
+    ->RangeMultiplier(8)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_SquareScheduled(benchmark::State &state) {
+  runSquare(state, Run::Scheduled);
+}
+BENCHMARK(BM_SquareScheduled)
+    ->RangeMultiplier(8)
+    ->Range(MIN_ELEMENTS, MAX_ELEMENTS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,112 @@
+#include "BenchCommon.hpp"
+#include "vcm/RadixSort.hpp"
+#include "vcm/StagingEngine.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace {
+
+using vcm::bench::BenchBuffer;
+
+constexpr int64_t MIN_KEYS = 1 << 14;
+constexpr int64_t MAX_KEYS = 1 << 26;
+
+vcm::RadixSort &radixSort() {
+  static vcm::RadixSort instance(vcm::bench::manager());
+  return instance;
+}
+
+std::vector<uint32_t> randomKeys(size_t count) {
+  std::vector<uint32_t> keys(count);
+  std::mt19937 generator(42);
+  std::ranges::generate(keys, generator);
+  return keys;
+}
+
+// Keys/s of the GPU sort of random keys. Every iteration first restores the
+// unsorted keys with a device copy, recorded in the same command buffer.
+void runGpu(benchmark::State &state, bool withValues) {
+  const auto count = static_cast<uint32_t>(state.range(0));
+  auto &sorter = radixSort();
+  if (count > sorter.maxKeys()) {
+    state.SkipWithError("keys beyond maxStorageBufferRange");
+    return;
+  }
+  const vk::DeviceSize bytes = vk::DeviceSize{count} * sizeof(uint32_t);
+  const BenchBuffer unsorted(bytes);
+  const BenchBuffer keys(bytes);
+  const BenchBuffer values(bytes);
+  if (!unsorted.valid() || !keys.valid() || !values.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+
+  auto &manager = vcm::bench::manager();
+  const auto hostKeys = randomKeys(count);
+  vcm::StagingEngine(manager).upload(std::as_bytes(std::span(hostKeys)),
+                                     unsorted.buffer());
+
+  auto commandBuffer = manager.get_device()
+                           .allocateCommandBuffers(
+                               {manager.get_commandPool(),
+                                vk::CommandBufferLevel::ePrimary, 1})
+                           .front();
+  commandBuffer.begin(vk::CommandBufferBeginInfo{});
+  commandBuffer.copyBuffer(unsorted.buffer(), keys.buffer(),
+                           vk::BufferCopy(0, 0, bytes));
+  vcm::memoryBarrierTransferThenCompute(commandBuffer);
+  const vk::DescriptorBufferInfo keysInfo(keys.buffer(), 0, bytes);
+  if (withValues) {
+    sorter.recordSort(commandBuffer, keysInfo,
+                      {values.buffer(), 0, bytes}, count);
+  } else {
+    sorter.recordSort(commandBuffer, keysInfo, count);
+  }
+  vcm::memoryBarrierComputeThenTransfer(commandBuffer);
+  commandBuffer.end();
+
+  for (auto _ : state) {
+    manager.submitAsync(commandBuffer).wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+
+  manager.get_device().freeCommandBuffers(manager.get_commandPool(),
+                                          commandBuffer);
+}
+
+void BM_GpuSortKeys(benchmark::State &state) { runGpu(state, false); }
+BENCHMARK(BM_GpuSortKeys)
+    ->RangeMultiplier(4)
+    ->Range(MIN_KEYS, MAX_KEYS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_GpuSortPairs(benchmark::State &state) { runGpu(state, true); }
+BENCHMARK(BM_GpuSortPairs)
+    ->RangeMultiplier(4)
+    ->Range(MIN_KEYS, MAX_KEYS)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// std::sort of a fresh copy of the same keys each iteration
+void BM_CpuSortKeys(benchmark::State &state) {
+  const auto unsorted = randomKeys(static_cast<size_t>(state.range(0)));
+  std::vector<uint32_t> keys(unsorted.size());
+  for (auto _ : state) {
+    std::ranges::copy(unsorted, keys.begin());
+    std::ranges::sort(keys);
+    benchmark::DoNotOptimize(keys.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CpuSortKeys)
+    ->RangeMultiplier(4)
+    ->Range(MIN_KEYS, MAX_KEYS)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,175 @@
+#include "BenchCommon.hpp"
+#include "vcm/StagingEngine.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using vcm::bench::BenchBuffer;
+
+constexpr int64_t MIN_BYTES = 256;
+constexpr int64_t MAX_BYTES = 1LL << 30; // 1 GiB
+
+// Device -> device copyBuffer, synchronous: includes submission and the wait
+void BM_CopyBuffer(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  const BenchBuffer src(bytes);
+  const BenchBuffer dst(bytes);
+  if (!src.valid() || !dst.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+
+  auto &manager = vcm::bench::manager();
+  const auto before = manager.get_commandBufferStats();
+  for (auto _ : state) {
+    manager.copyBuffer(src.buffer(), dst.buffer(), bytes);
+  }
+  const auto after = manager.get_commandBufferStats();
+
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+  // Steady state should reuse every command buffer
+  state.counters["cmdAllocations"] =
+      static_cast<double>(after.allocations - before.allocations);
+  state.counters["cmdReuses"] =
+      static_cast<double>(after.reuses - before.reuses);
+}
+BENCHMARK(BM_CopyBuffer)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// Host -> device through one staging buffer the size of the whole transfer
+void BM_UploadStaged(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  const BenchBuffer staging(bytes, true);
+  const BenchBuffer device(bytes);
+  if (!staging.valid() || !device.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+  const std::vector<std::byte> host(bytes, std::byte{1});
+
+  auto &manager = vcm::bench::manager();
+  for (auto _ : state) {
+    vmaCopyMemoryToAllocation(manager.get_allocator(), host.data(),
+                              staging.allocation(), 0, bytes);
+    manager.copyBuffer(staging.buffer(), device.buffer(), bytes);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UploadStaged)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// Host -> device with the data generated in place in a mapped staging
+// buffer, skipping the host vector and its copy in BM_UploadStaged
+void BM_UploadInPlace(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  auto &manager = vcm::bench::manager();
+  vcm::Buffer<std::byte> staging;
+  try {
+    staging = manager.createBuffer<std::byte>(
+        bytes, vk::BufferUsageFlagBits::eTransferSrc,
+        vcm::HostAccess::SequentialWrite);
+  } catch (const std::runtime_error &) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+  const BenchBuffer device(bytes);
+  if (!device.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+
+  for (auto _ : state) {
+    {
+      auto data = staging.write();
+      std::fill(data.begin(), data.end(), std::byte{1});
+    }
+    manager.copyBuffer(staging.buffer(), device.buffer(), bytes);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UploadInPlace)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// Host -> device through the chunked StagingEngine
+void BM_UploadChunked(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  const BenchBuffer device(bytes);
+  if (!device.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+  const std::vector<std::byte> host(bytes, std::byte{1});
+
+  vcm::StagingEngine engine(vcm::bench::manager());
+  for (auto _ : state) {
+    engine.upload(host, device.buffer());
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UploadChunked)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// Device -> host through one staging buffer
+void BM_DownloadStaged(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  const BenchBuffer staging(bytes, true);
+  const BenchBuffer device(bytes);
+  if (!staging.valid() || !device.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+  std::vector<std::byte> host(bytes);
+
+  auto &manager = vcm::bench::manager();
+  for (auto _ : state) {
+    manager.copyBuffer(device.buffer(), staging.buffer(), bytes);
+    vmaCopyAllocationToMemory(manager.get_allocator(), staging.allocation(), 0,
+                              host.data(), bytes);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DownloadStaged)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// Device -> host through the chunked StagingEngine
+void BM_DownloadChunked(benchmark::State &state) {
+  const auto bytes = static_cast<vk::DeviceSize>(state.range(0));
+  const BenchBuffer device(bytes);
+  if (!device.valid()) {
+    state.SkipWithError("buffer allocation failed");
+    return;
+  }
+  std::vector<std::byte> host(bytes);
+
+  vcm::StagingEngine engine(vcm::bench::manager());
+  for (auto _ : state) {
+    engine.download(device.buffer(), 0, host);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DownloadChunked)
+    ->RangeMultiplier(8)
+    ->Range(MIN_BYTES, MAX_BYTES)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
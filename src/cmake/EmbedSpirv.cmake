@@ -0,0 +1,26 @@
+# Writes a SPIR-V binary as a C++ header holding it as a uint32_t array:
+#   cmake -DINPUT=x.spv -DOUTPUT=x.spv.hpp -DNAME=identifier -P EmbedSpirv.cmake
+# The array is vcm::embedded::NAME. SPIR-V is a stream of little endian
+# words, so each group of 4 bytes becomes one word.
+
+file(READ "${INPUT}" SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" SPIRV_HEX_LENGTH)
+math(EXPR SPIRV_REMAINDER "${SPIRV_HEX_LENGTH} % 8")
+if (SPIRV_HEX_LENGTH EQUAL 0 OR NOT SPIRV_REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not valid SPIR-V.")
+endif()
+
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1,\n" SPIRV_WORDS "${SPIRV_HEX}")
+
+file(WRITE "${OUTPUT}" "// Generated from ${INPUT} by EmbedSpirv.cmake
+#pragma once
+
+#include <cstdint>
+
+namespace vcm::embedded {
+
+inline constexpr uint32_t ${NAME}[] = {
+${SPIRV_WORDS}};
+
+} // namespace vcm::embedded
+")
@@ -1,168 +1,206 @@
 #include "vcm/Buffer.hpp"
+#include "vcm/ComputeGraph.hpp"
+#include "vcm/ComputeKernel.hpp"
 #include "vcm/Shader.hpp"
 #include "vcm/VulkanComputeManager.hpp"
+#include <algorithm>
+#include <chrono>
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 #include <numeric>
+#include <ranges>
+#include <span>
 #include <stdexcept>
-#include <vk_mem_alloc.h>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
+// Time building a kernel's pipeline against the given cache
+auto timeKernelCreation(vcm::VulkanComputeManager &manager,
+                        vk::PipelineCache cache,
+                        std::span<const uint32_t> spirv) {
+  const auto start = std::chrono::steady_clock::now();
+  vcm::ComputeKernel kernel(manager.get_device(), cache,
+                            manager.get_descriptorSetCache(), spirv);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
 int main(int argc, char *argv[]) {
   fmt::print("Hello, world!\n");
 
   vcm::VulkanComputeManager manager;
 
-  {
-    const uint32_t N = 10;
-    const uint32_t bufferSize = N * sizeof(int32_t);
-
-    // Creating the buffers
-    vk::BufferCreateInfo bufCreateInfo{vk::BufferCreateFlags(), bufferSize,
-                                       vk::BufferUsageFlagBits::eStorageBuffer,
-                                       vk::SharingMode::eExclusive};
-    VmaAllocationCreateInfo allocInfo{};
-    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    allocInfo.flags |= VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-
-    vcm::VcmBuffer inBuffer(manager.get_allocator(), bufCreateInfo, allocInfo);
-    vcm::VcmBuffer outBuffer(manager.get_allocator(), bufCreateInfo, allocInfo);
+  const std::span args(argv, argc);
+
+  // --trace <file>: time GPU work and write a Chrome trace on exit
+  // --memory <file>: rewrite a JSON memory snapshot every 100 ms, and once
+  // more on exit
+  std::string tracePath;
+  std::string memoryPath;
+  for (size_t i = 1; i + 1 < args.size(); ++i) {
+    if (std::string_view(args[i]) == "--trace") {
+      tracePath = args[i + 1];
+    } else if (std::string_view(args[i]) == "--memory") {
+      memoryPath = args[i + 1];
+    }
+  }
+  if (!tracePath.empty()) {
+    manager.setProfiling(true);
+  }
+  if (!memoryPath.empty()) {
+    manager.get_memoryTracker().startSnapshots(std::chrono::milliseconds(100),
+                                               memoryPath);
+  }
 
-    // Copy data to inBuffer
-    std::vector<uint32_t> inData(N);
-    std::iota(inData.begin(), inData.end(), 0);
-    fmt::println("In data:\t{}", fmt::join(inData, ", "));
+  // Build the pipelines used below up front, in parallel
+  {
+    std::vector<std::string> shaders{"shaders/square.spv", "shaders/add.spv"};
+    for (const auto *type : {"float", "half", "int16", "uint8"}) {
+      for (const auto *op : {"add", "square"}) {
+        for (const auto words : {1, 4}) {
+          shaders.push_back(
+              fmt::format("shaders/typed_{}_{}_x{}.spv", op, type, words));
+        }
+      }
+    }
+    manager.warmUp(shaders);
+
+    const auto &startup = manager.get_startupTimings();
+    fmt::println("Startup: instance {:.1f} ms, device selection {:.1f} ms, "
+                 "device {:.1f} ms, allocator {:.1f} ms, pipeline cache "
+                 "{:.1f} ms, {} pipelines {:.1f} ms, tuning {:.1f} ms",
+                 startup.instanceMs, startup.deviceSelectionMs,
+                 startup.deviceCreationMs, startup.allocatorMs,
+                 startup.pipelineCacheMs, shaders.size(),
+                 startup.pipelineCreationMs, startup.tuningMs);
+  }
 
-    vmaCopyMemoryToAllocation(manager.get_allocator(), inData.data(),
-                              inBuffer.allocation, 0, N * sizeof(uint32_t));
+  {
+    const uint32_t N = 10;
 
-    // Load shader
-    auto shader = vcm::loadShader(manager.get_device(), "shaders/square.spv");
+    // Persistently mapped buffers: the host writes the input and reads the
+    // output in place, no staging vectors or extra copies
+    auto inBuffer = manager.createBuffer<uint32_t>(
+        N, vk::BufferUsageFlagBits::eStorageBuffer,
+        vcm::HostAccess::SequentialWrite);
+    auto outBuffer = manager.createBuffer<uint32_t>(
+        N, vk::BufferUsageFlagBits::eStorageBuffer, vcm::HostAccess::Random);
+
+    // Fill inBuffer. Flushed to the device at the end of the scope.
+    {
+      auto inData = inBuffer.write();
+      std::iota(inData.begin(), inData.end(), 0);
+    }
+    // Not read back from inBuffer: sequential write memory is uncached
+    fmt::println("In data:\t{}", fmt::join(std::views::iota(0U, N), ", "));
+
+    // Cold: an empty cache. Warm: the manager's cache, which was loaded from
+    // disk if a previous run on this device and driver saved one.
+    {
+      const auto spirv = vcm::readSpirv("shaders/square.spv");
+
+      auto emptyCache = manager.get_device().createPipelineCache(
+          vk::PipelineCacheCreateInfo());
+      const auto coldUs = timeKernelCreation(manager, emptyCache, spirv);
+      manager.get_device().destroyPipelineCache(emptyCache);
+
+      const bool loaded = manager.get_pipelineCacheManager().loadedFromDisk();
+      const auto warmUs =
+          timeKernelCreation(manager, manager.get_pipelineCache(), spirv);
+      fmt::println("Pipeline creation: cold {:.1f} us, {} {:.1f} us", coldUs,
+                   loaded ? "warm (from disk)" : "first use", warmUs);
+    }
 
     /*
     Create the compute pipeline
     */
-    // 1. Descriptor set layer
-    // layout of data to be passed into the pipeline
-    // (this is not the actual descriptor set, just the layout)
-    // Specified using a series of DescriptorSetLayoutBinding objects
-    const std::vector<vk::DescriptorSetLayoutBinding>
-        descriptorSetLayoutBinding = {
-            {0, vk::DescriptorType::eStorageBuffer, 1,
-             vk::ShaderStageFlagBits::eCompute},
-            {1, vk::DescriptorType::eStorageBuffer, 1,
-             vk::ShaderStageFlagBits::eCompute},
-        };
-
-    vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo(
-        vk::DescriptorSetLayoutCreateFlags(), descriptorSetLayoutBinding);
-
-    auto descriptorSetLayout = manager.get_device().createDescriptorSetLayout(
-        descriptorSetLayoutCreateInfo);
-
-    // 2. Pipeline layout
-    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo(
-        vk::PipelineLayoutCreateFlags(), descriptorSetLayout);
-    auto pipelineLayout =
-        manager.get_device().createPipelineLayout(pipelineLayoutCreateInfo);
-    auto pipelineCache =
-        manager.get_device().createPipelineCache(vk::PipelineCacheCreateInfo());
-
-    // 3. Create the Pipeline
-    vk::PipelineShaderStageCreateInfo pipelineShaderCreateInfo(
-        vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute,
-        shader, "Main");
-
-    vk::ComputePipelineCreateInfo computePipelineCreateInfo(
-        vk::PipelineCreateFlags(), pipelineShaderCreateInfo, pipelineLayout);
-
-    // TODO save and load the pipelineCache at the start and end of app
-    // https://docs.vulkan.org/samples/latest/samples/performance/hpp_pipeline_cache/README.html#_vulkan_pipeline_cache
-    auto computePipeline_ = manager.get_device().createComputePipeline(
-        pipelineCache, computePipelineCreateInfo);
-    if (computePipeline_.result != vk::Result::eSuccess) {
-      throw std::runtime_error("Failed to create commpute pipeline.");
-    }
-    vk::Pipeline computePipeline = computePipeline_.value;
-
-    // 4. Create the DescriptorSet
-    vk::DescriptorSetAllocateInfo descriptorSetAllocInfo(
-        manager.get_descriptorPool(), 1, &descriptorSetLayout);
-    const std::vector<vk::DescriptorSet> descriptorSets =
-        manager.get_device().allocateDescriptorSets(descriptorSetAllocInfo);
-    auto descriptorSet = descriptorSets.front();
-    vk::DescriptorBufferInfo inBufferInfo(inBuffer.buffer, 0,
-                                          N * sizeof(int32_t));
-    vk::DescriptorBufferInfo outBufferInfo(outBuffer.buffer, 0,
-                                           N * sizeof(int32_t));
-
-    const std::vector<vk::WriteDescriptorSet> writeDescriptorSets = {
-        {descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr,
-         &inBufferInfo},
-        {descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr,
-         &outBufferInfo},
-    };
-    manager.get_device().updateDescriptorSets(writeDescriptorSets, {});
+    // Descriptor set layout, pipeline layout and pipeline are derived from the
+    // shader and cached by the manager.
+    auto &kernel = manager.getKernel("shaders/square.spv");
+    fmt::println("Shaders: {} embedded in the binary, {} modules created",
+                 vcm::embeddedSpirvNames().size(),
+                 manager.get_shaderModuleCache().size());
+
+    // Point the kernel's bindings at our buffers. The set is cached, so
+    // binding the same buffers again later costs a hash lookup.
+    auto descriptorSet = kernel.bind(inBuffer, outBuffer);
 
     /*
     Submitting work to the GPU
     */
 
-    // 1. Allocate command buffer
-    vk::CommandBufferAllocateInfo commandBufferAllocInfo(
-        manager.get_commandPool(), vk::CommandBufferLevel::ePrimary, 1);
-    const auto cmdBuffers =
-        manager.get_device().allocateCommandBuffers(commandBufferAllocInfo);
-    auto cmdBuffer = cmdBuffers.front();
+    // 1. Get a command buffer in the recording state. The manager recycles
+    // one time command buffers once their submission completes.
+    auto cmdBuffer = manager.beginOneTimeCommands();
 
     // 2. Recording commands
     // Bind the pipeline and descriptorset, and record a dispatch call
-    vk::CommandBufferBeginInfo cmdBufferBeginInfo(
-        vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-    cmdBuffer.begin(cmdBufferBeginInfo);
-    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
-    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
-                                 pipelineLayout, 0, {descriptorSet}, {});
     // Record the number of threads to launch in the device.
-    // Here we launch 1 thread per element
-    cmdBuffer.dispatch(N, 1, 1);
-    cmdBuffer.end();
+    // Here we launch 1 thread per element, rounded up to whole workgroups;
+    // the shader skips threads past N
+    kernel.dispatchElements(cmdBuffer, descriptorSet, N);
 
     // 3. Submit to GPU
-    // First get the Queue from the Device
-    // Create a Fence (a mechanism to wait for the compute shader to complete)
-    vk::Fence fence = manager.get_device().createFence(vk::FenceCreateInfo());
-
-    vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &cmdBuffer);
-    manager.get_queue().submit({submitInfo}, fence);
-    auto result =
-        manager.get_device().waitForFences({fence}, true, uint64_t(-1));
-
-    if (result != vk::Result::eSuccess) {
-      throw std::runtime_error(
-          fmt::format("vk result = {}", static_cast<int32_t>(result)));
+    // Submission returns immediately with a ticket that completes when the
+    // compute shader is done. The host is free to record more work meanwhile.
+    {
+      const auto scope = manager.get_profiler().cpuScope("submit and wait");
+      const auto ticket = manager.submitOneTime(cmdBuffer);
+      ticket.wait();
     }
 
     // Finally, read results
-    std::vector<uint32_t> outData(N);
-    vmaCopyAllocationToMemory(manager.get_allocator(), outBuffer.allocation, 0,
-                              outData.data(), N * sizeof(uint32_t));
+    fmt::println("Out data:\t{}", fmt::join(outBuffer.read(), ", "));
 
-    fmt::println("Out data:\t{}", fmt::join(outData, ", "));
+    // The buffers are destroyed here, which also drops the cached descriptor
+    // sets referring to them
+  }
 
-    /*
-    Cleanup
-    */
-    auto device = manager.get_device();
-    device.destroyFence(fence);
-    device.destroyDescriptorSetLayout(descriptorSetLayout);
-    device.destroyPipelineLayout(pipelineLayout);
-    device.destroyPipelineCache(pipelineCache);
-    device.destroyShaderModule(shader);
-    device.destroyPipeline(computePipeline);
-
-    inBuffer.destroy(manager.get_allocator());
-    outBuffer.destroy(manager.get_allocator());
+  // add -> square in one submission. The graph puts a barrier on sum between
+  // the kernels and makes out visible to the host, instead of a round trip
+  // per kernel.
+  {
+    const uint32_t N = 10;
+    const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    auto a = manager.createBuffer<uint32_t>(N, usage,
+                                            vcm::HostAccess::SequentialWrite);
+    auto b = manager.createBuffer<uint32_t>(N, usage,
+                                            vcm::HostAccess::SequentialWrite);
+    auto sum = manager.createBuffer<uint32_t>(N, usage);
+    auto out = manager.createBuffer<uint32_t>(N, usage, vcm::HostAccess::Random);
+    {
+      auto data = a.write();
+      std::iota(data.begin(), data.end(), 0);
+    }
+    {
+      auto data = b.write();
+      std::fill(data.begin(), data.end(), 1);
+    }
+
+    vcm::ComputeGraph graph(manager);
+    graph.setBuffer("a", a);
+    graph.setBuffer("b", b);
+    graph.setBuffer("sum", sum);
+    graph.setBuffer("out", out);
+    graph.dispatch(manager.getKernel("shaders/add.spv"), {"a", "b", "sum"}, N)
+        .dispatch(manager.getKernel("shaders/square.spv"), {"sum", "out"}, N)
+        .hostRead("out");
+    graph.submit().wait();
+
+    const auto stats = graph.stats();
+    fmt::println("(a + 1)^2:\t{} ({} batches, {} barriers)",
+                 fmt::join(out.read(), ", "), stats.batches,
+                 stats.pipelineBarriers);
+  }
+
+  if (!tracePath.empty()) {
+    manager.get_profiler().writeChromeTrace(tracePath);
+  }
+  if (!memoryPath.empty()) {
+    manager.get_memoryTracker().stopSnapshots();
+    manager.get_memoryTracker().writeSnapshot(memoryPath);
   }
 
   return 0;
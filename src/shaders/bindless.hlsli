@@ -0,0 +1,52 @@
+// Buffers passed by device address in push constants instead of bound
+// through descriptors (ComputeKernel::dispatchAddresses). Kernels including
+// this declare no bindings and a push constant block of
+//
+//   struct PushConstants {
+//     uint count;
+//     uint base;
+//     uint2 padding;
+//     BufferAddress buffers[N];
+//   };
+//
+// The padding puts the addresses at offset 16 (ADDRESS_PUSH_OFFSET) under
+// both the DX and the std430 layout. With the 128 bytes of push constants
+// every device has, N is at most 7.
+//
+// Loads and stores are 32 bit words at element index, the 128 bit forms at
+// vector index, and not bounds checked: the kernel compares its index with
+// count, or with elementCount() of a buffer.
+
+struct BufferAddress {
+  uint64_t address;
+  // Bytes
+  uint64_t size;
+};
+
+uint elementCount(BufferAddress buffer) { return uint(buffer.size / 4); }
+
+uint loadUint(BufferAddress buffer, uint index) {
+  return vk::RawBufferLoad<uint>(buffer.address + 4 * uint64_t(index), 4);
+}
+int loadInt(BufferAddress buffer, uint index) {
+  return asint(loadUint(buffer, index));
+}
+float loadFloat(BufferAddress buffer, uint index) {
+  return asfloat(loadUint(buffer, index));
+}
+uint4 loadUint4(BufferAddress buffer, uint index) {
+  return vk::RawBufferLoad<uint4>(buffer.address + 16 * uint64_t(index), 16);
+}
+
+void storeUint(BufferAddress buffer, uint index, uint value) {
+  vk::RawBufferStore<uint>(buffer.address + 4 * uint64_t(index), value, 4);
+}
+void storeInt(BufferAddress buffer, uint index, int value) {
+  storeUint(buffer, index, asuint(value));
+}
+void storeFloat(BufferAddress buffer, uint index, float value) {
+  storeUint(buffer, index, asuint(value));
+}
+void storeUint4(BufferAddress buffer, uint index, uint4 value) {
+  vk::RawBufferStore<uint4>(buffer.address + 16 * uint64_t(index), value, 16);
+}
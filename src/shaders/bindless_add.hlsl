@@ -0,0 +1,20 @@
+#include "bindless.hlsli"
+
+// add.hlsl with its buffers passed by address: In1, In2, Out
+struct PushConstants {
+  uint count;
+  uint base;
+  uint2 padding;
+  BufferAddress buffers[3];
+};
+[[vk::push_constant]] PushConstants pc;
+
+[numthreads(64, 1, 1)] void Main(uint3 DTid
+                                : SV_DispatchThreadID) {
+  const uint i = pc.base + DTid.x;
+  if (i >= pc.count) {
+    return;
+  }
+  storeInt(pc.buffers[2], i,
+           loadInt(pc.buffers[0], i) + loadInt(pc.buffers[1], i));
+}
@@ -0,0 +1,3 @@
+// No bindings and no work: measures the fixed cost of a dispatch
+[numthreads(1, 1, 1)] void Main(uint3 DTid
+                                : SV_DispatchThreadID) {}
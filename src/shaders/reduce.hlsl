@@ -0,0 +1,115 @@
+// Reduction of uint elements to a (value, index) pair, in two passes:
+// pass 0 reduces Input to one pair per workgroup in Partials, pass 1 runs a
+// single workgroup over Partials and writes Result[0].
+[[vk::binding(0, 0)]] StructuredBuffer<uint> Input;
+[[vk::binding(1, 0)]] RWStructuredBuffer<uint2> Partials;
+[[vk::binding(2, 0)]] RWStructuredBuffer<uint2> Result;
+
+// Same values as vcm::ReduceOp
+#define OP_SUM 0
+#define OP_MIN 1
+#define OP_MAX 2
+#define OP_ARGMIN 3
+#define OP_ARGMAX 4
+
+// The host never respecializes this kernel, so groupshared arrays can be
+// sized by the declared workgroup size
+#define GROUP_SIZE 256
+
+struct PushConstants {
+  // Elements of Input in pass 0, of Partials in pass 1
+  uint count;
+  uint op;
+  uint pass;
+};
+[[vk::push_constant]] PushConstants pc;
+
+groupshared uint2 waveResults[GROUP_SIZE];
+
+uint2 identity(uint op) {
+  switch (op) {
+  case OP_MIN:
+  case OP_ARGMIN:
+    return uint2(0xFFFFFFFF, 0xFFFFFFFF);
+  case OP_MAX:
+  case OP_ARGMAX:
+    return uint2(0, 0xFFFFFFFF);
+  default:
+    return uint2(0, 0);
+  }
+}
+
+// Ties go to the lower index, so arg results are the first occurrence like
+// std::min_element and std::max_element
+uint2 combine(uint op, uint2 a, uint2 b) {
+  switch (op) {
+  case OP_MIN:
+    return uint2(min(a.x, b.x), 0);
+  case OP_MAX:
+    return uint2(max(a.x, b.x), 0);
+  case OP_ARGMIN:
+    return (b.x < a.x || (b.x == a.x && b.y < a.y)) ? b : a;
+  case OP_ARGMAX:
+    return (b.x > a.x || (b.x == a.x && b.y < a.y)) ? b : a;
+  default:
+    return uint2(a.x + b.x, 0);
+  }
+}
+
+uint2 waveReduce(uint op, uint2 v) {
+  switch (op) {
+  case OP_MIN:
+    return uint2(WaveActiveMin(v.x), 0);
+  case OP_MAX:
+    return uint2(WaveActiveMax(v.x), 0);
+  case OP_ARGMIN: {
+    const uint best = WaveActiveMin(v.x);
+    return uint2(best, WaveActiveMin(v.x == best ? v.y : 0xFFFFFFFF));
+  }
+  case OP_ARGMAX: {
+    const uint best = WaveActiveMax(v.x);
+    return uint2(best, WaveActiveMin(v.x == best ? v.y : 0xFFFFFFFF));
+  }
+  default:
+    return uint2(WaveActiveSum(v.x), 0);
+  }
+}
+
+uint2 load(uint i) {
+  return pc.pass == 0 ? uint2(Input[i], i) : Partials[i];
+}
+
+[numthreads(GROUP_SIZE, 1, 1)] void Main(uint3 Gid
+                                        : SV_GroupID, uint GI
+                                        : SV_GroupIndex, uint3 groupCount
+                                        : SV_NumWorkGroups) {
+  // Grid stride loop, coalesced across the whole grid
+  const uint stride = groupCount.x * GROUP_SIZE;
+  uint2 acc = identity(pc.op);
+  for (uint i = Gid.x * GROUP_SIZE + GI; i < pc.count; i += stride) {
+    acc = combine(pc.op, acc, load(i));
+  }
+
+  // Subgroups, then one value per subgroup through shared memory. Assumes
+  // subgroups are consecutive ranges of the group index, as on all 1D
+  // workgroups in practice.
+  acc = waveReduce(pc.op, acc);
+  const uint lanes = WaveGetLaneCount();
+  if (WaveIsFirstLane()) {
+    waveResults[GI / lanes] = acc;
+  }
+  GroupMemoryBarrierWithGroupSync();
+  if (GI != 0) {
+    return;
+  }
+  const uint waves = (GROUP_SIZE + lanes - 1) / lanes;
+  for (uint wave = 1; wave < waves; ++wave) {
+    acc = combine(pc.op, acc, waveResults[wave]);
+  }
+
+  if (pc.pass == 0) {
+    Partials[Gid.x] = acc;
+  } else {
+    Result[0] = acc;
+  }
+}
@@ -0,0 +1,80 @@
+// Last pass of the reduce-then-scan prefix sum: scan each tile of
+// GROUP_SIZE * ITEMS elements and add the exclusive sum of all tiles before
+// it. A single tile needs no offsets and is the whole scan.
+[[vk::binding(0, 0)]] StructuredBuffer<uint> Input;
+[[vk::binding(1, 0)]] StructuredBuffer<uint> TileOffsets;
+[[vk::binding(2, 0)]] RWStructuredBuffer<uint> Output;
+
+// Fixed, see reduce.hlsl. Must match scan_reduce.hlsl and vcm::Primitives.
+#define GROUP_SIZE 256
+#define ITEMS 8
+
+struct PushConstants {
+  uint count;
+  // Tile of workgroup 0, when the host splits a grid too large for one
+  // dispatch
+  uint firstTile;
+  // Output[i] includes Input[i]
+  uint inclusive;
+  // Add TileOffsets[tile]; 0 when all elements are in one tile
+  uint hasOffsets;
+};
+[[vk::push_constant]] PushConstants pc;
+
+groupshared uint values[GROUP_SIZE * ITEMS];
+groupshared uint waveSums[GROUP_SIZE];
+
+[numthreads(GROUP_SIZE, 1, 1)] void Main(uint3 Gid
+                                        : SV_GroupID, uint GI
+                                        : SV_GroupIndex) {
+  const uint tile = pc.firstTile + Gid.x;
+  const uint base = tile * GROUP_SIZE * ITEMS;
+
+  // Coalesced loads into shared memory, then each thread scans ITEMS
+  // consecutive elements
+  [unroll] for (uint k = 0; k < ITEMS; ++k) {
+    const uint i = k * GROUP_SIZE + GI;
+    values[i] = base + i < pc.count ? Input[base + i] : 0;
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  uint sum = 0;
+  [unroll] for (uint k = 0; k < ITEMS; ++k) {
+    sum += values[GI * ITEMS + k];
+  }
+
+  // Exclusive prefix of the thread sums: within the subgroup, then over
+  // subgroup totals
+  const uint wavePrefix = WavePrefixSum(sum);
+  const uint lanes = WaveGetLaneCount();
+  const uint wave = GI / lanes;
+  if (WaveGetLaneIndex() == lanes - 1) {
+    waveSums[wave] = wavePrefix + sum;
+  }
+  GroupMemoryBarrierWithGroupSync();
+  if (GI == 0) {
+    const uint waves = (GROUP_SIZE + lanes - 1) / lanes;
+    uint running = pc.hasOffsets != 0 ? TileOffsets[tile] : 0;
+    for (uint w = 0; w < waves; ++w) {
+      const uint waveSum = waveSums[w];
+      waveSums[w] = running;
+      running += waveSum;
+    }
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  uint running = waveSums[wave] + wavePrefix;
+  [unroll] for (uint k = 0; k < ITEMS; ++k) {
+    const uint value = values[GI * ITEMS + k];
+    values[GI * ITEMS + k] = pc.inclusive != 0 ? running + value : running;
+    running += value;
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  [unroll] for (uint k = 0; k < ITEMS; ++k) {
+    const uint i = k * GROUP_SIZE + GI;
+    if (base + i < pc.count) {
+      Output[base + i] = values[i];
+    }
+  }
+}
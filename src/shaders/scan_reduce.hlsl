@@ -0,0 +1,48 @@
+// First pass of the reduce-then-scan prefix sum: the sum of every tile of
+// GROUP_SIZE * ITEMS elements, one tile per workgroup
+[[vk::binding(0, 0)]] StructuredBuffer<uint> Input;
+[[vk::binding(1, 0)]] RWStructuredBuffer<uint> TileSums;
+
+// Fixed, see reduce.hlsl. Must match scan.hlsl and vcm::Primitives.
+#define GROUP_SIZE 256
+#define ITEMS 8
+
+struct PushConstants {
+  uint count;
+  // Tile of workgroup 0, when the host splits a grid too large for one
+  // dispatch
+  uint firstTile;
+};
+[[vk::push_constant]] PushConstants pc;
+
+groupshared uint waveSums[GROUP_SIZE];
+
+[numthreads(GROUP_SIZE, 1, 1)] void Main(uint3 Gid
+                                        : SV_GroupID, uint GI
+                                        : SV_GroupIndex) {
+  const uint tile = pc.firstTile + Gid.x;
+  const uint base = tile * GROUP_SIZE * ITEMS;
+
+  uint sum = 0;
+  [unroll] for (uint k = 0; k < ITEMS; ++k) {
+    const uint i = base + k * GROUP_SIZE + GI;
+    if (i < pc.count) {
+      sum += Input[i];
+    }
+  }
+
+  sum = WaveActiveSum(sum);
+  const uint lanes = WaveGetLaneCount();
+  if (WaveIsFirstLane()) {
+    waveSums[GI / lanes] = sum;
+  }
+  GroupMemoryBarrierWithGroupSync();
+  if (GI != 0) {
+    return;
+  }
+  const uint waves = (GROUP_SIZE + lanes - 1) / lanes;
+  for (uint wave = 1; wave < waves; ++wave) {
+    sum += waveSums[wave];
+  }
+  TileSums[tile] = sum;
+}
@@ -0,0 +1,48 @@
+// First pass of one LSD radix sort digit: how many keys of each tile have
+// each digit value
+[[vk::binding(0, 0)]] StructuredBuffer<uint> Keys;
+[[vk::binding(1, 0)]] RWStructuredBuffer<uint> Histograms;
+
+// Fixed, see reduce.hlsl. Must match sort_scatter.hlsl and vcm::RadixSort.
+#define GROUP_SIZE 256
+#define ITEMS 8
+#define RADIX 16
+
+struct PushConstants {
+  uint count;
+  // Tile of workgroup 0, when the host splits a grid too large for one
+  // dispatch
+  uint firstTile;
+  uint tileCount;
+  // Of the digit in the keys
+  uint shift;
+};
+[[vk::push_constant]] PushConstants pc;
+
+groupshared uint counts[RADIX];
+
+[numthreads(GROUP_SIZE, 1, 1)] void Main(uint3 Gid
+                                        : SV_GroupID, uint GI
+                                        : SV_GroupIndex) {
+  const uint tile = pc.firstTile + Gid.x;
+  const uint base = tile * GROUP_SIZE * ITEMS;
+
+  if (GI < RADIX) {
+    counts[GI] = 0;
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  [unroll] for (uint k = 0; k < ITEMS; ++k) {
+    const uint i = base + k * GROUP_SIZE + GI;
+    if (i < pc.count) {
+      InterlockedAdd(counts[(Keys[i] >> pc.shift) & (RADIX - 1)], 1);
+    }
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  // Digit major, so an exclusive scan of the whole array gives every
+  // (digit, tile) its first output position
+  if (GI < RADIX) {
+    Histograms[GI * pc.tileCount + tile] = counts[GI];
+  }
+}
@@ -0,0 +1,94 @@
+// Last pass of one LSD radix sort digit: move every key (and value) of a
+// tile to its position, the scanned histogram of its digit and tile plus
+// its rank among the keys of the tile with the same digit. Ranks follow the
+// input order, so the sort is stable.
+[[vk::binding(0, 0)]] StructuredBuffer<uint> KeysIn;
+[[vk::binding(1, 0)]] StructuredBuffer<uint> ValuesIn;
+[[vk::binding(2, 0)]] StructuredBuffer<uint> Offsets;
+[[vk::binding(3, 0)]] RWStructuredBuffer<uint> KeysOut;
+[[vk::binding(4, 0)]] RWStructuredBuffer<uint> ValuesOut;
+
+// Fixed, see reduce.hlsl. Must match sort_histogram.hlsl and
+// vcm::RadixSort.
+#define GROUP_SIZE 256
+#define ITEMS 8
+#define RADIX 16
+// Subgroups of at least 4 lanes, checked by the host
+#define MAX_WAVES (GROUP_SIZE / 4)
+
+struct PushConstants {
+  uint count;
+  // Tile of workgroup 0, when the host splits a grid too large for one
+  // dispatch
+  uint firstTile;
+  uint tileCount;
+  // Of the digit in the keys
+  uint shift;
+  // Move ValuesIn along with the keys
+  uint hasValues;
+};
+[[vk::push_constant]] PushConstants pc;
+
+// Next output position of each digit in this tile
+groupshared uint digitOffsets[RADIX];
+// Per subgroup digit counts of a round, then their output positions
+groupshared uint waveOffsets[MAX_WAVES][RADIX];
+
+[numthreads(GROUP_SIZE, 1, 1)] void Main(uint3 Gid
+                                        : SV_GroupID, uint GI
+                                        : SV_GroupIndex) {
+  const uint tile = pc.firstTile + Gid.x;
+  const uint base = tile * GROUP_SIZE * ITEMS;
+  const uint lanes = WaveGetLaneCount();
+  const uint wave = GI / lanes;
+  const uint waves = (GROUP_SIZE + lanes - 1) / lanes;
+
+  if (GI < RADIX) {
+    digitOffsets[GI] = Offsets[GI * pc.tileCount + tile];
+  }
+
+  // One key per thread and round, in input order
+  for (uint k = 0; k < ITEMS; ++k) {
+    const uint i = base + k * GROUP_SIZE + GI;
+    const bool valid = i < pc.count;
+    const uint key = valid ? KeysIn[i] : 0;
+    // RADIX matches no digit, for threads past the end
+    const uint digit = valid ? (key >> pc.shift) & (RADIX - 1) : RADIX;
+
+    // Rank among the lanes before with the same digit
+    uint rank = 0;
+    [unroll] for (uint d = 0; d < RADIX; ++d) {
+      const bool match = digit == d;
+      const uint before = WavePrefixCountBits(match);
+      const uint total = WaveActiveCountBits(match);
+      if (match) {
+        rank = before;
+      }
+      if (WaveIsFirstLane()) {
+        waveOffsets[wave][d] = total;
+      }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // Subgroup counts to output positions, one thread per digit
+    if (GI < RADIX) {
+      uint running = digitOffsets[GI];
+      for (uint w = 0; w < waves; ++w) {
+        const uint waveCount = waveOffsets[w][GI];
+        waveOffsets[w][GI] = running;
+        running += waveCount;
+      }
+      digitOffsets[GI] = running;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (valid) {
+      const uint position = waveOffsets[wave][digit] + rank;
+      KeysOut[position] = key;
+      if (pc.hasValues != 0) {
+        ValuesOut[position] = ValuesIn[i];
+      }
+    }
+    GroupMemoryBarrierWithGroupSync();
+  }
+}
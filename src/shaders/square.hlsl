@@ -1,9 +1,23 @@
-[[vk::binding(0, 0)]] RWStructuredBuffer<int> InBuffer;
+[[vk::binding(0, 0)]] StructuredBuffer<int> InBuffer;
 
 // Binding 1 in descriptor set 0
 [[vk::binding(1, 0)]] RWStructuredBuffer<int> OutBuffer;
 
-[numthreads(1, 1, 1)] void Main(uint3 DTid
+// Elements in the bound ranges, and the first one of this dispatch when
+// the host splits a grid too large for one. Threads past count do nothing.
+struct PushConstants {
+  uint count;
+  uint base;
+};
+[[vk::push_constant]] PushConstants pc;
+
+// 64 is the default, kernels override the X size with a specialization
+// constant at pipeline creation
+[numthreads(64, 1, 1)] void Main(uint3 DTid
                                 : SV_DispatchThreadID) {
-  OutBuffer[DTid.x] = InBuffer[DTid.x] * InBuffer[DTid.x];
+  const uint i = pc.base + DTid.x;
+  if (i >= pc.count) {
+    return;
+  }
+  OutBuffer[i] = InBuffer[i] * InBuffer[i];
 }
@@ -0,0 +1,69 @@
+// Element types of the typed element-wise kernels, one per permutation
+// (vcm_add_hlsl_shaders TYPED): -D VCM_TYPE_<TYPE>=1 -D VCM_WORDS=<1|4>.
+//
+// Buffers are bound as 32 bit words and elements packed LANES to a word, so
+// 8 and 16 bit types need no 8/16 bit storage features. Arithmetic happens
+// in Value: float for half, int/uint for the small integers, which wrap to
+// their width when packed like a C++ conversion.
+//
+// Each thread handles WORDS words; 4 makes every load and store one 128 bit
+// access. The host pads buffers to whole units of WORDS words, so the last
+// unit may hold elements past the end, computed but never read.
+
+#if defined(VCM_TYPE_FLOAT)
+#define LANES 1
+typedef float Value;
+Value unpack(uint word, uint lane) { return asfloat(word); }
+uint pack(Value value, uint lane) { return asuint(value); }
+
+#elif defined(VCM_TYPE_HALF)
+#define LANES 2
+typedef float Value;
+Value unpack(uint word, uint lane) { return f16tof32(word >> (16 * lane)); }
+uint pack(Value value, uint lane) { return f32tof16(value) << (16 * lane); }
+
+#elif defined(VCM_TYPE_INT16)
+#define LANES 2
+typedef int Value;
+Value unpack(uint word, uint lane) {
+  // Sign extended by the arithmetic shift
+  return int(word << (16 * (1 - lane))) >> 16;
+}
+uint pack(Value value, uint lane) {
+  return (uint(value) & 0xFFFF) << (16 * lane);
+}
+
+#elif defined(VCM_TYPE_UINT8)
+#define LANES 4
+typedef uint Value;
+Value unpack(uint word, uint lane) { return (word >> (8 * lane)) & 0xFF; }
+uint pack(Value value, uint lane) { return (value & 0xFF) << (8 * lane); }
+
+#elif defined(VCM_TYPE_INT32)
+#define LANES 1
+typedef int Value;
+Value unpack(uint word, uint lane) { return asint(word); }
+uint pack(Value value, uint lane) { return asuint(value); }
+
+#elif defined(VCM_TYPE_UINT32)
+#define LANES 1
+typedef uint Value;
+Value unpack(uint word, uint lane) { return word; }
+uint pack(Value value, uint lane) { return value; }
+
+#else
+#error "Define one VCM_TYPE_<TYPE>"
+#endif
+
+#ifndef VCM_WORDS
+#define VCM_WORDS 4
+#endif
+typedef vector<uint, VCM_WORDS> Words;
+
+// Units of WORDS words in the bound ranges, and the first one of this
+// dispatch when the host splits a grid too large for one
+struct PushConstants {
+  uint count;
+  uint base;
+};
+[[vk::push_constant]] PushConstants pc;
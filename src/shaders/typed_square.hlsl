@@ -0,0 +1,26 @@
+// out = in * in for any element type, see typed_elementwise.hlsli
+#include "typed_elementwise.hlsli"
+
+[[vk::binding(0, 0)]] StructuredBuffer<Words> InBuffer;
+[[vk::binding(1, 0)]] RWStructuredBuffer<Words> OutBuffer;
+
+// 64 is the default, kernels override the X size with a specialization
+// constant at pipeline creation
+[numthreads(64, 1, 1)] void Main(uint3 DTid
+                                : SV_DispatchThreadID) {
+  const uint i = pc.base + DTid.x;
+  if (i >= pc.count) {
+    return;
+  }
+  const Words input = InBuffer[i];
+  Words result;
+  [unroll] for (uint w = 0; w < VCM_WORDS; ++w) {
+    uint word = 0;
+    [unroll] for (uint lane = 0; lane < LANES; ++lane) {
+      const Value value = unpack(input[w], lane);
+      word |= pack(value * value, lane);
+    }
+    result[w] = word;
+  }
+  OutBuffer[i] = result;
+}
@@ -0,0 +1,100 @@
+#include "TestCommon.hpp"
+#include "vcm/BufferArena.hpp"
+#include "vcm/ComputeKernel.hpp"
+#include "vcm/Shader.hpp"
+#include <array>
+#include <cstdint>
+#include <fmt/core.h>
+#include <numeric>
+
+namespace {
+
+// Run square with artificially low dispatch limits, so a small array takes
+// the paths that split grids past maxComputeWorkGroupCount and bind ranges
+// past maxStorageBufferRange, and check every element
+bool testLargeArrayPaths(vcm::VulkanComputeManager &manager) {
+  const auto spirv = vcm::readSpirv("shaders/square.spv");
+  vcm::ComputeKernel kernel(manager.get_device(), manager.get_pipelineCache(),
+                            manager.get_descriptorSetCache(), spirv);
+
+  // 3 workgroups per dispatch, 1 KiB per bound range
+  auto limits = vcm::DispatchLimits::fromDevice(manager.get_physicalDevice());
+  limits.maxGroupCountX = 3;
+  limits.maxStorageBufferRange = 1024;
+  kernel.setDispatchLimits(limits);
+
+  const uint32_t N = 10000;
+  const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  auto in = manager.createBuffer<uint32_t>(N, usage,
+                                           vcm::HostAccess::SequentialWrite);
+  auto out = manager.createBuffer<uint32_t>(N, usage, vcm::HostAccess::Random);
+  {
+    auto data = in.write();
+    std::iota(data.begin(), data.end(), 0);
+  }
+
+  auto cmdBuffer = manager.beginOneTimeCommands();
+  const std::array buffers{in.descriptor(), out.descriptor()};
+  kernel.dispatchElements(cmdBuffer, buffers, N);
+  vcm::memoryBarrierComputeThenHost(cmdBuffer);
+  manager.submitOneTime(cmdBuffer).wait();
+
+  const auto result = out.read();
+  for (uint32_t i = 0; i < N; ++i) {
+    if (result[i] != i * i) {
+      fmt::println("Large array paths: element {} is {}, expected {}", i,
+                   result[i], i * i);
+      return false;
+    }
+  }
+  fmt::println("Large array paths: {} elements checked", N);
+  return true;
+}
+
+// Add buffers passed by device address rather than bound, inputs from
+// createBuffer() and the output an arena slice
+bool testBindless(vcm::VulkanComputeManager &manager) {
+  if (!manager.supportsBufferDeviceAddress()) {
+    fmt::println("Bindless: buffer device addresses not supported, skipped");
+    return true;
+  }
+  auto &kernel = manager.getKernel("shaders/bindless_add.spv");
+
+  const uint32_t N = 100'000;
+  const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  auto a = manager.createBuffer<int32_t>(N, usage, vcm::HostAccess::Random);
+  auto b = manager.createBuffer<int32_t>(N, usage, vcm::HostAccess::Random);
+  vcm::BufferArena arena(manager, vcm::HostAccess::Random);
+  const auto out = arena.allocate<int32_t>(N);
+  {
+    auto aValues = a.write();
+    auto bValues = b.write();
+    for (uint32_t i = 0; i < N; ++i) {
+      aValues[i] = static_cast<int32_t>(i);
+      bValues[i] = -3 * static_cast<int32_t>(i);
+    }
+  }
+
+  auto commandBuffer = manager.beginOneTimeCommands();
+  kernel.dispatchAddresses(commandBuffer, N, a, b, out);
+  vcm::memoryBarrierComputeThenHost(commandBuffer);
+  manager.submitOneTime(commandBuffer).wait();
+
+  arena.invalidate(out);
+  const auto values = out.span<int32_t>();
+  for (uint32_t i = 0; i < N; ++i) {
+    if (values[i] != -2 * static_cast<int32_t>(i)) {
+      fmt::println("Bindless add mismatch at {}: {}", i, values[i]);
+      return false;
+    }
+  }
+  fmt::println("Bindless: add over {} elements by device address ok", N);
+  arena.free(out);
+  return true;
+}
+
+const vcm::test::Registration largeArrayPaths("large_array_paths",
+                                              testLargeArrayPaths);
+const vcm::test::Registration bindless("bindless_add", testBindless);
+
+} // namespace
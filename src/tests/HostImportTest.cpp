@@ -0,0 +1,30 @@
+#include "TestCommon.hpp"
+#include "vcm/HostImport.hpp"
+#include <cstddef>
+#include <fmt/core.h>
+#include <span>
+
+namespace {
+
+// An empty host span, imported or staged, gives an empty HostBuffer whose
+// transfers do nothing
+bool testImportEmpty(vcm::VulkanComputeManager &manager) {
+  for (const bool allowImport : {true, false}) {
+    auto buffer = manager.importHostMemory(
+        std::span<std::byte>(), vk::BufferUsageFlagBits::eStorageBuffer,
+        allowImport);
+    buffer.upload();
+    buffer.download();
+    if (buffer.buffer() || buffer.size() != 0 || buffer.imported()) {
+      fmt::println("Empty import (allowImport {}) has a buffer or a size",
+                   allowImport);
+      return false;
+    }
+  }
+  return true;
+}
+
+const vcm::test::Registration importEmpty("host_import_empty",
+                                          testImportEmpty);
+
+} // namespace
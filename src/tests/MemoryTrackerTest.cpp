@@ -0,0 +1,55 @@
+#include "TestCommon.hpp"
+#include "vcm/Scheduler.hpp"
+#include <cstdint>
+#include <fmt/core.h>
+
+namespace {
+
+// Count a tagged buffer and drop it, cross a tiny soft limit, which should
+// send the scheduler to the CPU
+bool testMemoryTracker(vcm::VulkanComputeManager &manager) {
+  auto &memory = manager.get_memoryTracker();
+  const size_t N = size_t{1} << 22U;
+  {
+    const auto buffer = manager.createBuffer<uint32_t>(
+        N, vk::BufferUsageFlagBits::eStorageBuffer, vcm::HostAccess::None,
+        "check");
+    const auto tags = memory.tags();
+    const auto it = tags.find("check");
+    if (it == tags.end() || it->second.count != 1 ||
+        it->second.bytes < N * sizeof(uint32_t)) {
+      fmt::println("Tagged buffer not tracked");
+      return false;
+    }
+  }
+  if (memory.tags().at("check").bytes != 0) {
+    fmt::println("Destroyed buffer still tracked");
+    return false;
+  }
+
+  int crossings = 0;
+  memory.setSoftLimit(1e-9, [&crossings](const auto &heap) {
+    fmt::println("Heap {} over the soft limit: {} of {} bytes", heap.heap,
+                 heap.usage, heap.budget);
+    ++crossings;
+  });
+  vcm::Scheduler scheduler(manager);
+  const bool throttled =
+      scheduler.choose(uint64_t{1} << 30U) == vcm::Backend::Cpu;
+  memory.clearSoftLimit();
+  if (crossings == 0 || !throttled) {
+    fmt::println("Soft limit not enforced: {} crossings, throttled {}",
+                 crossings, throttled);
+    return false;
+  }
+
+  fmt::println("Memory{}: {}",
+               memory.hasBudgetExtension() ? " (VK_EXT_memory_budget)" : "",
+               memory.snapshotJson());
+  return true;
+}
+
+const vcm::test::Registration memoryTracker("memory_tracker",
+                                            testMemoryTracker);
+
+} // namespace
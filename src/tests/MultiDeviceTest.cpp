@@ -0,0 +1,59 @@
+#include "TestCommon.hpp"
+#include "vcm/MultiDevice.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+// Shard element-wise work and reductions over two logical devices, two GPUs
+// or twice the same one, and compare with the host. The devices have their
+// own managers.
+bool testMultiDevice(vcm::VulkanComputeManager & /*manager*/) {
+  vcm::MultiDevice devices(2);
+  fmt::println("Multi-device weights: {:.3f}",
+               fmt::join(devices.weights(), ", "));
+
+  const size_t N = 1'000'003;
+  std::vector<float> a(N);
+  std::vector<float> b(N);
+  std::vector<float> sum(N);
+  std::vector<uint32_t> values(N);
+  for (size_t i = 0; i < N; ++i) {
+    a[i] = static_cast<float>(i % 1000);
+    b[i] = static_cast<float>(i % 7);
+    values[i] = static_cast<uint32_t>((i * 2654435761ULL) % 1000003);
+  }
+
+  devices.add<float>(a, b, sum);
+  for (size_t i = 0; i < N; ++i) {
+    if (sum[i] != a[i] + b[i]) {
+      fmt::println("Multi-device add mismatch at {}: {} != {}", i, sum[i],
+                   a[i] + b[i]);
+      return false;
+    }
+  }
+
+  const auto expectedSum = std::accumulate(values.begin(), values.end(), 0U);
+  const auto expectedArgMax = static_cast<uint32_t>(
+      std::ranges::max_element(values) - values.begin());
+  const auto gpuSum = devices.sum(values);
+  const auto gpuArgMax = devices.argMax(values);
+  if (gpuSum != expectedSum || gpuArgMax != expectedArgMax) {
+    fmt::println("Multi-device reduce mismatch: sum {} != {} or argmax {} "
+                 "!= {}",
+                 gpuSum, expectedSum, gpuArgMax, expectedArgMax);
+    return false;
+  }
+  fmt::println("Multi-device add, sum and argmax over {} elements on {} "
+               "devices OK",
+               N, devices.size());
+  return true;
+}
+
+const vcm::test::Registration multiDevice("multi_device", testMultiDevice);
+
+} // namespace
@@ -0,0 +1,50 @@
+#include "TestCommon.hpp"
+#include "vcm/Primitives.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fmt/core.h>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+// Sum, argmax and scans of a few million elements on the GPU against the
+// standard library. More than one tile level, so every scan pass runs.
+bool testPrimitives(vcm::VulkanComputeManager &manager) {
+  vcm::Primitives primitives(manager);
+
+  const uint32_t N = 5'000'000;
+  const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  auto input =
+      manager.createBuffer<uint32_t>(N, usage, vcm::HostAccess::Random);
+  auto output =
+      manager.createBuffer<uint32_t>(N, usage, vcm::HostAccess::Random);
+  std::vector<uint32_t> expected(N);
+  for (uint32_t i = 0; i < N; ++i) {
+    expected[i] = (i * 2654435761U) >> 20U;
+  }
+  std::ranges::copy(expected, input.write().begin());
+
+  const auto sum = primitives.sum(input);
+  const auto argMax = primitives.argMax(input);
+  primitives.inclusiveScan(input, output);
+  std::vector<uint32_t> scanned(N);
+  std::inclusive_scan(expected.begin(), expected.end(), scanned.begin());
+  const bool inclusiveOk = std::ranges::equal(output.read(), scanned);
+  primitives.exclusiveScan(input, output);
+  std::exclusive_scan(expected.begin(), expected.end(), scanned.begin(), 0U);
+  const bool exclusiveOk = std::ranges::equal(output.read(), scanned);
+
+  const bool ok =
+      sum == std::reduce(expected.begin(), expected.end(), 0U) &&
+      argMax == static_cast<uint32_t>(std::ranges::max_element(expected) -
+                                      expected.begin()) &&
+      inclusiveOk && exclusiveOk;
+  fmt::println("Primitives over {} elements: sum {}, argmax {}, scans {}", N,
+               sum, argMax, ok ? "ok" : "MISMATCH");
+  return ok;
+}
+
+const vcm::test::Registration primitives("primitives", testPrimitives);
+
+} // namespace
@@ -0,0 +1,87 @@
+#include "TestCommon.hpp"
+#include "vcm/RadixSort.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fmt/core.h>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr auto USAGE = vk::BufferUsageFlagBits::eStorageBuffer;
+
+// Random keys against std::sort, over counts around the tile size and a few
+// million, with all 32 key bits and with 8
+bool testSortKeys(vcm::VulkanComputeManager &manager) {
+  vcm::RadixSort sorter(manager);
+  std::mt19937 generator(42);
+
+  for (const uint32_t keyBits : {32U, 8U}) {
+    for (const uint32_t N :
+         {1U, vcm::RadixSort::TILE_SIZE - 1, vcm::RadixSort::TILE_SIZE + 1,
+          3'000'017U}) {
+      std::vector<uint32_t> expected(N);
+      const auto mask = keyBits == 32 ? UINT32_MAX : (1U << keyBits) - 1;
+      std::ranges::generate(expected, [&] { return generator() & mask; });
+
+      auto keys =
+          manager.createBuffer<uint32_t>(N, USAGE, vcm::HostAccess::Random);
+      std::ranges::copy(expected, keys.write().begin());
+      sorter.sort(keys, keyBits);
+      std::ranges::sort(expected);
+
+      if (!std::ranges::equal(keys.read(), expected)) {
+        fmt::println("Radix sort of {} {} bit keys differs from std::sort", N,
+                     keyBits);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Key-value pairs against std::stable_sort: the keys must be in order and
+// every value must follow its key
+bool testSortPairs(vcm::VulkanComputeManager &manager) {
+  vcm::RadixSort sorter(manager);
+
+  const uint32_t N = 1'000'003;
+  auto keys = manager.createBuffer<uint32_t>(N, USAGE, vcm::HostAccess::Random);
+  auto values =
+      manager.createBuffer<uint32_t>(N, USAGE, vcm::HostAccess::Random);
+  std::vector<std::pair<uint32_t, uint32_t>> expected(N);
+  for (uint32_t i = 0; i < N; ++i) {
+    // Few distinct keys, so stability matters
+    expected[i] = {(i * 2654435761U) % 10007U, i};
+  }
+  {
+    auto keyData = keys.write();
+    auto valueData = values.write();
+    for (uint32_t i = 0; i < N; ++i) {
+      keyData[i] = expected[i].first;
+      valueData[i] = expected[i].second;
+    }
+  }
+
+  sorter.sort(keys, values);
+  std::ranges::stable_sort(expected, {}, &std::pair<uint32_t, uint32_t>::first);
+
+  const auto sortedKeys = keys.read();
+  const auto sortedValues = values.read();
+  for (uint32_t i = 0; i < N; ++i) {
+    if (sortedKeys[i] != expected[i].first ||
+        sortedValues[i] != expected[i].second) {
+      fmt::println("Radix sort pair {} is ({}, {}), expected ({}, {})", i,
+                   sortedKeys[i], sortedValues[i], expected[i].first,
+                   expected[i].second);
+      return false;
+    }
+  }
+  return true;
+}
+
+const vcm::test::Registration sortKeys("radix_sort_keys", testSortKeys);
+const vcm::test::Registration sortPairs("radix_sort_pairs", testSortPairs);
+
+} // namespace
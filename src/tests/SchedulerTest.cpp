@@ -0,0 +1,39 @@
+#include "TestCommon.hpp"
+#include "vcm/Scheduler.hpp"
+#include <cstdint>
+#include <fmt/core.h>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+// Square a small and a large array through the scheduler, which should keep
+// the small one on the CPU, and check both
+bool testScheduler(vcm::VulkanComputeManager &manager) {
+  vcm::Scheduler scheduler(manager);
+  for (const size_t N : {size_t{10}, size_t{1} << 22U}) {
+    std::vector<uint32_t> in(N);
+    std::vector<uint32_t> out(N);
+    std::iota(in.begin(), in.end(), 0);
+    scheduler.square<uint32_t>(in, out);
+    const auto backend = scheduler.lastBackend();
+    for (size_t i = 0; i < N; ++i) {
+      if (out[i] != in[i] * in[i]) {
+        fmt::println("Scheduled square mismatch at {} of {}", i, N);
+        return false;
+      }
+    }
+    const auto expectedSum = std::accumulate(in.begin(), in.end(), 0U);
+    if (scheduler.sum(in) != expectedSum) {
+      fmt::println("Scheduled sum mismatch over {}", N);
+      return false;
+    }
+    fmt::println("Scheduled square of {} elements ran on the {}", N,
+                 backend == vcm::Backend::Gpu ? "GPU" : "CPU");
+  }
+  return true;
+}
+
+const vcm::test::Registration scheduler("scheduler", testScheduler);
+
+} // namespace
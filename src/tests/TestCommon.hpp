@@ -0,0 +1,20 @@
+#pragma once
+
+#include "vcm/VulkanComputeManager.hpp"
+#include <string>
+
+namespace vcm::test {
+
+// A test against the shared manager, printing what failed before returning
+// false
+using TestFunction = bool (*)(VulkanComputeManager &manager);
+
+// Registers test under name at static initialization, e.g.
+// const vcm::test::Registration registration("radix_sort", testRadixSort);
+// CMakeLists.txt adds one CTest test per name.
+class Registration {
+public:
+  Registration(std::string name, TestFunction test);
+};
+
+} // namespace vcm::test
@@ -0,0 +1,62 @@
+#include "TestCommon.hpp"
+#include <exception>
+#include <fmt/core.h>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace vcm::test {
+
+namespace {
+
+std::map<std::string, TestFunction> &registry() {
+  static std::map<std::string, TestFunction> tests;
+  return tests;
+}
+
+} // namespace
+
+Registration::Registration(std::string name, TestFunction test) {
+  registry().emplace(std::move(name), test);
+}
+
+} // namespace vcm::test
+
+// vcm_tests [name...]: run the named tests, or all of them, on one manager.
+// --list prints the names.
+int main(int argc, char *argv[]) {
+  const auto &tests = vcm::test::registry();
+  std::map<std::string, vcm::test::TestFunction> selected;
+  for (int i = 1; i < argc; ++i) {
+    const std::string name = argv[i];
+    if (name == "--list") {
+      for (const auto &[testName, test] : tests) {
+        fmt::println("{}", testName);
+      }
+      return 0;
+    }
+    const auto it = tests.find(name);
+    if (it == tests.end()) {
+      fmt::println("Unknown test '{}'", name);
+      return 1;
+    }
+    selected.insert(*it);
+  }
+  if (selected.empty()) {
+    selected = tests;
+  }
+
+  vcm::VulkanComputeManager manager;
+  int failures = 0;
+  for (const auto &[name, test] : selected) {
+    bool passed = false;
+    try {
+      passed = test(manager);
+    } catch (const std::exception &e) {
+      fmt::println("{}: {}", name, e.what());
+    }
+    fmt::println("[{}] {}", passed ? "PASS" : "FAIL", name);
+    failures += passed ? 0 : 1;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include "TestCommon.hpp"
+#include "vcm/TypedElementwise.hpp"
+#include <cstdint>
+#include <fmt/core.h>
+
+namespace {
+
+// Typed permutations picked from the element type: half add and uint8
+// square over a count that does not fill the last 128 bit vector
+bool testTypedKernels(vcm::VulkanComputeManager &manager) {
+  const uint32_t N = 1001;
+  const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  const auto access = vcm::HostAccess::Random;
+
+  auto a = manager.createBuffer<vcm::Half>(N, usage, access);
+  auto b = manager.createBuffer<vcm::Half>(N, usage, access);
+  auto sum = manager.createBuffer<vcm::Half>(N, usage, access);
+  auto bytes = manager.createBuffer<uint8_t>(N, usage, access);
+  auto squares = manager.createBuffer<uint8_t>(N, usage, access);
+  {
+    auto aData = a.write();
+    auto bData = b.write();
+    auto byteData = bytes.write();
+    for (uint32_t i = 0; i < N; ++i) {
+      aData[i] = vcm::Half::fromFloat(static_cast<float>(i) * 0.25F);
+      bData[i] = vcm::Half::fromFloat(1.5F);
+      byteData[i] = static_cast<uint8_t>(i);
+    }
+  }
+
+  auto cmdBuffer = manager.beginOneTimeCommands();
+  vcm::recordAdd(manager, cmdBuffer, a, b, sum);
+  vcm::recordSquare(manager, cmdBuffer, bytes, squares);
+  vcm::memoryBarrierComputeThenHost(cmdBuffer);
+  manager.submitOneTime(cmdBuffer).wait();
+
+  const auto sums = sum.read();
+  const auto squared = squares.read();
+  bool ok = true;
+  for (uint32_t i = 0; i < N && ok; ++i) {
+    const auto expected = vcm::Half::fromFloat(static_cast<float>(i) * 0.25F +
+                                               1.5F);
+    ok = sums[i].bits == expected.bits &&
+         squared[i] == static_cast<uint8_t>(i * i);
+  }
+  fmt::println("Typed kernels (half add, uint8 square) over {} elements: {}",
+               N, ok ? "ok" : "MISMATCH");
+  return ok;
+}
+
+const vcm::test::Registration typedKernels("typed_kernels", testTypedKernels);
+
+} // namespace
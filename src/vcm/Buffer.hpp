@@ -1,7 +1,18 @@
 #pragma once
 
 #include "Common.hpp"
+#include "DescriptorAllocator.hpp"
+#include "MemoryTracker.hpp"
 #include "VmaUsage.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
 namespace vcm {
 
@@ -25,4 +36,251 @@ struct VcmBuffer {
   }
 };
 
-} // namespace vcm
\ No newline at end of file
+// A buffer passed to a kernel by address rather than through a descriptor.
+// Matches BufferAddress in shaders/bindless.hlsli.
+struct BufferAddress {
+  vk::DeviceAddress address{};
+  // Bytes
+  vk::DeviceSize size{};
+};
+static_assert(sizeof(BufferAddress) == 16);
+
+// How the host touches a Buffer's memory
+enum class HostAccess {
+  // Device local, not mapped. Filled and read back by copies.
+  None,
+  // Mapped, written by the host front to back (uploads, uniforms).
+  // Typically write-combined: do not read through it.
+  SequentialWrite,
+  // Mapped, cached host memory for reading back and random access
+  Random,
+};
+
+/*
+Typed, move-only buffer of count elements of T.
+
+Buffers with host access are persistently mapped for their whole lifetime
+(VMA_ALLOCATION_CREATE_MAPPED_BIT), so span() is the memory itself: fill it
+in place instead of building a std::vector and copying it in. On memory that
+is not host coherent, write() flushes when the returned scope ends and read()
+invalidates first; on coherent memory both are free.
+
+With a DescriptorSetCache, the buffer is forgotten by it on destruction so
+no cached set outlives it. With a MemoryTracker, its allocation is counted
+under tag for the buffer's lifetime. Created with eShaderDeviceAddress usage,
+it has an address() for kernels that take buffers by address.
+*/
+template <typename T> class Buffer {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Buffer elements are copied to and from the device bytewise");
+
+public:
+  // Span over the mapped memory that flushes it when destroyed
+  class WriteScope {
+  public:
+    explicit WriteScope(Buffer &buffer) : m_buffer(&buffer) {}
+
+    WriteScope(const WriteScope &) = delete;
+    WriteScope(WriteScope &&) = delete;
+    WriteScope &operator=(const WriteScope &) = delete;
+    WriteScope &operator=(WriteScope &&) = delete;
+
+    ~WriteScope() { m_buffer->flush(); }
+
+    [[nodiscard]] std::span<T> span() const { return m_buffer->span(); }
+    [[nodiscard]] T *begin() const { return span().data(); }
+    [[nodiscard]] T *end() const { return begin() + span().size(); }
+    [[nodiscard]] size_t size() const { return span().size(); }
+    T &operator[](size_t i) const { return span()[i]; }
+
+  private:
+    Buffer *m_buffer;
+  };
+
+  static constexpr vk::DeviceSize VECTOR_BYTES = 16;
+
+  Buffer() = default;
+
+  Buffer(VmaAllocator allocator, size_t count, vk::BufferUsageFlags usage,
+         HostAccess access = HostAccess::None,
+         DescriptorSetCache *descriptorSets = nullptr,
+         MemoryTracker *memory = nullptr, std::string_view tag = {})
+      : m_allocator(allocator), m_descriptorSets(descriptorSets),
+        m_memory(memory), m_count(count) {
+    vk::BufferCreateInfo createInfo{vk::BufferCreateFlags(), paddedBytes(),
+                                    usage, vk::SharingMode::eExclusive};
+
+    VmaAllocationCreateInfo allocInfo{};
+    switch (access) {
+    case HostAccess::None:
+      allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+      break;
+    case HostAccess::SequentialWrite:
+      allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+      allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                        VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      break;
+    case HostAccess::Random:
+      allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+      allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                        VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      break;
+    }
+
+    VmaAllocationInfo info{};
+    const auto result =
+        vmaCreateBuffer(m_allocator, toVk(&createInfo), &allocInfo, &m_buffer,
+                        &m_allocation, &info);
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error(fmt::format(
+          "Failed to create buffer of {} bytes: {}", bytes(),
+          vk::to_string(static_cast<vk::Result>(result))));
+    }
+
+    if (m_memory != nullptr) {
+      m_memory->track(m_allocation, tag);
+    }
+
+    if (usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+      VmaAllocatorInfo allocatorInfo{};
+      vmaGetAllocatorInfo(m_allocator, &allocatorInfo);
+      m_address = vk::Device(allocatorInfo.device)
+                      .getBufferAddress(vk::BufferDeviceAddressInfo(m_buffer));
+    }
+
+    m_mapped = static_cast<T *>(info.pMappedData);
+    if (m_mapped != nullptr) {
+      VkMemoryPropertyFlags flags = 0;
+      vmaGetAllocationMemoryProperties(m_allocator, m_allocation, &flags);
+      m_coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    }
+  }
+
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+
+  Buffer(Buffer &&other) noexcept { swap(other); }
+  Buffer &operator=(Buffer &&other) noexcept {
+    Buffer(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  ~Buffer() {
+    if (m_buffer == VK_NULL_HANDLE) {
+      return;
+    }
+    if (m_descriptorSets != nullptr) {
+      m_descriptorSets->forget(m_buffer);
+    }
+    vmaDestroyBuffer(m_allocator, m_buffer, m_allocation);
+    // After the release, so the soft limit check sees the lower usage
+    if (m_memory != nullptr) {
+      m_memory->untrack(m_allocation);
+    }
+  }
+
+  [[nodiscard]] bool valid() const { return m_buffer != VK_NULL_HANDLE; }
+  [[nodiscard]] vk::Buffer buffer() const { return m_buffer; }
+  [[nodiscard]] VmaAllocation allocation() const { return m_allocation; }
+  [[nodiscard]] size_t size() const { return m_count; }
+  [[nodiscard]] vk::DeviceSize bytes() const { return m_count * sizeof(T); }
+  // The allocation, rounded up to whole VECTOR_BYTES vectors so kernels can
+  // load and store 128 bits at a time up to the end
+  [[nodiscard]] vk::DeviceSize paddedBytes() const {
+    return (bytes() + VECTOR_BYTES - 1) / VECTOR_BYTES * VECTOR_BYTES;
+  }
+
+  // Elements [first, first + count) for binding to a kernel, count clamped
+  // to the end. As for flush() and invalidate(), first must not be past the
+  // end.
+  [[nodiscard]] vk::DescriptorBufferInfo
+  descriptor(size_t first = 0, size_t count = SIZE_MAX) const {
+    count = std::min(count, m_count - checkedFirst(first));
+    return {m_buffer, first * sizeof(T), count * sizeof(T)};
+  }
+
+  // The whole allocation, padding included
+  [[nodiscard]] vk::DescriptorBufferInfo paddedDescriptor() const {
+    return {m_buffer, 0, paddedBytes()};
+  }
+
+  // Device address and size for ComputeKernel::dispatchAddresses(). The
+  // address is 0 without eShaderDeviceAddress usage.
+  [[nodiscard]] BufferAddress address() const { return {m_address, bytes()}; }
+
+  [[nodiscard]] bool mapped() const { return m_mapped != nullptr; }
+  [[nodiscard]] bool coherent() const { return m_coherent; }
+
+  // The mapped memory. Empty if the buffer has no host access. Writes need
+  // a flush() and device writes an invalidate() unless coherent(); prefer
+  // write() and read() which do that.
+  [[nodiscard]] std::span<T> span() const {
+    return m_mapped != nullptr ? std::span<T>(m_mapped, m_count)
+                               : std::span<T>();
+  }
+
+  // Fill the buffer in place through the returned scope, flushed when it
+  // ends
+  [[nodiscard]] WriteScope write() { return WriteScope(*this); }
+
+  // The contents, with device writes made visible. The device writes must
+  // have completed (their ticket waited on).
+  [[nodiscard]] std::span<const T> read() const {
+    invalidate();
+    return span();
+  }
+
+  // Make host writes to elements [first, first + count) visible to the
+  // device. No-op on coherent memory.
+  void flush(size_t first = 0, size_t count = SIZE_MAX) const {
+    if (m_mapped != nullptr && !m_coherent) {
+      count = std::min(count, m_count - checkedFirst(first));
+      vmaFlushAllocation(m_allocator, m_allocation, first * sizeof(T),
+                         count * sizeof(T));
+    }
+  }
+
+  // Make device writes to elements [first, first + count) visible to the
+  // host. No-op on coherent memory.
+  void invalidate(size_t first = 0, size_t count = SIZE_MAX) const {
+    if (m_mapped != nullptr && !m_coherent) {
+      count = std::min(count, m_count - checkedFirst(first));
+      vmaInvalidateAllocation(m_allocator, m_allocation, first * sizeof(T),
+                              count * sizeof(T));
+    }
+  }
+
+  void swap(Buffer &other) noexcept {
+    std::swap(m_allocator, other.m_allocator);
+    std::swap(m_descriptorSets, other.m_descriptorSets);
+    std::swap(m_memory, other.m_memory);
+    std::swap(m_buffer, other.m_buffer);
+    std::swap(m_allocation, other.m_allocation);
+    std::swap(m_address, other.m_address);
+    std::swap(m_mapped, other.m_mapped);
+    std::swap(m_count, other.m_count);
+    std::swap(m_coherent, other.m_coherent);
+  }
+
+private:
+  // first, if a range may start there
+  [[nodiscard]] size_t checkedFirst(size_t first) const {
+    if (first > m_count) {
+      throw std::runtime_error(fmt::format(
+          "Range from element {} of a buffer of {}.", first, m_count));
+    }
+    return first;
+  }
+
+  VmaAllocator m_allocator{};
+  DescriptorSetCache *m_descriptorSets{};
+  MemoryTracker *m_memory{};
+  VkBuffer m_buffer{};
+  VmaAllocation m_allocation{};
+  vk::DeviceAddress m_address{};
+  T *m_mapped{};
+  size_t m_count{0};
+  bool m_coherent{true};
+};
+
+} // namespace vcm
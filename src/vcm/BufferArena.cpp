@@ -0,0 +1,251 @@
+#include "BufferArena.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <utility>
+
+namespace vcm {
+
+namespace {
+
+constexpr auto ARENA_USAGE = vk::BufferUsageFlagBits::eStorageBuffer |
+                             vk::BufferUsageFlagBits::eTransferSrc |
+                             vk::BufferUsageFlagBits::eTransferDst;
+
+// Frame slices are told apart from persistent ones by this bit of their
+// block index
+constexpr uint32_t FRAME_BLOCK_BIT = 1U << 31U;
+
+} // namespace
+
+BufferArena::BufferArena(VulkanComputeManager &manager, HostAccess access,
+                         vk::DeviceSize blockSize, vk::DeviceSize window,
+                         std::string tag)
+    : m_manager(manager), m_access(access), m_blockSize(blockSize),
+      m_window(window), m_tag(std::move(tag)) {
+  const auto &limits = manager.get_physicalDevice().getProperties().limits;
+  m_alignment = std::max(limits.minStorageBufferOffsetAlignment,
+                         Buffer<std::byte>::VECTOR_BYTES);
+
+  if (window == 0 || window > blockSize ||
+      window > limits.maxStorageBufferRange) {
+    throw std::runtime_error(fmt::format(
+        "Arena window of {} bytes must be positive, within the block size "
+        "of {} and maxStorageBufferRange of {}.",
+        window, blockSize, limits.maxStorageBufferRange));
+  }
+  // Dynamic offsets are 32 bit
+  if (blockSize > UINT32_MAX) {
+    throw std::runtime_error(fmt::format(
+        "Arena blocks of {} bytes are beyond 32 bit offsets.", blockSize));
+  }
+}
+
+BufferArena::~BufferArena() {
+  // Live slices are released with their blocks
+  for (auto *blocks : {&m_blocks, &m_frameBlocks}) {
+    for (auto &block : *blocks) {
+      vmaClearVirtualBlock(block->virtualBlock);
+      vmaDestroyVirtualBlock(block->virtualBlock);
+    }
+  }
+}
+
+vk::DeviceSize BufferArena::paddedSize(vk::DeviceSize bytes) const {
+  constexpr auto vector = Buffer<std::byte>::VECTOR_BYTES;
+  return (std::max<vk::DeviceSize>(bytes, 1) + vector - 1) / vector * vector;
+}
+
+std::unique_ptr<BufferArena::Block>
+BufferArena::createBlock(vk::DeviceSize capacity, bool linear) {
+  auto block = std::make_unique<Block>();
+  block->capacity = capacity;
+  block->dedicated = capacity > m_blockSize;
+  // Blocks of the regular size have room for a window at every offset
+  const auto bytes = block->dedicated ? capacity : capacity + m_window;
+  block->buffer =
+      m_manager.createBuffer<std::byte>(bytes, ARENA_USAGE, m_access, m_tag);
+
+  VmaVirtualBlockCreateInfo info{};
+  info.size = capacity;
+  if (linear) {
+    info.flags = VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT;
+  }
+  if (vmaCreateVirtualBlock(&info, &block->virtualBlock) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create a virtual block.");
+  }
+  return block;
+}
+
+ArenaSlice BufferArena::tryAllocate(Block &block, uint32_t index,
+                                    vk::DeviceSize bytes, bool frame) const {
+  VmaVirtualAllocationCreateInfo info{};
+  info.size = bytes;
+  info.alignment = m_alignment;
+  VmaVirtualAllocation allocation{};
+  vk::DeviceSize offset = 0;
+  if (vmaVirtualAllocate(block.virtualBlock, &info, &allocation, &offset) !=
+      VK_SUCCESS) {
+    return {};
+  }
+
+  ArenaSlice slice;
+  slice.buffer = block.buffer.buffer();
+  slice.offset = offset;
+  slice.size = bytes;
+  slice.block = frame ? index | FRAME_BLOCK_BIT : index;
+  slice.allocation = frame ? VmaVirtualAllocation{} : allocation;
+  if (block.buffer.mapped()) {
+    slice.mapped = block.buffer.span().data() + offset;
+  }
+  if (const auto base = block.buffer.address().address; base != 0) {
+    slice.deviceAddress = base + offset;
+  }
+  return slice;
+}
+
+ArenaSlice BufferArena::allocate(vk::DeviceSize bytes) {
+  bytes = paddedSize(bytes);
+  const bool dedicated = bytes > m_blockSize;
+  std::scoped_lock lock(m_mutex);
+  for (uint32_t i = 0; i < m_blocks.size(); ++i) {
+    if (m_blocks[i]->dedicated != dedicated) {
+      continue;
+    }
+    if (auto slice = tryAllocate(*m_blocks[i], i, bytes, false);
+        slice.valid()) {
+      return slice;
+    }
+  }
+  m_blocks.push_back(createBlock(std::max(bytes, m_blockSize), false));
+  const auto index = static_cast<uint32_t>(m_blocks.size() - 1);
+  return tryAllocate(*m_blocks.back(), index, bytes, false);
+}
+
+void BufferArena::free(const ArenaSlice &slice) {
+  if (!slice.valid() || slice.allocation == VK_NULL_HANDLE) {
+    return;
+  }
+  std::scoped_lock lock(m_mutex);
+  vmaVirtualFree(m_blocks.at(slice.block)->virtualBlock, slice.allocation);
+}
+
+ArenaSlice BufferArena::allocateFrame(vk::DeviceSize bytes) {
+  bytes = paddedSize(bytes);
+  std::scoped_lock lock(m_mutex);
+  if (bytes > m_blockSize) {
+    // Any dedicated frame block with room, without moving the bump position
+    for (uint32_t i = 0; i < m_frameBlocks.size(); ++i) {
+      if (!m_frameBlocks[i]->dedicated) {
+        continue;
+      }
+      if (auto slice = tryAllocate(*m_frameBlocks[i], i, bytes, true);
+          slice.valid()) {
+        return slice;
+      }
+    }
+    m_frameBlocks.push_back(createBlock(bytes, true));
+    const auto index = static_cast<uint32_t>(m_frameBlocks.size() - 1);
+    return tryAllocate(*m_frameBlocks.back(), index, bytes, true);
+  }
+
+  // Bump through the regular frame blocks in order, never back to an
+  // earlier one
+  for (; m_frameBlock < m_frameBlocks.size(); ++m_frameBlock) {
+    const auto index = static_cast<uint32_t>(m_frameBlock);
+    if (m_frameBlocks[index]->dedicated) {
+      continue;
+    }
+    if (auto slice = tryAllocate(*m_frameBlocks[index], index, bytes, true);
+        slice.valid()) {
+      return slice;
+    }
+  }
+  m_frameBlocks.push_back(createBlock(m_blockSize, true));
+  m_frameBlock = m_frameBlocks.size() - 1;
+  return tryAllocate(*m_frameBlocks.back(),
+                     static_cast<uint32_t>(m_frameBlock), bytes, true);
+}
+
+void BufferArena::resetFrame() {
+  std::scoped_lock lock(m_mutex);
+  for (auto &block : m_frameBlocks) {
+    vmaClearVirtualBlock(block->virtualBlock);
+  }
+  m_frameBlock = 0;
+}
+
+const BufferArena::Block &BufferArena::block(const ArenaSlice &slice) const {
+  std::scoped_lock lock(m_mutex);
+  const auto index = slice.block & ~FRAME_BLOCK_BIT;
+  const auto &blocks =
+      (slice.block & FRAME_BLOCK_BIT) != 0 ? m_frameBlocks : m_blocks;
+  return *blocks.at(index);
+}
+
+void BufferArena::flush(const ArenaSlice &slice) const {
+  block(slice).buffer.flush(slice.offset, slice.size);
+}
+
+void BufferArena::invalidate(const ArenaSlice &slice) const {
+  block(slice).buffer.invalidate(slice.offset, slice.size);
+}
+
+vk::DescriptorSet
+BufferArena::bind(const ComputeKernel &kernel,
+                  std::span<const ArenaSlice> slices) const {
+  if (kernel.dynamicOffsetCount() != slices.size()) {
+    throw std::runtime_error(fmt::format(
+        "Kernel '{}' takes {} dynamic buffers, got {} slices.", kernel.name(),
+        kernel.dynamicOffsetCount(), slices.size()));
+  }
+  std::vector<vk::DescriptorBufferInfo> windows;
+  windows.reserve(slices.size());
+  for (const auto &slice : slices) {
+    if (slice.size > m_window) {
+      throw std::runtime_error(fmt::format(
+          "Slice of {} bytes is larger than the arena's window of {}; bind "
+          "its descriptor() instead.",
+          slice.size, m_window));
+    }
+    // Guaranteed by keeping small slices out of dedicated blocks
+    if (slice.offset > UINT32_MAX ||
+        slice.offset + m_window > block(slice).buffer.bytes()) {
+      throw std::runtime_error(fmt::format(
+          "Arena window at offset {} does not fit its block.", slice.offset));
+    }
+    windows.emplace_back(slice.buffer, 0, m_window);
+  }
+  return kernel.bind(std::span<const vk::DescriptorBufferInfo>(windows));
+}
+
+void BufferArena::dispatchElements(vk::CommandBuffer commandBuffer,
+                                   const ComputeKernel &kernel,
+                                   std::span<const ArenaSlice> slices,
+                                   uint32_t elementCount) const {
+  const auto descriptorSet = bind(kernel, slices);
+  std::vector<uint32_t> offsets;
+  offsets.reserve(slices.size());
+  for (const auto &slice : slices) {
+    offsets.push_back(slice.dynamicOffset());
+  }
+  kernel.dispatchElements(commandBuffer, descriptorSet, offsets,
+                          elementCount);
+}
+
+BufferArena::Stats BufferArena::stats() const {
+  std::scoped_lock lock(m_mutex);
+  Stats stats{m_blocks.size(), m_frameBlocks.size(), 0, 0, 0};
+  for (const auto *blocks : {&m_blocks, &m_frameBlocks}) {
+    for (const auto &block : *blocks) {
+      VmaStatistics statistics{};
+      vmaGetVirtualBlockStatistics(block->virtualBlock, &statistics);
+      stats.blockBytes += block->buffer.paddedBytes();
+      stats.sliceBytes += statistics.allocationBytes;
+      stats.slices += statistics.allocationCount;
+    }
+  }
+  return stats;
+}
+
+} // namespace vcm
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "ComputeKernel.hpp"
+#include "VmaUsage.hpp"
+#include "VulkanComputeManager.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+// A logical buffer carved out of a BufferArena block
+struct ArenaSlice {
+  vk::Buffer buffer;
+  vk::DeviceSize offset{};
+  vk::DeviceSize size{};
+  // Null unless the arena is host visible
+  std::byte *mapped{};
+  uint32_t block{};
+  // Null for frame slices, which are only freed by resetFrame()
+  VmaVirtualAllocation allocation{};
+  // 0 unless the device supports buffer device addresses
+  vk::DeviceAddress deviceAddress{};
+
+  [[nodiscard]] bool valid() const { return static_cast<bool>(buffer); }
+  [[nodiscard]] vk::DescriptorBufferInfo descriptor() const {
+    return {buffer, offset, size};
+  }
+  // For ComputeKernel::dispatchAddresses()
+  [[nodiscard]] BufferAddress address() const { return {deviceAddress, size}; }
+  // Offset for a dynamic binding of the arena's window of the block
+  [[nodiscard]] uint32_t dynamicOffset() const {
+    return static_cast<uint32_t>(offset);
+  }
+  // The mapped elements. Empty if the arena has no host access.
+  template <typename T> [[nodiscard]] std::span<T> span() const {
+    return mapped != nullptr
+               ? std::span<T>(reinterpret_cast<T *>(mapped), size / sizeof(T))
+               : std::span<T>();
+  }
+};
+
+/*
+Many small logical buffers in a few large VkBuffers.
+
+Each block is one Buffer, sub-allocated with a VmaVirtualBlock: allocate()
+and free() are a virtual allocation instead of a buffer and its memory, and
+slices in the same block share its descriptors. Frame slices come from
+separate linear blocks, bump allocated, and are all released at once by
+resetFrame() once the GPU is done with them.
+
+Slices are aligned to minStorageBufferOffsetAlignment and padded to whole
+16 byte vectors. A slice of at most window() bytes can be bound through a
+kernel created with dynamic offsets: bind() gives one set per combination
+of blocks, binding a window() sized range at offset 0, and each dispatch
+passes the slices' offsets. So one set serves every slice of a block, and
+binding new slices updates no descriptors. Each block's buffer is window()
+bytes longer than its allocatable size so every window fits. Larger slices
+bind through descriptor() like any buffer range. Requests larger than the
+block size get dedicated blocks, never shared with smaller slices, so every
+slice bind() accepts has its window within the block and a 32 bit offset.
+
+Thread safe. Freeing a slice, or resetting frames, while the GPU still uses
+it is the caller's to avoid.
+*/
+class BufferArena {
+public:
+  static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = vk::DeviceSize{64} << 20U;
+  static constexpr vk::DeviceSize DEFAULT_WINDOW = vk::DeviceSize{1} << 20U;
+
+  explicit BufferArena(VulkanComputeManager &manager,
+                       HostAccess access = HostAccess::None,
+                       vk::DeviceSize blockSize = DEFAULT_BLOCK_SIZE,
+                       vk::DeviceSize window = DEFAULT_WINDOW,
+                       std::string tag = "arena");
+
+  BufferArena(const BufferArena &) = delete;
+  BufferArena(BufferArena &&) = delete;
+  BufferArena &operator=(const BufferArena &) = delete;
+  BufferArena &operator=(BufferArena &&) = delete;
+
+  ~BufferArena();
+
+  [[nodiscard]] vk::DeviceSize blockSize() const { return m_blockSize; }
+  [[nodiscard]] vk::DeviceSize window() const { return m_window; }
+  [[nodiscard]] vk::DeviceSize alignment() const { return m_alignment; }
+
+  // Slice of at least bytes, until free()
+  ArenaSlice allocate(vk::DeviceSize bytes);
+  template <typename T> ArenaSlice allocate(size_t count) {
+    return allocate(count * sizeof(T));
+  }
+  void free(const ArenaSlice &slice);
+
+  // Slice of at least bytes, until resetFrame()
+  ArenaSlice allocateFrame(vk::DeviceSize bytes);
+  template <typename T> ArenaSlice allocateFrame(size_t count) {
+    return allocateFrame(count * sizeof(T));
+  }
+  // Release every frame slice
+  void resetFrame();
+
+  // Make host writes to the slice visible to the device, and device writes
+  // visible to the host. No-ops on coherent memory.
+  void flush(const ArenaSlice &slice) const;
+  void invalidate(const ArenaSlice &slice) const;
+
+  // Cached set binding the window of each slice's block to kernel's
+  // bindings in order. The kernel must have been created with dynamic
+  // offsets.
+  [[nodiscard]] vk::DescriptorSet
+  bind(const ComputeKernel &kernel, std::span<const ArenaSlice> slices) const;
+
+  // Record kernel over elementCount elements of slices, bound through
+  // bind() at their offsets
+  void dispatchElements(vk::CommandBuffer commandBuffer,
+                        const ComputeKernel &kernel,
+                        std::span<const ArenaSlice> slices,
+                        uint32_t elementCount) const;
+
+  struct Stats {
+    size_t blocks;
+    size_t frameBlocks;
+    // Reserved by VkBuffers, and in live slices
+    vk::DeviceSize blockBytes;
+    vk::DeviceSize sliceBytes;
+    uint32_t slices;
+  };
+  [[nodiscard]] Stats stats() const;
+
+private:
+  struct Block {
+    Buffer<std::byte> buffer;
+    VmaVirtualBlock virtualBlock{};
+    vk::DeviceSize capacity{};
+    // Larger than the block size, for oversized requests only
+    bool dedicated{};
+  };
+
+  VulkanComputeManager &m_manager;
+  HostAccess m_access;
+  vk::DeviceSize m_blockSize;
+  vk::DeviceSize m_window;
+  vk::DeviceSize m_alignment;
+  std::string m_tag;
+
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<Block>> m_blocks;
+  std::vector<std::unique_ptr<Block>> m_frameBlocks;
+  // Frame block being bump allocated from
+  size_t m_frameBlock{0};
+
+  std::unique_ptr<Block> createBlock(vk::DeviceSize capacity, bool linear);
+  [[nodiscard]] vk::DeviceSize paddedSize(vk::DeviceSize bytes) const;
+  ArenaSlice tryAllocate(Block &block, uint32_t index, vk::DeviceSize bytes,
+                         bool frame) const;
+  [[nodiscard]] const Block &block(const ArenaSlice &slice) const;
+};
+
+} // namespace vcm
@@ -0,0 +1,151 @@
+#include "CommandPools.hpp"
+#include "Profiler.hpp"
+#include <atomic>
+
+namespace vcm {
+
+namespace {
+
+std::atomic<uint64_t> nextRegistryId{1};
+
+} // namespace
+
+CommandPoolRegistry::CommandPoolRegistry(vk::Device device,
+                                         uint32_t queueFamilyIndex,
+                                         Profiler *profiler)
+    : m_device(device), m_queueFamilyIndex(queueFamilyIndex),
+      m_profiler(profiler), m_id(nextRegistryId++) {}
+
+CommandPoolRegistry::~CommandPoolRegistry() {
+  // Destroying a pool frees its command buffers
+  for (const auto &[thread, pool] : m_pools) {
+    m_device.destroyCommandPool(pool->pool);
+  }
+}
+
+CommandPoolRegistry::PerThread &CommandPoolRegistry::threadPool() {
+  // Cache the lookup per thread so only a thread's first call takes the lock.
+  // Keyed by registry id rather than address, which may be reused.
+  thread_local std::unordered_map<uint64_t, PerThread *> cache;
+  if (const auto it = cache.find(m_id); it != cache.end()) {
+    return *it->second;
+  }
+
+  std::scoped_lock lock(m_mutex);
+  auto &pool = m_pools[std::this_thread::get_id()];
+  if (!pool) {
+    pool = std::make_unique<PerThread>();
+
+    // Command buffers are recycled by resetting the whole pool each epoch,
+    // so no per-buffer reset flag.
+    vk::CommandPoolCreateInfo poolInfo{};
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+    poolInfo.queueFamilyIndex = m_queueFamilyIndex;
+    pool->pool = m_device.createCommandPool(poolInfo);
+  }
+  cache[m_id] = pool.get();
+  return *pool;
+}
+
+vk::CommandBuffer
+CommandPoolRegistry::allocate(vk::CommandBufferLevel level) {
+  auto &pool = threadPool();
+
+  const bool primary = level == vk::CommandBufferLevel::ePrimary;
+  auto &buffers = primary ? pool.primaries : pool.secondaries;
+  auto &next = primary ? pool.nextPrimary : pool.nextSecondary;
+
+  if (next == buffers.size()) {
+    buffers.push_back(
+        m_device.allocateCommandBuffers({pool.pool, level, 1}).front());
+  }
+  return buffers[next++];
+}
+
+void CommandPoolRegistry::reset() {
+  std::scoped_lock lock(m_mutex);
+  for (const auto &[thread, pool] : m_pools) {
+    if (m_profiler != nullptr) {
+      for (size_t i = 0; i < pool->nextPrimary; ++i) {
+        m_profiler->discard(pool->primaries[i]);
+      }
+      for (size_t i = 0; i < pool->nextSecondary; ++i) {
+        m_profiler->discard(pool->secondaries[i]);
+      }
+    }
+    m_device.resetCommandPool(pool->pool);
+    pool->nextPrimary = 0;
+    pool->nextSecondary = 0;
+  }
+}
+
+size_t CommandPoolRegistry::poolCount() const {
+  std::scoped_lock lock(m_mutex);
+  return m_pools.size();
+}
+
+CommandBufferRecycler::CommandBufferRecycler(vk::Device device,
+                                             uint32_t queueFamilyIndex,
+                                             Profiler *profiler)
+    : m_device(device), m_profiler(profiler) {
+  // Short lived command buffers, reset individually when reused
+  vk::CommandPoolCreateInfo poolInfo{};
+  poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient |
+                   vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+  poolInfo.queueFamilyIndex = queueFamilyIndex;
+  m_pool = m_device.createCommandPool(poolInfo);
+}
+
+CommandBufferRecycler::~CommandBufferRecycler() {
+  for (const auto &[commandBuffer, ticket] : m_pending) {
+    try {
+      ticket.wait();
+    } catch (const std::exception &) { // NOLINT(*-empty-catch)
+      // Device lost, nothing left to wait for
+    }
+  }
+  m_device.destroyCommandPool(m_pool);
+}
+
+vk::CommandBuffer CommandBufferRecycler::begin() {
+  std::scoped_lock lock(m_mutex);
+
+  // Move everything the GPU is done with to the free list. Submissions
+  // mostly complete in order, so stop at the first one still running.
+  while (!m_pending.empty() && m_pending.front().second.ready()) {
+    m_free.push_back(m_pending.front().first);
+    m_pending.pop_front();
+  }
+
+  vk::CommandBuffer commandBuffer;
+  if (m_free.empty()) {
+    commandBuffer = m_device
+                        .allocateCommandBuffers(
+                            {m_pool, vk::CommandBufferLevel::ePrimary, 1})
+                        .front();
+    ++m_allocations;
+  } else {
+    commandBuffer = m_free.back();
+    m_free.pop_back();
+    if (m_profiler != nullptr) {
+      m_profiler->discard(commandBuffer);
+    }
+    commandBuffer.reset();
+    ++m_reuses;
+  }
+
+  commandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  return commandBuffer;
+}
+
+void CommandBufferRecycler::recycle(vk::CommandBuffer commandBuffer,
+                                    const Ticket &ticket) {
+  std::scoped_lock lock(m_mutex);
+  if (ticket.valid()) {
+    m_pending.emplace_back(commandBuffer, ticket);
+  } else {
+    m_free.push_back(commandBuffer);
+  }
+}
+
+} // namespace vcm
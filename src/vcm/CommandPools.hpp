@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Timeline.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+class Profiler;
+
+/*
+One command pool per recording thread.
+
+vk::CommandPool and the command buffers allocated from it must be externally
+synchronized, so each thread gets its own pool, created lazily the first time
+the thread allocates. Command buffers are handed out for the current epoch;
+reset() recycles all of them at once with vkResetCommandPool, which is
+cheaper than resetting or freeing buffers individually. With a Profiler,
+the scopes of command buffers that never executed are discarded first.
+*/
+class CommandPoolRegistry {
+public:
+  CommandPoolRegistry(vk::Device device, uint32_t queueFamilyIndex,
+                      Profiler *profiler = nullptr);
+
+  CommandPoolRegistry(const CommandPoolRegistry &) = delete;
+  CommandPoolRegistry(CommandPoolRegistry &&) = delete;
+  CommandPoolRegistry &operator=(const CommandPoolRegistry &) = delete;
+  CommandPoolRegistry &operator=(CommandPoolRegistry &&) = delete;
+
+  ~CommandPoolRegistry();
+
+  [[nodiscard]] auto queueFamilyIndex() const { return m_queueFamilyIndex; }
+
+  // Command buffer from the calling thread's pool, valid until the next
+  // reset(). Not yet begun.
+  vk::CommandBuffer allocate(
+      vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+
+  // Start a new epoch: reset every thread's pool and recycle its command
+  // buffers. No command buffer from the previous epoch may be pending on the
+  // GPU or being recorded.
+  void reset();
+
+  // Number of thread pools created so far
+  [[nodiscard]] size_t poolCount() const;
+
+private:
+  struct PerThread {
+    vk::CommandPool pool;
+    // Allocated so far; the first next* of each are in use this epoch
+    std::vector<vk::CommandBuffer> primaries;
+    std::vector<vk::CommandBuffer> secondaries;
+    size_t nextPrimary{};
+    size_t nextSecondary{};
+  };
+
+  vk::Device m_device;
+  uint32_t m_queueFamilyIndex;
+  Profiler *m_profiler;
+
+  // Distinguishes registries in the thread local lookup cache
+  uint64_t m_id;
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::thread::id, std::unique_ptr<PerThread>> m_pools;
+
+  PerThread &threadPool();
+};
+
+/*
+One time submit command buffers that are recycled instead of reallocated.
+
+A command buffer handed back with recycle() is reset and reused once the
+ticket of its submission completes. After warm up a steady workload allocates
+nothing, which the allocation/reuse counters confirm. With a Profiler, the
+scopes of a command buffer that never executed are discarded before it is
+reset.
+*/
+class CommandBufferRecycler {
+public:
+  CommandBufferRecycler(vk::Device device, uint32_t queueFamilyIndex,
+                        Profiler *profiler = nullptr);
+
+  CommandBufferRecycler(const CommandBufferRecycler &) = delete;
+  CommandBufferRecycler(CommandBufferRecycler &&) = delete;
+  CommandBufferRecycler &operator=(const CommandBufferRecycler &) = delete;
+  CommandBufferRecycler &operator=(CommandBufferRecycler &&) = delete;
+
+  ~CommandBufferRecycler();
+
+  // A primary command buffer in the recording state
+  vk::CommandBuffer begin();
+
+  // Return a submitted command buffer. It becomes reusable once ticket
+  // completes. An invalid ticket means it was never submitted.
+  void recycle(vk::CommandBuffer commandBuffer, const Ticket &ticket);
+
+  struct Stats {
+    uint64_t allocations;
+    uint64_t reuses;
+  };
+  [[nodiscard]] Stats stats() const {
+    return {m_allocations.load(), m_reuses.load()};
+  }
+
+private:
+  vk::Device m_device;
+  vk::CommandPool m_pool;
+  Profiler *m_profiler;
+
+  // Guards the pool and the lists below. Recording into a command buffer
+  // from begin() is the caller's business, but must not overlap with
+  // another thread's begin() on the same recycler.
+  std::mutex m_mutex;
+  std::deque<std::pair<vk::CommandBuffer, Ticket>> m_pending;
+  std::vector<vk::CommandBuffer> m_free;
+
+  std::atomic<uint64_t> m_allocations{0};
+  std::atomic<uint64_t> m_reuses{0};
+};
+
+} // namespace vcm
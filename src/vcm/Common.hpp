@@ -1,8 +1,19 @@
 #pragma once
 
 #include "VmaUsage.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <fmt/format.h>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <vulkan/vulkan.hpp>
 
 namespace vcm {
@@ -17,4 +28,121 @@ inline auto toVk(const vk::BufferCreateInfo *createInfo) {
   return reinterpret_cast<VkBufferCreateInfo const *>(createInfo);
 }
 
+/*
+64 bit FNV-1a hash. Used for cache keys and file checksums.
+*/
+constexpr uint64_t FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+
+inline uint64_t fnv1a(const void *data, size_t size,
+                      uint64_t hash = FNV1A_OFFSET_BASIS) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];         // NOLINT
+    hash *= 0x100000001b3ULL; // NOLINT
+  }
+  return hash;
+}
+
+/*
+Timing for calibrations and benchmarks: secondsOf() times f, fastestOf()
+the fastest of runs calls of run, which returns a time, after an untimed
+one that warms up caches and clocks.
+*/
+template <typename F> double secondsOf(F &&f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+template <typename Run> double fastestOf(int runs, Run &&run) {
+  run();
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < runs; ++i) {
+    best = std::min(best, static_cast<double>(run()));
+  }
+  return best;
+}
+
+/*
+A path next to path to write before renaming it over path. Unique per call,
+so processes saving the same file at once do not write into each other's.
+*/
+inline fs::path tempPathFor(const fs::path &path) {
+  thread_local std::mt19937_64 generator{std::random_device{}()};
+  auto tmpPath = path;
+  tmpPath += fmt::format(".{:016x}.tmp", generator());
+  return tmpPath;
+}
+
+/*
+Write path through write(std::ostream &) into a tempPathFor() file renamed
+over it, so readers never see a partial file. Creates the parent
+directories. Throws if the file cannot be written, leaving path as it was.
+*/
+template <typename Write>
+void writeFileAtomically(const fs::path &path, Write &&write) {
+  if (path.has_parent_path()) {
+    fs::create_directories(path.parent_path());
+  }
+
+  const auto tmpPath = tempPathFor(path);
+  const auto discard = [&tmpPath] {
+    std::error_code ignored;
+    fs::remove(tmpPath, ignored);
+  };
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      throw std::runtime_error(
+          fmt::format("Failed to open {} for writing", tmpPath.string()));
+    }
+    try {
+      write(file);
+    } catch (...) {
+      file.close();
+      discard();
+      throw;
+    }
+    if (!file) {
+      file.close();
+      discard();
+      throw std::runtime_error(
+          fmt::format("Failed to write {}", tmpPath.string()));
+    }
+  }
+
+  // rename replaces the destination atomically on POSIX and Win32
+  fs::rename(tmpPath, path);
+}
+
+/*
+Text escaped for a JSON string literal
+*/
+inline std::string jsonEscape(std::string_view text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    switch (c) {
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        escaped += fmt::format("\\u{:04x}", c);
+      } else {
+        escaped += c;
+      }
+    }
+  }
+  return escaped;
+}
+
 } // namespace vcm
\ No newline at end of file
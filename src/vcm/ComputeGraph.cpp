@@ -0,0 +1,273 @@
+#include "ComputeGraph.hpp"
+#include "VulkanComputeManager.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+namespace vcm {
+
+namespace {
+
+struct StageAccess {
+  vk::PipelineStageFlags stage;
+  vk::AccessFlags read;
+  vk::AccessFlags write;
+};
+
+} // namespace
+
+ComputeGraph::ComputeGraph(VulkanComputeManager &manager)
+    : m_manager(manager) {}
+
+void ComputeGraph::setBuffer(const std::string &name, vk::Buffer buffer,
+                             vk::DeviceSize size) {
+  m_buffers.insert_or_assign(name, BufferInfo{buffer, size});
+}
+
+ComputeGraph &ComputeGraph::dispatch(ComputeKernel &kernel,
+                                     std::vector<Range> buffers,
+                                     uint32_t elementCount) {
+  Node node{NodeType::Dispatch};
+  node.elementCount = elementCount;
+  return addKernel(kernel, std::move(buffers), std::move(node));
+}
+
+ComputeGraph &ComputeGraph::dispatch(ComputeKernel &kernel,
+                                     std::vector<Range> buffers,
+                                     std::array<uint32_t, 3> groupCount,
+                                     std::span<const std::byte> pushConstants) {
+  Node node{NodeType::Dispatch};
+  node.groupCount = groupCount;
+  node.pushConstants.assign(pushConstants.begin(), pushConstants.end());
+  return addKernel(kernel, std::move(buffers), std::move(node));
+}
+
+ComputeGraph &ComputeGraph::addKernel(ComputeKernel &kernel,
+                                      std::vector<Range> buffers, Node node) {
+  const auto &bindings = kernel.reflection().bindings;
+  if (buffers.size() != bindings.size()) {
+    throw std::runtime_error(
+        fmt::format("Kernel '{}' has {} bindings, got {} buffers.",
+                    kernel.name(), bindings.size(), buffers.size()));
+  }
+
+  node.kernel = &kernel;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    node.uses.push_back({std::move(buffers[i]), !bindings[i].writeOnly,
+                         !bindings[i].readOnly});
+  }
+  m_nodes.push_back(std::move(node));
+  return *this;
+}
+
+ComputeGraph &ComputeGraph::copy(Range src, Range dst) {
+  Node node{NodeType::Copy};
+  node.uses.push_back({std::move(src), true, false});
+  node.uses.push_back({std::move(dst), false, true});
+  m_nodes.push_back(std::move(node));
+  return *this;
+}
+
+ComputeGraph &ComputeGraph::fill(Range dst, uint32_t value) {
+  Node node{NodeType::Fill};
+  node.uses.push_back({std::move(dst), false, true});
+  node.value = value;
+  m_nodes.push_back(std::move(node));
+  return *this;
+}
+
+ComputeGraph &ComputeGraph::hostRead(Range range) {
+  Node node{NodeType::HostRead};
+  node.uses.push_back({std::move(range), true, false});
+  m_nodes.push_back(std::move(node));
+  return *this;
+}
+
+void ComputeGraph::clear() {
+  m_nodes.clear();
+  m_stats = {};
+}
+
+ComputeGraph::Access ComputeGraph::resolve(const Use &use) const {
+  const auto it = m_buffers.find(use.range.buffer);
+  if (it == m_buffers.end()) {
+    throw std::runtime_error(fmt::format(
+        "Compute graph buffer '{}' is not set.", use.range.buffer));
+  }
+  const auto &[buffer, bufferSize] = it->second;
+  const auto size = use.range.size == vk::WholeSize
+                        ? bufferSize - std::min(use.range.offset, bufferSize)
+                        : use.range.size;
+  if (use.range.offset + size > bufferSize) {
+    throw std::runtime_error(fmt::format(
+        "Range [{}, {}) is outside compute graph buffer '{}' of {} bytes.",
+        use.range.offset, use.range.offset + size, use.range.buffer,
+        bufferSize));
+  }
+  return {buffer, use.range.offset, use.range.offset + size, use.read,
+          use.write};
+}
+
+void ComputeGraph::record(vk::CommandBuffer commandBuffer) {
+  const auto stageAccess = [](NodeType type) -> StageAccess {
+    switch (type) {
+    case NodeType::Dispatch:
+      return {vk::PipelineStageFlagBits::eComputeShader,
+              vk::AccessFlagBits::eShaderRead,
+              vk::AccessFlagBits::eShaderWrite};
+    case NodeType::Copy:
+    case NodeType::Fill:
+      return {vk::PipelineStageFlagBits::eTransfer,
+              vk::AccessFlagBits::eTransferRead,
+              vk::AccessFlagBits::eTransferWrite};
+    case NodeType::HostRead:
+      return {vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostRead,
+              {}};
+    }
+    return {};
+  };
+
+  std::vector<std::vector<Access>> accesses(m_nodes.size());
+  for (size_t i = 0; i < m_nodes.size(); ++i) {
+    for (const auto &use : m_nodes[i].uses) {
+      accesses[i].push_back(resolve(use));
+    }
+  }
+
+  // A node goes one batch after the latest earlier node it conflicts with
+  struct Conflict {
+    size_t producer;
+    Access before;
+    Access after;
+  };
+  std::vector<size_t> batchOf(m_nodes.size(), 0);
+  std::vector<std::vector<Conflict>> conflicts(m_nodes.size());
+  size_t batchCount = m_nodes.empty() ? 0 : 1;
+  for (size_t node = 0; node < m_nodes.size(); ++node) {
+    for (size_t earlier = 0; earlier < node; ++earlier) {
+      for (const auto &before : accesses[earlier]) {
+        for (const auto &after : accesses[node]) {
+          if (before.buffer == after.buffer && before.begin < after.end &&
+              after.begin < before.end && (before.write || after.write)) {
+            batchOf[node] = std::max(batchOf[node], batchOf[earlier] + 1);
+            conflicts[node].push_back({earlier, before, after});
+          }
+        }
+      }
+    }
+    batchCount = std::max(batchCount, batchOf[node] + 1);
+  }
+
+  m_stats = {batchCount, 0, 0};
+  for (size_t batch = 0; batch < batchCount; ++batch) {
+    // One barrier for everything this batch waits on. Ranges written before
+    // need a memory barrier, others only the execution dependency.
+    vk::PipelineStageFlags srcStages;
+    vk::PipelineStageFlags dstStages;
+    std::map<std::tuple<VkBuffer, vk::DeviceSize, vk::DeviceSize>,
+             std::pair<vk::AccessFlags, vk::AccessFlags>>
+        ranges;
+    for (size_t node = 0; node < m_nodes.size(); ++node) {
+      if (batchOf[node] != batch) {
+        continue;
+      }
+      const auto dst = stageAccess(m_nodes[node].type);
+      for (const auto &[producer, before, after] : conflicts[node]) {
+        const auto src = stageAccess(m_nodes[producer].type);
+        srcStages |= src.stage;
+        dstStages |= dst.stage;
+        if (before.write) {
+          auto &[srcAccess, dstAccess] =
+              ranges[{before.buffer, std::max(before.begin, after.begin),
+                      std::min(before.end, after.end)}];
+          srcAccess |= src.write;
+          dstAccess |= (after.read ? dst.read : vk::AccessFlags{}) |
+                       (after.write ? dst.write : vk::AccessFlags{});
+        }
+      }
+    }
+
+    if (srcStages) {
+      std::vector<vk::BufferMemoryBarrier> barriers;
+      barriers.reserve(ranges.size());
+      for (const auto &[range, access] : ranges) {
+        const auto &[buffer, begin, end] = range;
+        barriers.emplace_back(access.first, access.second,
+                              VK_QUEUE_FAMILY_IGNORED,
+                              VK_QUEUE_FAMILY_IGNORED, buffer, begin,
+                              end - begin);
+      }
+      commandBuffer.pipelineBarrier(srcStages, dstStages, {}, {}, barriers,
+                                    {});
+      ++m_stats.pipelineBarriers;
+      m_stats.bufferBarriers += barriers.size();
+    }
+
+    for (size_t node = 0; node < m_nodes.size(); ++node) {
+      if (batchOf[node] == batch) {
+        recordNode(commandBuffer, m_nodes[node], accesses[node]);
+      }
+    }
+  }
+}
+
+void ComputeGraph::recordNode(vk::CommandBuffer commandBuffer,
+                              const Node &node,
+                              std::span<const Access> accesses) const {
+  switch (node.type) {
+  case NodeType::Dispatch: {
+    std::vector<vk::DescriptorBufferInfo> infos;
+    infos.reserve(accesses.size());
+    for (const auto &access : accesses) {
+      infos.emplace_back(access.buffer, access.begin,
+                         access.end - access.begin);
+    }
+    const auto descriptorSet =
+        node.kernel->bind(std::span<const vk::DescriptorBufferInfo>(infos));
+
+    if (node.elementCount.has_value()) {
+      node.kernel->dispatchElements(commandBuffer, descriptorSet,
+                                    node.elementCount.value());
+      break;
+    }
+    if (!node.pushConstants.empty()) {
+      commandBuffer.pushConstants(
+          node.kernel->pipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0,
+          static_cast<uint32_t>(node.pushConstants.size()),
+          node.pushConstants.data());
+    }
+    node.kernel->dispatch(commandBuffer, descriptorSet, node.groupCount[0],
+                          node.groupCount[1], node.groupCount[2]);
+    break;
+  }
+
+  case NodeType::Copy: {
+    const auto &src = accesses[0];
+    const auto &dst = accesses[1];
+    commandBuffer.copyBuffer(
+        src.buffer, dst.buffer,
+        vk::BufferCopy(src.begin, dst.begin,
+                       std::min(src.end - src.begin, dst.end - dst.begin)));
+    break;
+  }
+
+  case NodeType::Fill:
+    commandBuffer.fillBuffer(accesses[0].buffer, accesses[0].begin,
+                             accesses[0].end - accesses[0].begin, node.value);
+    break;
+
+  case NodeType::HostRead:
+    // Only its barrier
+    break;
+  }
+}
+
+Ticket ComputeGraph::submit(std::span<const Ticket> waitFor) {
+  auto commandBuffer = m_manager.beginOneTimeCommands();
+  record(commandBuffer);
+  return m_manager.submitOneTime(commandBuffer, waitFor);
+}
+
+} // namespace vcm
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "ComputeKernel.hpp"
+#include "Timeline.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+class VulkanComputeManager;
+
+/*
+Kernels and copies over named buffers, recorded as one command buffer.
+
+Nodes are added in program order and refer to buffers by name; the names are
+bound to actual buffers with setBuffer(), so a graph can be built once and
+rerun over other buffers. Reads and writes of kernels come from their
+reflection (read only for HLSL StructuredBuffer, write only for NonReadable,
+read-write otherwise).
+
+record() puts every node in the earliest batch after all nodes it conflicts
+with: overlapping ranges of a buffer where at least one side writes. Nodes
+in one batch are independent and recorded back to back. Between batches goes
+a single pipeline barrier with buffer memory barriers for exactly the ranges
+written before and accessed after; write-after-read conflicts only need the
+execution dependency.
+
+hostRead() marks a range the host reads after the submission, which makes
+the writes to it visible to the host.
+*/
+class ComputeGraph {
+public:
+  // Bytes [offset, offset + size) of a named buffer
+  struct Range {
+    std::string buffer;
+    vk::DeviceSize offset{0};
+    vk::DeviceSize size{vk::WholeSize};
+
+    Range(std::string buffer, vk::DeviceSize offset = 0,
+          vk::DeviceSize size = vk::WholeSize)
+        : buffer(std::move(buffer)), offset(offset), size(size) {}
+    Range(const char *buffer) : Range(std::string(buffer)) {}
+  };
+
+  explicit ComputeGraph(VulkanComputeManager &manager);
+
+  // Bind name to buffer, for this and later record() calls
+  void setBuffer(const std::string &name, vk::Buffer buffer,
+                 vk::DeviceSize size);
+  template <typename T>
+  void setBuffer(const std::string &name, const Buffer<T> &buffer) {
+    setBuffer(name, buffer.buffer(), buffer.bytes());
+  }
+
+  // kernel over elementCount elements (see ComputeKernel::dispatchElements)
+  // with buffers bound to its bindings in order
+  ComputeGraph &dispatch(ComputeKernel &kernel, std::vector<Range> buffers,
+                         uint32_t elementCount);
+
+  // kernel over an explicit grid. pushConstants, if any, are pushed at
+  // offset 0.
+  ComputeGraph &dispatch(ComputeKernel &kernel, std::vector<Range> buffers,
+                         std::array<uint32_t, 3> groupCount,
+                         std::span<const std::byte> pushConstants = {});
+
+  // Copy src to dst, the smaller of the two sizes
+  ComputeGraph &copy(Range src, Range dst);
+
+  // Fill dst with a repeated 32 bit value
+  ComputeGraph &fill(Range dst, uint32_t value);
+
+  // The host reads range once the submission completes
+  ComputeGraph &hostRead(Range range);
+
+  // Record the whole graph into commandBuffer, on the compute queue family
+  void record(vk::CommandBuffer commandBuffer);
+
+  // Record into a one time command buffer and submit it to the compute queue
+  Ticket submit(std::span<const Ticket> waitFor = {});
+
+  // Remove all nodes. Buffer names stay bound.
+  void clear();
+
+  [[nodiscard]] size_t nodeCount() const { return m_nodes.size(); }
+
+  // Of the last record()
+  struct Stats {
+    size_t batches;
+    size_t pipelineBarriers;
+    size_t bufferBarriers;
+  };
+  [[nodiscard]] Stats stats() const { return m_stats; }
+
+private:
+  enum class NodeType { Dispatch, Copy, Fill, HostRead };
+
+  struct Use {
+    Range range;
+    bool read;
+    bool write;
+  };
+
+  struct Node {
+    NodeType type;
+    std::vector<Use> uses;
+
+    // Dispatch
+    ComputeKernel *kernel{};
+    std::array<uint32_t, 3> groupCount{};
+    std::optional<uint32_t> elementCount;
+    std::vector<std::byte> pushConstants;
+
+    // Fill
+    uint32_t value{};
+  };
+
+  // A use resolved to a buffer and absolute byte range
+  struct Access {
+    vk::Buffer buffer;
+    vk::DeviceSize begin;
+    vk::DeviceSize end;
+    bool read;
+    bool write;
+  };
+
+  struct BufferInfo {
+    vk::Buffer buffer;
+    vk::DeviceSize size;
+  };
+
+  VulkanComputeManager &m_manager;
+  std::unordered_map<std::string, BufferInfo> m_buffers;
+  std::vector<Node> m_nodes;
+  Stats m_stats{};
+
+  ComputeGraph &addKernel(ComputeKernel &kernel, std::vector<Range> buffers,
+                          Node node);
+  [[nodiscard]] Access resolve(const Use &use) const;
+  void recordNode(vk::CommandBuffer commandBuffer, const Node &node,
+                  std::span<const Access> accesses) const;
+};
+
+} // namespace vcm
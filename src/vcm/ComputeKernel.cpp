@@ -0,0 +1,392 @@
+#include "ComputeKernel.hpp"
+#include "Common.hpp"
+#include "Shader.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace vcm {
+
+ComputeKernel::ComputeKernel(vk::Device device,
+                             vk::PipelineCache pipelineCache,
+                             DescriptorSetCache &descriptorSets,
+                             std::span<const uint32_t> spirv,
+                             const char *entryPoint, Profiler *profiler,
+                             std::string name,
+                             ShaderModuleCache *shaderModules,
+                             bool dynamicOffsets)
+    : m_device(device), m_descriptorSets(descriptorSets), m_profiler(profiler),
+      m_name(name.empty() ? entryPoint : std::move(name)),
+      m_hash(KernelCache::hash(spirv, entryPoint)),
+      m_pipelineCache(pipelineCache), m_entryPoint(entryPoint),
+      m_reflection(reflectSpirv(spirv, entryPoint)),
+      m_workgroupSize(m_reflection.localSize) {
+
+  // 1. Descriptor set layout from the reflected bindings
+  m_layoutBindings.reserve(m_reflection.bindings.size());
+  for (const auto &binding : m_reflection.bindings) {
+    if (binding.set != 0) {
+      throw std::runtime_error(fmt::format(
+          "Binding '{}' uses descriptor set {}, only set 0 is supported.",
+          binding.name, binding.set));
+    }
+    auto type = binding.type;
+    if (dynamicOffsets && type == vk::DescriptorType::eStorageBuffer) {
+      type = vk::DescriptorType::eStorageBufferDynamic;
+      m_zeroOffsets.resize(m_zeroOffsets.size() + binding.count, 0);
+    }
+    m_layoutBindings.emplace_back(binding.binding, type, binding.count,
+                                  vk::ShaderStageFlagBits::eCompute);
+  }
+  m_descriptorSetLayout = m_device.createDescriptorSetLayout(
+      {vk::DescriptorSetLayoutCreateFlags(), m_layoutBindings});
+
+  // 2. Pipeline layout, with the push constant block if there is one
+  vk::PushConstantRange pushConstantRange{vk::ShaderStageFlagBits::eCompute, 0,
+                                          m_reflection.pushConstantSize};
+  vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo(
+      vk::PipelineLayoutCreateFlags(), m_descriptorSetLayout);
+  if (m_reflection.pushConstantSize > 0) {
+    pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+  }
+  m_pipelineLayout = m_device.createPipelineLayout(pipelineLayoutCreateInfo);
+
+  // 3. Shader module, with the workgroup size made specializable. It is kept
+  // to create pipelines for other workgroup sizes.
+  // Shared through shaderModules if given.
+  const auto load = [&](std::span<const uint32_t> code) {
+    m_ownsShader = shaderModules == nullptr;
+    return shaderModules != nullptr ? shaderModules->get(code)
+                                    : loadShader(m_device, code);
+  };
+  if (auto specializable = makeWorkgroupSizeSpecializable(spirv, entryPoint)) {
+    m_specializable = true;
+    m_shader = load(*specializable);
+  } else {
+    m_shader = load(spirv);
+  }
+
+  // 4. Pipeline for the shader's own [numthreads]
+  m_pipeline = createPipeline(m_workgroupSize);
+  m_pipelines.emplace(m_workgroupSize[0], m_pipeline);
+}
+
+vk::Pipeline
+ComputeKernel::createPipeline(const std::array<uint32_t, 3> &workgroupSize) {
+  std::array<vk::SpecializationMapEntry, 3> entries;
+  for (uint32_t i = 0; i < 3; ++i) {
+    entries[i] = {WORKGROUP_SIZE_SPEC_IDS[i],
+                  static_cast<uint32_t>(i * sizeof(uint32_t)),
+                  sizeof(uint32_t)};
+  }
+  vk::SpecializationInfo specializationInfo{};
+  specializationInfo.setMapEntries(entries);
+  specializationInfo.dataSize = sizeof(workgroupSize);
+  specializationInfo.pData = workgroupSize.data();
+
+  vk::PipelineShaderStageCreateInfo shaderStageCreateInfo(
+      vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute,
+      m_shader, m_entryPoint.c_str(),
+      m_specializable ? &specializationInfo : nullptr);
+  vk::ComputePipelineCreateInfo computePipelineCreateInfo(
+      vk::PipelineCreateFlags(), shaderStageCreateInfo, m_pipelineLayout);
+
+  auto pipeline =
+      m_device.createComputePipeline(m_pipelineCache, computePipelineCreateInfo);
+  if (pipeline.result != vk::Result::eSuccess) {
+    throw std::runtime_error("Failed to create commpute pipeline.");
+  }
+  return pipeline.value;
+}
+
+void ComputeKernel::setWorkgroupSize(uint32_t x) {
+  std::scoped_lock lock(m_pipelinesMutex);
+  if (x == m_workgroupSize[0]) {
+    return;
+  }
+  if (!m_specializable) {
+    throw std::runtime_error(fmt::format(
+        "Kernel '{}' has a fixed workgroup size, cannot use {}.", m_name, x));
+  }
+
+  auto &pipeline = m_pipelines[x];
+  if (!pipeline) {
+    pipeline = createPipeline({x, m_workgroupSize[1], m_workgroupSize[2]});
+  }
+  m_pipeline = pipeline;
+  m_workgroupSize[0] = x;
+}
+
+ComputeKernel::~ComputeKernel() {
+  m_descriptorSets.forgetLayout(m_descriptorSetLayout);
+  for (const auto &[size, pipeline] : m_pipelines) {
+    m_device.destroyPipeline(pipeline);
+  }
+  if (m_ownsShader) {
+    m_device.destroyShaderModule(m_shader);
+  }
+  m_device.destroyPipelineLayout(m_pipelineLayout);
+  m_device.destroyDescriptorSetLayout(m_descriptorSetLayout);
+}
+
+vk::DescriptorSet
+ComputeKernel::bind(std::span<const vk::DescriptorBufferInfo> buffers) const {
+  if (buffers.size() != m_layoutBindings.size()) {
+    throw std::runtime_error(
+        fmt::format("Kernel expects {} buffers, got {}.",
+                    m_layoutBindings.size(), buffers.size()));
+  }
+  return m_descriptorSets.get(m_descriptorSetLayout, m_layoutBindings,
+                              buffers);
+}
+
+void ComputeKernel::write(
+    vk::DescriptorSet descriptorSet,
+    std::span<const vk::DescriptorBufferInfo> buffers) const {
+  if (buffers.size() != m_layoutBindings.size()) {
+    throw std::runtime_error(
+        fmt::format("Kernel expects {} buffers, got {}.",
+                    m_layoutBindings.size(), buffers.size()));
+  }
+
+  std::vector<vk::WriteDescriptorSet> writes;
+  writes.reserve(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    const auto &binding = m_layoutBindings[i];
+    writes.emplace_back(descriptorSet, binding.binding, 0, 1,
+                        binding.descriptorType, nullptr, &buffers[i]);
+  }
+  m_device.updateDescriptorSets(writes, {});
+}
+
+void ComputeKernel::dispatch(vk::CommandBuffer commandBuffer,
+                             vk::DescriptorSet descriptorSet,
+                             uint32_t groupCountX, uint32_t groupCountY,
+                             uint32_t groupCountZ) const {
+  dispatch(commandBuffer, descriptorSet, m_zeroOffsets, groupCountX,
+           groupCountY, groupCountZ);
+}
+
+void ComputeKernel::dispatch(vk::CommandBuffer commandBuffer,
+                             vk::DescriptorSet descriptorSet,
+                             std::span<const uint32_t> dynamicOffsets,
+                             uint32_t groupCountX, uint32_t groupCountY,
+                             uint32_t groupCountZ) const {
+  if (dynamicOffsets.size() != m_zeroOffsets.size()) {
+    throw std::runtime_error(
+        fmt::format("Kernel '{}' takes {} dynamic offsets, got {}.", m_name,
+                    m_zeroOffsets.size(), dynamicOffsets.size()));
+  }
+  const auto scope = m_profiler != nullptr
+                         ? m_profiler->gpuScope(commandBuffer, m_name)
+                         : GpuScope{};
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+  if (descriptorSet) {
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     m_pipelineLayout, 0, {descriptorSet},
+                                     dynamicOffsets);
+  }
+  commandBuffer.dispatch(groupCountX, groupCountY, groupCountZ);
+}
+
+void ComputeKernel::dispatchElements(vk::CommandBuffer commandBuffer,
+                                     vk::DescriptorSet descriptorSet,
+                                     uint32_t elementCount) const {
+  dispatchElements(commandBuffer, descriptorSet, m_zeroOffsets, elementCount);
+}
+
+void ComputeKernel::dispatchElements(vk::CommandBuffer commandBuffer,
+                                     vk::DescriptorSet descriptorSet,
+                                     std::span<const uint32_t> dynamicOffsets,
+                                     uint32_t elementCount) const {
+  // { count, base } at the start of the push constant block
+  struct ElementRange {
+    uint32_t count;
+    uint32_t base;
+  };
+  const auto pushSize = m_reflection.pushConstantSize;
+  const bool hasBase = pushSize >= sizeof(ElementRange);
+
+  const auto groups = groupCount(elementCount);
+  const uint64_t maxGroups = m_limits.maxGroupCountX;
+  if (groups > maxGroups && !hasBase) {
+    throw std::runtime_error(fmt::format(
+        "Kernel '{}' needs {} workgroups, more than the {} of one dispatch, "
+        "and takes no base element to split it.",
+        m_name, groups, maxGroups));
+  }
+
+  for (uint64_t first = 0; first < groups; first += maxGroups) {
+    const ElementRange range{
+        elementCount, static_cast<uint32_t>(first * m_workgroupSize[0])};
+    if (hasBase) {
+      pushConstants(commandBuffer, range);
+    } else if (pushSize >= sizeof(uint32_t)) {
+      pushConstants(commandBuffer, range.count);
+    }
+    dispatch(commandBuffer, descriptorSet, dynamicOffsets,
+             static_cast<uint32_t>(std::min(maxGroups, groups - first)));
+  }
+}
+
+void ComputeKernel::dispatchAddresses(vk::CommandBuffer commandBuffer,
+                                      std::span<const BufferAddress> addresses,
+                                      uint32_t elementCount) const {
+  if (!m_reflection.bindings.empty()) {
+    throw std::runtime_error(fmt::format(
+        "Kernel '{}' has {} bindings; only kernels without bindings take "
+        "buffer addresses.",
+        m_name, m_reflection.bindings.size()));
+  }
+  const auto bytes = static_cast<uint32_t>(addresses.size_bytes());
+  if (m_reflection.pushConstantSize < ADDRESS_PUSH_OFFSET + bytes) {
+    throw std::runtime_error(fmt::format(
+        "Kernel '{}' has {} bytes of push constants, too few for {} buffer "
+        "addresses after offset {}.",
+        m_name, m_reflection.pushConstantSize, addresses.size(),
+        ADDRESS_PUSH_OFFSET));
+  }
+  for (const auto &address : addresses) {
+    if (address.address == 0) {
+      throw std::runtime_error(fmt::format(
+          "Kernel '{}' was given a buffer without a device address.", m_name));
+    }
+  }
+
+  // The addresses stay pushed across the dispatches of the split
+  commandBuffer.pushConstants(m_pipelineLayout,
+                              vk::ShaderStageFlagBits::eCompute,
+                              ADDRESS_PUSH_OFFSET, bytes, addresses.data());
+  dispatchElements(commandBuffer, vk::DescriptorSet{}, elementCount);
+}
+
+void ComputeKernel::dispatchElements(
+    vk::CommandBuffer commandBuffer,
+    std::span<const vk::DescriptorBufferInfo> buffers,
+    uint64_t elementCount) const {
+  const auto &bindings = m_reflection.bindings;
+  if (buffers.size() != bindings.size()) {
+    throw std::runtime_error(
+        fmt::format("Kernel '{}' has {} bindings, got {} buffers.", m_name,
+                    bindings.size(), buffers.size()));
+  }
+
+  // Elements per chunk: every binding's range within maxStorageBufferRange,
+  // every chunk's offset aligned, and the count within the 32 bit push
+  // constant
+  const auto alignment = m_limits.minStorageBufferOffsetAlignment;
+  for (const auto &buffer : buffers) {
+    if (buffer.offset % alignment != 0) {
+      throw std::runtime_error(fmt::format(
+          "Kernel '{}' was given a range at offset {}, not a multiple of "
+          "minStorageBufferOffsetAlignment ({}).",
+          m_name, buffer.offset, alignment));
+    }
+  }
+  uint64_t chunk = UINT32_MAX;
+  uint64_t multiple = 1;
+  for (const auto &binding : bindings) {
+    const uint64_t stride = binding.elementStride;
+    if (stride == 0) {
+      throw std::runtime_error(fmt::format(
+          "Binding '{}' of kernel '{}' is not an array of elements.",
+          binding.name, m_name));
+    }
+    chunk = std::min(chunk, m_limits.maxStorageBufferRange / stride);
+    multiple = std::lcm(multiple, alignment / std::gcd(alignment, stride));
+  }
+  chunk -= chunk % multiple;
+  if (chunk == 0) {
+    throw std::runtime_error(fmt::format(
+        "Kernel '{}' cannot fit an aligned chunk in maxStorageBufferRange.",
+        m_name));
+  }
+
+  std::vector<vk::DescriptorBufferInfo> ranges(buffers.size());
+  for (uint64_t first = 0; first < elementCount; first += chunk) {
+    const auto count = std::min(chunk, elementCount - first);
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      const auto stride = bindings[i].elementStride;
+      ranges[i] = {buffers[i].buffer, buffers[i].offset + first * stride,
+                   count * stride};
+    }
+    dispatchElements(commandBuffer,
+                     bind(std::span<const vk::DescriptorBufferInfo>(ranges)),
+                     static_cast<uint32_t>(count));
+  }
+}
+
+DispatchLimits DispatchLimits::fromDevice(vk::PhysicalDevice physicalDevice) {
+  const auto &limits = physicalDevice.getProperties().limits;
+  return {limits.maxComputeWorkGroupCount[0], limits.maxStorageBufferRange,
+          limits.minStorageBufferOffsetAlignment};
+}
+
+uint64_t KernelCache::hash(std::span<const uint32_t> spirv,
+                           const char *entryPoint) {
+  const auto h = fnv1a(spirv.data(), spirv.size_bytes());
+  return fnv1a(entryPoint, std::strlen(entryPoint), h);
+}
+
+ComputeKernel &KernelCache::get(std::span<const uint32_t> spirv,
+                                const char *entryPoint, bool dynamicOffsets) {
+  return getOrCreate(spirv, entryPoint, dynamicOffsets);
+}
+
+ComputeKernel &KernelCache::get(const std::string &shaderFileName,
+                                const char *entryPoint, bool dynamicOffsets) {
+  auto nameKey = shaderFileName + ':' + entryPoint;
+  if (dynamicOffsets) {
+    nameKey += ":dynamic";
+  }
+  {
+    std::scoped_lock lock(m_mutex);
+    if (const auto it = m_kernelsByName.find(nameKey);
+        it != m_kernelsByName.end()) {
+      return *it->second;
+    }
+  }
+
+  const auto spirv = readSpirv(shaderFileName.c_str());
+  auto &kernel = getOrCreate(spirv, entryPoint, dynamicOffsets,
+                             fs::path(shaderFileName).stem().string());
+  std::scoped_lock lock(m_mutex);
+  m_kernelsByName.emplace(nameKey, &kernel);
+  return kernel;
+}
+
+ComputeKernel &KernelCache::getOrCreate(std::span<const uint32_t> spirv,
+                                        const char *entryPoint,
+                                        bool dynamicOffsets,
+                                        std::string name) {
+  // The kernel's own hash() stays the shader's, so both variants share
+  // their tuned workgroup size
+  auto key = hash(spirv, entryPoint);
+  if (dynamicOffsets) {
+    key = fnv1a("dynamic", 7, key);
+  }
+  {
+    std::scoped_lock lock(m_mutex);
+    if (const auto it = m_kernels.find(key); it != m_kernels.end()) {
+      return *it->second;
+    }
+  }
+
+  // Created unlocked so different kernels build in parallel. If another
+  // thread created the same kernel meanwhile, this one is dropped.
+  auto kernel = std::make_unique<ComputeKernel>(
+      m_device, m_pipelineCache, m_descriptorSets, spirv, entryPoint,
+      m_profiler, std::move(name), m_shaderModules, dynamicOffsets);
+  kernel->setDispatchLimits(m_limits);
+  if (m_created) {
+    m_created(*kernel);
+  }
+
+  std::scoped_lock lock(m_mutex);
+  return *m_kernels.try_emplace(key, std::move(kernel)).first->second;
+}
+
+} // namespace vcm
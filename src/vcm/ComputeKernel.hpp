@@ -0,0 +1,299 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "DescriptorAllocator.hpp"
+#include "Profiler.hpp"
+#include "Shader.hpp"
+#include "SpirvReflect.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+// Device limits dispatchElements() splits work by. Defaults are the minimums
+// every Vulkan implementation supports; lower them to exercise the splitting.
+struct DispatchLimits {
+  uint32_t maxGroupCountX{65535};
+  vk::DeviceSize maxStorageBufferRange{vk::DeviceSize{1} << 27U};
+  vk::DeviceSize minStorageBufferOffsetAlignment{256};
+
+  static DispatchLimits fromDevice(vk::PhysicalDevice physicalDevice);
+};
+
+/*
+A compute pipeline built from a SPIR-V module.
+
+The descriptor set layout and pipeline layout are derived from the module's
+reflected bindings and push constant block, and the pipeline is created once
+at construction; its shader module comes from a ShaderModuleCache if one is
+given. Recording a dispatch only binds and dispatches. Descriptor
+sets from bind() come from a DescriptorSetCache shared by all kernels.
+
+The workgroup size is a specialization constant (see
+makeWorkgroupSizeSpecializable), so setWorkgroupSize() picks another X size
+without recompiling the shader; one pipeline is created per size used.
+
+With dynamicOffsets, storage buffer bindings are dynamic: a set binds
+windows of buffers and each dispatch passes the offsets of the windows, so
+one set serves every sub-buffer of the same buffers (see BufferArena).
+Dispatches without offsets use offset 0. Devices support at least 4
+dynamic storage buffers per layout (maxDescriptorSetStorageBuffersDynamic).
+Element-wise kernels start their push constant block with
+{ uint count; uint base; }, process element base + DTid.x and return early
+for elements at or past count. dispatchElements() relies on this to cover
+any element count: grids beyond maxComputeWorkGroupCount become several
+dispatches with increasing base, and buffers beyond maxStorageBufferRange
+are bound a chunk of ranges at a time.
+
+Kernels without bindings can take their buffers by device address instead
+(see shaders/bindless.hlsli): dispatchAddresses() pushes each buffer's
+address and size after { count, base }, so launching over new buffers
+touches no descriptors at all. The push constant block pads { count, base }
+to ADDRESS_PUSH_OFFSET so both layouts agree on where the addresses start.
+*/
+class ComputeKernel {
+public:
+  // Where buffer addresses start in a bindless kernel's push constants
+  static constexpr uint32_t ADDRESS_PUSH_OFFSET = 16;
+
+  ComputeKernel(vk::Device device, vk::PipelineCache pipelineCache,
+                DescriptorSetCache &descriptorSets,
+                std::span<const uint32_t> spirv,
+                const char *entryPoint = "Main", Profiler *profiler = nullptr,
+                std::string name = {},
+                ShaderModuleCache *shaderModules = nullptr,
+                bool dynamicOffsets = false);
+
+  ComputeKernel(const ComputeKernel &) = delete;
+  ComputeKernel(ComputeKernel &&) = delete;
+  ComputeKernel &operator=(const ComputeKernel &) = delete;
+  ComputeKernel &operator=(ComputeKernel &&) = delete;
+
+  ~ComputeKernel();
+
+  // Shown in profiler traces; the entry point if no name was given
+  [[nodiscard]] auto &name() const { return m_name; }
+  [[nodiscard]] auto &reflection() const { return m_reflection; }
+  // Hash of the SPIR-V and entry point, as used by KernelCache
+  [[nodiscard]] auto hash() const { return m_hash; }
+  [[nodiscard]] auto pipeline() const { return m_pipeline; }
+  [[nodiscard]] auto pipelineLayout() const { return m_pipelineLayout; }
+  [[nodiscard]] auto descriptorSetLayout() const {
+    return m_descriptorSetLayout;
+  }
+  // Offsets each dispatch takes, one per dynamic storage buffer binding
+  [[nodiscard]] uint32_t dynamicOffsetCount() const {
+    return static_cast<uint32_t>(m_zeroOffsets.size());
+  }
+
+  // Descriptor set with the given buffers written to the kernel's bindings,
+  // in binding order. Cached: binding the same buffer ranges again returns
+  // the same set without updating it. The set stays valid until one of the
+  // buffers is forgotten by the cache or the kernel is destroyed.
+  [[nodiscard]] vk::DescriptorSet
+  bind(std::span<const vk::DescriptorBufferInfo> buffers) const;
+
+  template <typename... Buffers>
+  [[nodiscard]] vk::DescriptorSet bind(const Buffers &...buffers) const {
+    const std::array<vk::DescriptorBufferInfo, sizeof...(Buffers)> infos{
+        descriptorBufferInfo(buffers)...};
+    return bind(std::span<const vk::DescriptorBufferInfo>{infos});
+  }
+
+  // Write the given buffers to the kernel's bindings of a set allocated
+  // elsewhere, e.g. from a per-frame DescriptorAllocator
+  void write(vk::DescriptorSet descriptorSet,
+             std::span<const vk::DescriptorBufferInfo> buffers) const;
+
+  template <typename... Buffers>
+  void write(vk::DescriptorSet descriptorSet, const Buffers &...buffers) const {
+    const std::array<vk::DescriptorBufferInfo, sizeof...(Buffers)> infos{
+        descriptorBufferInfo(buffers)...};
+    write(descriptorSet, std::span<const vk::DescriptorBufferInfo>{infos});
+  }
+
+  // Record push constants. T must match the shader's push constant block.
+  template <typename T>
+  void pushConstants(vk::CommandBuffer commandBuffer, const T &data) const {
+    commandBuffer.pushConstants(m_pipelineLayout,
+                                vk::ShaderStageFlagBits::eCompute, 0,
+                                sizeof(T), &data);
+  }
+
+  // Record binding the pipeline and descriptor set and dispatching, timed by
+  // the profiler if it is enabled. A null set binds none, for bindless
+  // kernels.
+  void dispatch(vk::CommandBuffer commandBuffer,
+                vk::DescriptorSet descriptorSet, uint32_t groupCountX,
+                uint32_t groupCountY = 1, uint32_t groupCountZ = 1) const;
+  // With the byte offsets of the dynamic bindings, in binding order
+  void dispatch(vk::CommandBuffer commandBuffer,
+                vk::DescriptorSet descriptorSet,
+                std::span<const uint32_t> dynamicOffsets, uint32_t groupCountX,
+                uint32_t groupCountY = 1, uint32_t groupCountZ = 1) const;
+
+  // Record a 1D dispatch over elementCount elements: pushes the count and
+  // dispatches enough workgroups to cover it, the shader bounds checks the
+  // tail. Split into several dispatches past maxGroupCountX.
+  void dispatchElements(vk::CommandBuffer commandBuffer,
+                        vk::DescriptorSet descriptorSet,
+                        uint32_t elementCount) const;
+  void dispatchElements(vk::CommandBuffer commandBuffer,
+                        vk::DescriptorSet descriptorSet,
+                        std::span<const uint32_t> dynamicOffsets,
+                        uint32_t elementCount) const;
+
+  // Record a bindless kernel over elementCount elements of the buffers at
+  // addresses, pushed in order after { count, base }. Needs a device with
+  // buffer device addresses and buffers created with eShaderDeviceAddress.
+  void dispatchAddresses(vk::CommandBuffer commandBuffer,
+                         std::span<const BufferAddress> addresses,
+                         uint32_t elementCount) const;
+
+  template <typename... Buffers>
+  void dispatchAddresses(vk::CommandBuffer commandBuffer,
+                         uint32_t elementCount,
+                         const Buffers &...buffers) const {
+    const std::array<BufferAddress, sizeof...(Buffers)> addresses{
+        buffers.address()...};
+    dispatchAddresses(commandBuffer,
+                      std::span<const BufferAddress>{addresses}, elementCount);
+  }
+
+  // Record the kernel over elementCount elements of buffers, bound to its
+  // bindings in order, whatever the size: the buffers are bound in chunks of
+  // ranges that fit maxStorageBufferRange, each with its own cached
+  // descriptor set. Every binding must be a StructuredBuffer, and every
+  // range must start at a multiple of minStorageBufferOffsetAlignment.
+  void dispatchElements(vk::CommandBuffer commandBuffer,
+                        std::span<const vk::DescriptorBufferInfo> buffers,
+                        uint64_t elementCount) const;
+
+  // Workgroups needed to cover elementCount elements along X
+  [[nodiscard]] uint64_t groupCount(uint64_t elementCount) const {
+    return (elementCount + m_workgroupSize[0] - 1) / m_workgroupSize[0];
+  }
+
+  [[nodiscard]] auto &dispatchLimits() const { return m_limits; }
+  void setDispatchLimits(const DispatchLimits &limits) { m_limits = limits; }
+
+  [[nodiscard]] auto &workgroupSize() const { return m_workgroupSize; }
+  // False if the module declares its own WorkgroupSize built-in
+  [[nodiscard]] bool specializable() const { return m_specializable; }
+
+  // Use workgroup size x along X for dispatches recorded from now on,
+  // creating its pipeline on first use. Not synchronized with recording on
+  // other threads.
+  void setWorkgroupSize(uint32_t x);
+
+private:
+  vk::Device m_device;
+  DescriptorSetCache &m_descriptorSets;
+  Profiler *m_profiler;
+  std::string m_name;
+  uint64_t m_hash;
+  vk::PipelineCache m_pipelineCache;
+  std::string m_entryPoint;
+
+  ShaderReflection m_reflection;
+  std::vector<vk::DescriptorSetLayoutBinding> m_layoutBindings;
+  vk::DescriptorSetLayout m_descriptorSetLayout;
+  vk::PipelineLayout m_pipelineLayout;
+  vk::ShaderModule m_shader;
+  // False if m_shader is owned by a ShaderModuleCache
+  bool m_ownsShader{true};
+  // One zero per dynamic binding, for dispatches without offsets
+  std::vector<uint32_t> m_zeroOffsets;
+  bool m_specializable{false};
+
+  // Current workgroup size and its pipeline
+  std::array<uint32_t, 3> m_workgroupSize;
+  vk::Pipeline m_pipeline;
+  DispatchLimits m_limits;
+
+  // Pipelines by workgroup size X
+  std::mutex m_pipelinesMutex;
+  std::unordered_map<uint32_t, vk::Pipeline> m_pipelines;
+
+  vk::Pipeline createPipeline(const std::array<uint32_t, 3> &workgroupSize);
+
+  static vk::DescriptorBufferInfo
+  descriptorBufferInfo(const vk::DescriptorBufferInfo &info) {
+    return info;
+  }
+  static vk::DescriptorBufferInfo descriptorBufferInfo(vk::Buffer buffer) {
+    return {buffer, 0, vk::WholeSize};
+  }
+  static vk::DescriptorBufferInfo descriptorBufferInfo(const VcmBuffer &buffer) {
+    return {buffer.buffer, 0, vk::WholeSize};
+  }
+  template <typename T>
+  static vk::DescriptorBufferInfo descriptorBufferInfo(const Buffer<T> &buffer) {
+    return buffer.descriptor();
+  }
+};
+
+/*
+Kernels keyed by a hash of their SPIR-V and entry point, so each kernel
+exists once. Lookups by shader file name skip reading and
+hashing the file after the first call. Thread safe; kernels are created
+outside the lock, so threads getting different kernels build their
+pipelines in parallel.
+*/
+class KernelCache {
+public:
+  KernelCache(vk::Device device, vk::PipelineCache pipelineCache,
+              DescriptorSetCache &descriptorSets, Profiler *profiler = nullptr,
+              const DispatchLimits &limits = {},
+              ShaderModuleCache *shaderModules = nullptr)
+      : m_device(device), m_pipelineCache(pipelineCache),
+        m_descriptorSets(descriptorSets), m_profiler(profiler),
+        m_limits(limits), m_shaderModules(shaderModules) {}
+
+  using CreatedCallback = std::function<void(ComputeKernel &)>;
+
+  // Called on each kernel created from now on, before any other thread can
+  // get it, e.g. to set its tuned workgroup size
+  void setCreatedCallback(CreatedCallback callback) {
+    m_created = std::move(callback);
+  }
+
+  // Kernels with dynamicOffsets are cached apart from the same shader's
+  // static kernel
+  ComputeKernel &get(std::span<const uint32_t> spirv,
+                     const char *entryPoint = "Main",
+                     bool dynamicOffsets = false);
+  ComputeKernel &get(const std::string &shaderFileName,
+                     const char *entryPoint = "Main",
+                     bool dynamicOffsets = false);
+
+  static uint64_t hash(std::span<const uint32_t> spirv,
+                       const char *entryPoint);
+
+private:
+  vk::Device m_device;
+  vk::PipelineCache m_pipelineCache;
+  DescriptorSetCache &m_descriptorSets;
+  Profiler *m_profiler;
+  DispatchLimits m_limits;
+  ShaderModuleCache *m_shaderModules;
+  CreatedCallback m_created;
+
+  std::mutex m_mutex;
+  std::unordered_map<uint64_t, std::unique_ptr<ComputeKernel>> m_kernels;
+  std::unordered_map<std::string, ComputeKernel *> m_kernelsByName;
+
+  ComputeKernel &getOrCreate(std::span<const uint32_t> spirv,
+                             const char *entryPoint, bool dynamicOffsets,
+                             std::string name = {});
+};
+
+} // namespace vcm
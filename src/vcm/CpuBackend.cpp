@@ -0,0 +1,130 @@
+#include "CpuBackend.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace vcm {
+
+CpuBackend::CpuBackend(size_t threadCount) {
+  if (threadCount > 1) {
+    m_threads = std::make_unique<ThreadPool>(threadCount);
+  }
+}
+
+size_t CpuBackend::chunkCount(size_t count) const {
+  if (!m_threads) {
+    return 1;
+  }
+  // A few chunks per thread balance uneven progress, but none under GRAIN
+  const auto chunks = (count + GRAIN - 1) / GRAIN;
+  return std::clamp<size_t>(chunks, 1, 4 * threadCount());
+}
+
+void CpuBackend::forChunks(
+    size_t count, const std::function<void(size_t first, size_t last)> &func) {
+  if (count == 0) {
+    return;
+  }
+  const auto chunks = chunkCount(count);
+  if (chunks == 1) {
+    func(0, count);
+    return;
+  }
+  const auto chunkSize = (count + chunks - 1) / chunks;
+  m_threads->parallelFor(chunks, [&](size_t chunk) {
+    const auto first = chunk * chunkSize;
+    if (first < count) {
+      func(first, std::min(count, first + chunkSize));
+    }
+  });
+}
+
+ReduceResult CpuBackend::reduce(ReduceOp op, std::span<const uint32_t> input) {
+  if (input.size() > UINT32_MAX) {
+    throw std::runtime_error(
+        fmt::format("Reductions take at most {} elements, got {}.",
+                    UINT32_MAX, input.size()));
+  }
+
+  const auto chunks = chunkCount(input.size());
+  const auto chunkSize = (input.size() + chunks - 1) / chunks;
+  std::vector<ReduceResult> partials(chunks, reduceIdentity(op));
+  forChunks(input.size(), [&](size_t first, size_t last) {
+    const uint32_t *x = input.data();
+    auto &partial = partials[first / chunkSize];
+    switch (op) {
+    case ReduceOp::Sum: {
+      uint32_t sum = 0;
+      for (size_t i = first; i < last; ++i) {
+        sum += x[i];
+      }
+      partial = {sum, 0};
+      break;
+    }
+    case ReduceOp::Min:
+    case ReduceOp::ArgMin: {
+      const auto it = std::min_element(x + first, x + last);
+      partial = {*it, static_cast<uint32_t>(it - x)};
+      break;
+    }
+    case ReduceOp::Max:
+    case ReduceOp::ArgMax: {
+      const auto it = std::max_element(x + first, x + last);
+      partial = {*it, static_cast<uint32_t>(it - x)};
+      break;
+    }
+    }
+  });
+
+  auto result = reduceIdentity(op);
+  for (const auto &partial : partials) {
+    result = combine(op, result, partial);
+  }
+  return result;
+}
+
+void CpuBackend::scan(std::span<const uint32_t> input,
+                      std::span<uint32_t> output, bool inclusive) {
+  if (output.size() < input.size()) {
+    throw std::runtime_error(
+        fmt::format("Scan output of {} elements is smaller than its input "
+                    "of {}.",
+                    output.size(), input.size()));
+  }
+
+  // Sum of each chunk, an exclusive scan of those sums, then a scan of
+  // each chunk offset by the sum before it
+  const auto chunks = chunkCount(input.size());
+  const auto chunkSize = (input.size() + chunks - 1) / chunks;
+  std::vector<uint32_t> offsets(chunks, 0);
+  if (chunks > 1) {
+    forChunks(input.size(), [&](size_t first, size_t last) {
+      uint32_t sum = 0;
+      for (size_t i = first; i < last; ++i) {
+        sum += input[i];
+      }
+      offsets[first / chunkSize] = sum;
+    });
+    uint32_t running = 0;
+    for (auto &offset : offsets) {
+      running += std::exchange(offset, running);
+    }
+  }
+
+  forChunks(input.size(), [&](size_t first, size_t last) {
+    auto running = offsets[first / chunkSize];
+    for (size_t i = first; i < last; ++i) {
+      // input may alias output
+      const auto value = input[i];
+      if (inclusive) {
+        running += value;
+        output[i] = running;
+      } else {
+        output[i] = running;
+        running += value;
+      }
+    }
+  });
+}
+
+} // namespace vcm
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Primitives.hpp"
+#include "ThreadPool.hpp"
+#include "TypedElementwise.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace vcm {
+
+/*
+The element-wise kernels and primitives on the host, for arrays too small
+to be worth a GPU submission and for hosts without a Vulkan device.
+
+Arrays are split into chunks of at least GRAIN elements that run on a
+thread pool; smaller arrays run on the calling thread. A chunk is a plain
+loop over contiguous arrays, which the compiler vectorizes for float and
+integer elements. Half elements convert through float one at a time.
+
+Results match the typed shaders and Primitives: integers wrap, halves are
+computed in fp32 and rounded to nearest even, and arg reductions return the
+first index of the extreme value.
+*/
+class CpuBackend {
+public:
+  static constexpr size_t GRAIN = 1 << 16;
+
+  explicit CpuBackend(size_t threadCount = ThreadPool::defaultThreadCount());
+
+  CpuBackend(const CpuBackend &) = delete;
+  CpuBackend(CpuBackend &&) = delete;
+  CpuBackend &operator=(const CpuBackend &) = delete;
+  CpuBackend &operator=(CpuBackend &&) = delete;
+
+  ~CpuBackend() = default;
+
+  [[nodiscard]] size_t threadCount() const {
+    return m_threads ? m_threads->size() : 1;
+  }
+
+  // out = a + b
+  template <ShaderElement T>
+  void add(std::span<const T> a, std::span<const T> b, std::span<T> out) {
+    checkSizes(a.size(), b.size(), out.size());
+    forChunks(a.size(), [&](size_t first, size_t last) {
+      const T *x = a.data();
+      const T *y = b.data();
+      T *z = out.data();
+      for (size_t i = first; i < last; ++i) {
+        z[i] = addElements(x[i], y[i]);
+      }
+    });
+  }
+
+  // out = in * in
+  template <ShaderElement T>
+  void square(std::span<const T> in, std::span<T> out) {
+    checkSizes(in.size(), in.size(), out.size());
+    forChunks(in.size(), [&](size_t first, size_t last) {
+      const T *x = in.data();
+      T *z = out.data();
+      for (size_t i = first; i < last; ++i) {
+        z[i] = multiplyElements(x[i], x[i]);
+      }
+    });
+  }
+
+  ReduceResult reduce(ReduceOp op, std::span<const uint32_t> input);
+  uint32_t sum(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Sum, input).value;
+  }
+  uint32_t min(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Min, input).value;
+  }
+  uint32_t max(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Max, input).value;
+  }
+  uint32_t argMin(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::ArgMin, input).index;
+  }
+  uint32_t argMax(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::ArgMax, input).index;
+  }
+
+  // output[i] = input[0] + ... + input[i]; output may be input
+  void inclusiveScan(std::span<const uint32_t> input,
+                     std::span<uint32_t> output) {
+    scan(input, output, true);
+  }
+  // output[i] = input[0] + ... + input[i - 1], output[0] = 0
+  void exclusiveScan(std::span<const uint32_t> input,
+                     std::span<uint32_t> output) {
+    scan(input, output, false);
+  }
+
+  // Run func(first, last) over chunks of [0, count), in parallel when there
+  // is more than one chunk
+  void forChunks(size_t count,
+                 const std::function<void(size_t first, size_t last)> &func);
+
+private:
+  // Null when single threaded
+  std::unique_ptr<ThreadPool> m_threads;
+
+  [[nodiscard]] size_t chunkCount(size_t count) const;
+
+  void scan(std::span<const uint32_t> input, std::span<uint32_t> output,
+            bool inclusive);
+
+  static void checkSizes(size_t a, size_t b, size_t out) {
+    if (b < a || out < a) {
+      throw std::runtime_error(fmt::format(
+          "Element-wise op over {} elements with inputs of {} and output of "
+          "{}.",
+          a, b, out));
+    }
+  }
+
+  // Integers are computed as uint32, which wraps like the shaders' packing
+  // (and is never undefined, unlike signed or promoted arithmetic)
+  template <typename T> static T addElements(T a, T b) {
+    if constexpr (std::is_same_v<T, Half>) {
+      return Half::fromFloat(a.toFloat() + b.toFloat());
+    } else if constexpr (std::is_floating_point_v<T>) {
+      return a + b;
+    } else {
+      return static_cast<T>(static_cast<uint32_t>(a) +
+                            static_cast<uint32_t>(b));
+    }
+  }
+
+  template <typename T> static T multiplyElements(T a, T b) {
+    if constexpr (std::is_same_v<T, Half>) {
+      return Half::fromFloat(a.toFloat() * b.toFloat());
+    } else if constexpr (std::is_floating_point_v<T>) {
+      return a * b;
+    } else {
+      return static_cast<T>(static_cast<uint32_t>(a) *
+                            static_cast<uint32_t>(b));
+    }
+  }
+};
+
+} // namespace vcm
@@ -0,0 +1,321 @@
+#include "DescriptorAllocator.hpp"
+#include "Common.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <fmt/format.h>
+#include <iterator>
+#include <stdexcept>
+
+namespace vcm {
+
+DescriptorAllocator::DescriptorAllocator(vk::Device device, bool freeable,
+                                         std::span<const PoolSizeRatio> ratios)
+    : m_device(device), m_freeable(freeable),
+      m_ratios(ratios.begin(), ratios.end()) {}
+
+DescriptorAllocator::~DescriptorAllocator() {
+  for (const auto pool : m_ready) {
+    m_device.destroyDescriptorPool(pool);
+  }
+  for (const auto pool : m_full) {
+    m_device.destroyDescriptorPool(pool);
+  }
+}
+
+std::span<const DescriptorAllocator::PoolSizeRatio>
+DescriptorAllocator::defaultPoolSizeRatios() {
+  // Compute kernels mostly bind storage buffers
+  static constexpr std::array ratios{
+      PoolSizeRatio{vk::DescriptorType::eStorageBuffer, 4.0F},
+      PoolSizeRatio{vk::DescriptorType::eStorageBufferDynamic, 2.0F},
+      PoolSizeRatio{vk::DescriptorType::eUniformBuffer, 1.0F},
+      PoolSizeRatio{vk::DescriptorType::eStorageImage, 1.0F},
+      PoolSizeRatio{vk::DescriptorType::eCombinedImageSampler, 1.0F},
+  };
+  return ratios;
+}
+
+vk::DescriptorPool DescriptorAllocator::createPool() {
+  std::vector<vk::DescriptorPoolSize> poolSizes;
+  poolSizes.reserve(m_ratios.size());
+  for (const auto &[type, ratio] : m_ratios) {
+    poolSizes.emplace_back(
+        type, std::max(1U, static_cast<uint32_t>(
+                               ratio * static_cast<float>(m_setsPerPool))));
+  }
+
+  vk::DescriptorPoolCreateInfo poolInfo{};
+  if (m_freeable) {
+    poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+  }
+  poolInfo.maxSets = m_setsPerPool;
+  poolInfo.setPoolSizes(poolSizes);
+
+  // Grow geometrically so a busy allocator settles on a few large pools
+  m_setsPerPool = std::min(m_setsPerPool * 2, MAX_SETS_PER_POOL);
+  return m_device.createDescriptorPool(poolInfo);
+}
+
+vk::DescriptorPool &DescriptorAllocator::currentPool() {
+  if (m_ready.empty()) {
+    m_ready.push_back(createPool());
+  }
+  return m_ready.back();
+}
+
+vk::DescriptorSet
+DescriptorAllocator::allocate(vk::DescriptorSetLayout layout) {
+  std::scoped_lock lock(m_mutex);
+
+  // At most one retry: a fresh pool only fails if the layout alone does not
+  // fit, which no amount of chaining fixes
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    const auto pool = currentPool();
+    vk::DescriptorSetAllocateInfo allocInfo(pool, 1, &layout);
+    vk::DescriptorSet descriptorSet;
+    const auto result =
+        m_device.allocateDescriptorSets(&allocInfo, &descriptorSet);
+
+    if (result == vk::Result::eSuccess) {
+      if (m_freeable) {
+        m_owners.emplace(descriptorSet, pool);
+      }
+      return descriptorSet;
+    }
+    if (result != vk::Result::eErrorOutOfPoolMemory &&
+        result != vk::Result::eErrorFragmentedPool) {
+      throw std::runtime_error(fmt::format(
+          "Failed to allocate descriptor set: {}", vk::to_string(result)));
+    }
+
+    // Exhausted: park it until the next reset and chain a new one
+    m_full.push_back(pool);
+    m_ready.pop_back();
+  }
+
+  throw std::runtime_error(
+      "Descriptor set layout does not fit in an empty descriptor pool.");
+}
+
+void DescriptorAllocator::free(vk::DescriptorSet descriptorSet) {
+  if (!m_freeable) {
+    throw std::runtime_error(
+        "Descriptor allocator was not created with freeable sets.");
+  }
+
+  std::scoped_lock lock(m_mutex);
+  const auto it = m_owners.find(descriptorSet);
+  if (it == m_owners.end()) {
+    return;
+  }
+  const auto pool = it->second;
+  m_owners.erase(it);
+  m_device.freeDescriptorSets(pool, descriptorSet);
+
+  // Freeing may make room again in a pool that was full
+  if (const auto full = std::ranges::find(m_full, pool); full != m_full.end()) {
+    m_full.erase(full);
+    m_ready.insert(m_ready.begin(), pool);
+  }
+}
+
+void DescriptorAllocator::reset() {
+  std::scoped_lock lock(m_mutex);
+  m_ready.insert(m_ready.end(), m_full.begin(), m_full.end());
+  m_full.clear();
+  for (const auto pool : m_ready) {
+    m_device.resetDescriptorPool(pool);
+  }
+  m_owners.clear();
+}
+
+size_t DescriptorAllocator::poolCount() const {
+  std::scoped_lock lock(m_mutex);
+  return m_ready.size() + m_full.size();
+}
+
+size_t DescriptorSetCache::KeyHash::operator()(const Key &key) const {
+  auto hash = fnv1a(&key.layout, sizeof(key.layout));
+  for (const auto &buffer : key.buffers) {
+    const VkBuffer handle = buffer.buffer;
+    hash = fnv1a(&handle, sizeof(handle), hash);
+    hash = fnv1a(&buffer.offset, sizeof(buffer.offset), hash);
+    hash = fnv1a(&buffer.range, sizeof(buffer.range), hash);
+  }
+  return static_cast<size_t>(hash);
+}
+
+vk::DescriptorSet DescriptorSetCache::get(
+    vk::DescriptorSetLayout layout,
+    std::span<const vk::DescriptorSetLayoutBinding> bindings,
+    std::span<const vk::DescriptorBufferInfo> buffers) {
+  if (buffers.size() != bindings.size()) {
+    throw std::runtime_error(
+        fmt::format("Layout has {} bindings, got {} buffers.",
+                    bindings.size(), buffers.size()));
+  }
+
+  Key key{layout, {buffers.begin(), buffers.end()}};
+
+  std::scoped_lock lock(m_mutex);
+  if (const auto it = m_sets.find(key); it != m_sets.end()) {
+    ++m_hits;
+    it->second.lastUse = ++m_uses;
+    return it->second.descriptorSet;
+  }
+  ++m_misses;
+
+  if (m_sets.size() >= m_maxSets) {
+    evict();
+  }
+  reclaimRetired();
+
+  vk::DescriptorSet descriptorSet;
+  if (auto &unused = m_unused[layout]; !unused.empty()) {
+    descriptorSet = unused.back();
+    unused.pop_back();
+  } else {
+    descriptorSet = m_allocator.allocate(layout);
+  }
+
+  std::vector<vk::WriteDescriptorSet> writes;
+  writes.reserve(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    writes.emplace_back(descriptorSet, bindings[i].binding, 0, 1,
+                        bindings[i].descriptorType, nullptr, &buffers[i]);
+  }
+  m_device.updateDescriptorSets(writes, {});
+
+  m_sets.emplace(std::move(key), Entry{descriptorSet, ++m_uses});
+  return descriptorSet;
+}
+
+void DescriptorSetCache::setQueues(std::vector<const TimelineQueue *> queues) {
+  std::scoped_lock lock(m_mutex);
+  m_queues = std::move(queues);
+  if (m_queues.empty()) {
+    // Nothing in flight, and the tickets' semaphores may be going away
+    for (const auto &retired : m_retired) {
+      m_unused[retired.layout].push_back(retired.descriptorSet);
+    }
+    m_retired.clear();
+  }
+}
+
+void DescriptorSetCache::forget(vk::Buffer buffer) {
+  std::scoped_lock lock(m_mutex);
+  std::erase_if(m_sets, [&](const auto &entry) {
+    const auto &[key, cached] = entry;
+    const bool uses = std::ranges::any_of(
+        key.buffers, [&](const auto &info) { return info.buffer == buffer; });
+    if (uses) {
+      retire(key.layout, cached.descriptorSet);
+    }
+    return uses;
+  });
+}
+
+void DescriptorSetCache::retire(vk::DescriptorSetLayout layout,
+                                vk::DescriptorSet descriptorSet) {
+  // Submissions so far may still read the set
+  std::vector<Ticket> tickets;
+  for (const auto *queue : m_queues) {
+    if (auto ticket = queue->last(); ticket.valid()) {
+      tickets.push_back(std::move(ticket));
+    }
+  }
+  if (tickets.empty()) {
+    m_unused[layout].push_back(descriptorSet);
+    return;
+  }
+  m_retired.push_back({layout, descriptorSet, std::move(tickets)});
+}
+
+void DescriptorSetCache::reclaimRetired() {
+  std::erase_if(m_retired, [&](const Retired &retired) {
+    if (!std::ranges::all_of(retired.tickets,
+                             [](const auto &ticket) { return ticket.ready(); })) {
+      return false;
+    }
+    m_unused[retired.layout].push_back(retired.descriptorSet);
+    return true;
+  });
+}
+
+void DescriptorSetCache::evict() {
+  if (m_sets.empty()) {
+    return;
+  }
+
+  // The least recently used quarter, at least one
+  std::vector<uint64_t> uses;
+  uses.reserve(m_sets.size());
+  for (const auto &[key, cached] : m_sets) {
+    uses.push_back(cached.lastUse);
+  }
+  const auto count = std::max<size_t>(uses.size() / 4, 1);
+  const auto nth = uses.begin() + static_cast<std::ptrdiff_t>(count - 1);
+  std::ranges::nth_element(uses, nth);
+  const auto threshold = *nth;
+
+  std::erase_if(m_sets, [&](const auto &entry) {
+    const auto &[key, cached] = entry;
+    if (cached.lastUse > threshold) {
+      return false;
+    }
+    retire(key.layout, cached.descriptorSet);
+    ++m_evictions;
+    return true;
+  });
+}
+
+void DescriptorSetCache::forgetLayout(vk::DescriptorSetLayout layout) {
+  // Take the layout's sets out under the lock, free them after
+  std::vector<vk::DescriptorSet> sets;
+  std::vector<Ticket> tickets;
+  {
+    std::scoped_lock lock(m_mutex);
+    std::erase_if(m_sets, [&](const auto &entry) {
+      const auto &[key, cached] = entry;
+      if (key.layout != layout) {
+        return false;
+      }
+      sets.push_back(cached.descriptorSet);
+      return true;
+    });
+    // Cached sets may be read by any submission so far
+    if (!sets.empty()) {
+      for (const auto *queue : m_queues) {
+        tickets.push_back(queue->last());
+      }
+    }
+    std::erase_if(m_retired, [&](Retired &retired) {
+      if (retired.layout != layout) {
+        return false;
+      }
+      sets.push_back(retired.descriptorSet);
+      std::ranges::move(retired.tickets, std::back_inserter(tickets));
+      return true;
+    });
+    if (const auto it = m_unused.find(layout); it != m_unused.end()) {
+      sets.insert(sets.end(), it->second.begin(), it->second.end());
+      m_unused.erase(it);
+    }
+  }
+
+  // Freeing a set a pending submission uses is invalid
+  for (const auto &ticket : tickets) {
+    ticket.wait();
+  }
+  for (const auto descriptorSet : sets) {
+    m_allocator.free(descriptorSet);
+  }
+}
+
+DescriptorSetCache::Stats DescriptorSetCache::stats() const {
+  std::scoped_lock lock(m_mutex);
+  return {m_hits, m_misses, m_evictions, m_sets.size()};
+}
+
+} // namespace vcm
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Timeline.hpp"
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+/*
+Descriptor allocator that never runs out.
+
+Sets are allocated from the current pool; when it is exhausted (out of pool
+memory or fragmented) a fresh pool is chained on and the allocation retried.
+Each new pool holds twice as many sets as the last, up to MAX_SETS_PER_POOL.
+reset() recycles every pool at once with vkResetDescriptorPool, so per-frame
+descriptor sets cost nothing to free.
+*/
+class DescriptorAllocator {
+public:
+  // Descriptors of a type per set in each pool
+  struct PoolSizeRatio {
+    vk::DescriptorType type;
+    float ratio;
+  };
+
+  static constexpr uint32_t INITIAL_SETS_PER_POOL = 64;
+  static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+  // With freeable set, pools are created with eFreeDescriptorSet so single
+  // sets can be returned with free()
+  explicit DescriptorAllocator(vk::Device device, bool freeable = false,
+                               std::span<const PoolSizeRatio> ratios =
+                                   defaultPoolSizeRatios());
+
+  DescriptorAllocator(const DescriptorAllocator &) = delete;
+  DescriptorAllocator(DescriptorAllocator &&) = delete;
+  DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+  DescriptorAllocator &operator=(DescriptorAllocator &&) = delete;
+
+  ~DescriptorAllocator();
+
+  static std::span<const PoolSizeRatio> defaultPoolSizeRatios();
+
+  vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+
+  // Return a single set. Only for allocators created freeable.
+  void free(vk::DescriptorSet descriptorSet);
+
+  // Recycle every pool. No set from this allocator may be in use by the GPU
+  // or referenced afterwards.
+  void reset();
+
+  [[nodiscard]] size_t poolCount() const;
+
+private:
+  vk::Device m_device;
+  bool m_freeable;
+  std::vector<PoolSizeRatio> m_ratios;
+
+  mutable std::mutex m_mutex;
+  // Pools with room left, the last one is allocated from
+  std::vector<vk::DescriptorPool> m_ready;
+  // Pools that ran out since the last reset
+  std::vector<vk::DescriptorPool> m_full;
+  uint32_t m_setsPerPool{INITIAL_SETS_PER_POOL};
+
+  // Owning pool of each live set, for free(). Only tracked when freeable.
+  std::unordered_map<VkDescriptorSet, vk::DescriptorPool> m_owners;
+
+  vk::DescriptorPool createPool();
+  vk::DescriptorPool &currentPool();
+};
+
+/*
+Descriptor sets keyed by (layout, buffer, offset, range) of every binding.
+
+get() only allocates and writes a set the first time a layout is used with a
+given list of buffer ranges; repeated dispatches over the same buffers get the
+cached set back without touching updateDescriptorSets.
+
+A cached set keeps referring to the buffer handles it was written with, so
+call forget() before destroying a buffer (a new buffer may reuse the handle),
+and forgetLayout() before destroying a layout. Work using the buffer must
+have been submitted by then: a forgotten set is only rewritten once the
+latest submission on each of queues at the time of forget() completes.
+
+At most maxSets sets stay cached; past that the least recently used
+quarter is evicted, and recycled as forgotten sets are. A set from get()
+stays valid until that many more distinct sets have been requested.
+*/
+class DescriptorSetCache {
+public:
+  static constexpr size_t DEFAULT_MAX_SETS = 16384;
+
+  explicit DescriptorSetCache(vk::Device device,
+                              std::vector<const TimelineQueue *> queues = {},
+                              size_t maxSets = DEFAULT_MAX_SETS)
+      : m_device(device), m_allocator(device, true),
+        m_queues(std::move(queues)), m_maxSets(maxSets) {}
+
+  // Queues whose submissions may use the sets. Empty when none can be in
+  // flight, e.g. while they are being destroyed.
+  void setQueues(std::vector<const TimelineQueue *> queues);
+
+  // Cached set for layout with buffers written to bindings, in order
+  vk::DescriptorSet get(vk::DescriptorSetLayout layout,
+                        std::span<const vk::DescriptorSetLayoutBinding> bindings,
+                        std::span<const vk::DescriptorBufferInfo> buffers);
+
+  // Drop every set referencing buffer. Their sets are rewritten and reused
+  // for later misses on the same layout, once the GPU is done with them.
+  void forget(vk::Buffer buffer);
+
+  // Drop and free every set of layout, once submissions that may use them
+  // complete. Blocks until then.
+  void forgetLayout(vk::DescriptorSetLayout layout);
+
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    // Cached now
+    size_t sets;
+  };
+  [[nodiscard]] Stats stats() const;
+
+private:
+  struct Key {
+    vk::DescriptorSetLayout layout;
+    std::vector<vk::DescriptorBufferInfo> buffers;
+
+    bool operator==(const Key &) const = default;
+  };
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  struct Entry {
+    vk::DescriptorSet descriptorSet;
+    // m_uses when last returned by get()
+    uint64_t lastUse;
+  };
+
+  // A dropped set, until tickets complete
+  struct Retired {
+    vk::DescriptorSetLayout layout;
+    vk::DescriptorSet descriptorSet;
+    std::vector<Ticket> tickets;
+  };
+
+  vk::Device m_device;
+  DescriptorAllocator m_allocator;
+
+  mutable std::mutex m_mutex;
+  std::vector<const TimelineQueue *> m_queues;
+  size_t m_maxSets;
+  std::unordered_map<Key, Entry, KeyHash> m_sets;
+  std::vector<Retired> m_retired;
+  // Dropped sets by layout the GPU is done with, waiting to be rewritten
+  std::unordered_map<VkDescriptorSetLayout, std::vector<vk::DescriptorSet>>
+      m_unused;
+
+  uint64_t m_uses{0};
+  uint64_t m_hits{0};
+  uint64_t m_misses{0};
+  uint64_t m_evictions{0};
+
+  // Callers hold m_mutex
+  void retire(vk::DescriptorSetLayout layout,
+              vk::DescriptorSet descriptorSet);
+  void reclaimRetired();
+  void evict();
+};
+
+} // namespace vcm
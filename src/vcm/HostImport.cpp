@@ -0,0 +1,110 @@
+#include "HostImport.hpp"
+#include "VulkanComputeManager.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fmt/format.h>
+
+namespace vcm {
+
+HostBuffer::~HostBuffer() {
+  if (m_memory) {
+    const auto device = m_manager->get_device();
+    m_manager->get_descriptorSetCache().forget(m_buffer);
+    device.destroyBuffer(m_buffer);
+    device.freeMemory(m_memory);
+  }
+  // The device copy frees itself
+}
+
+StagingEngine &HostBuffer::staging() {
+  if (!m_staging) {
+    m_staging = std::make_unique<StagingEngine>(
+        *m_manager,
+        std::min<vk::DeviceSize>(StagingEngine::DEFAULT_CHUNK_SIZE,
+                                 std::max<vk::DeviceSize>(size(), 1)));
+  }
+  return *m_staging;
+}
+
+void HostBuffer::upload() {
+  if (!imported() && m_buffer) {
+    staging().upload(m_host, m_buffer);
+  }
+}
+
+void HostBuffer::download() {
+  if (!imported() && m_buffer) {
+    staging().download(m_buffer, 0, m_host);
+  }
+}
+
+HostBuffer
+VulkanComputeManager::importHostMemory(std::span<std::byte> host,
+                                       vk::BufferUsageFlags usage,
+                                       bool allowImport) const {
+  // Vulkan has no empty buffers
+  if (host.empty()) {
+    return {};
+  }
+
+  const auto alignment = m_minImportedHostPointerAlignment;
+  const bool aligned =
+      alignment > 0 &&
+      reinterpret_cast<uintptr_t>(host.data()) % alignment == 0 && // NOLINT
+      host.size() % alignment == 0;
+
+  if (allowImport && m_externalMemoryHost && aligned) {
+    const vk::ExternalMemoryBufferCreateInfo externalInfo(
+        vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT);
+    vk::BufferCreateInfo bufferInfo{vk::BufferCreateFlags(), host.size(),
+                                    usage, vk::SharingMode::eExclusive};
+    bufferInfo.pNext = &externalInfo;
+    const auto buffer = device.createBuffer(bufferInfo);
+
+    VkMemoryHostPointerPropertiesEXT pointerProperties{
+        VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+    const auto result = m_getMemoryHostPointerProperties(
+        device,
+        VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+        host.data(), &pointerProperties);
+
+    // Host coherent, so neither side needs flushes
+    const auto typeBits = device.getBufferMemoryRequirements(buffer)
+                              .memoryTypeBits &
+                          pointerProperties.memoryTypeBits;
+    if (result == VK_SUCCESS && typeBits != 0) {
+      vk::DeviceMemory memory;
+      try {
+        const auto memoryType = findMemoryType(
+            typeBits, vk::MemoryPropertyFlagBits::eHostVisible |
+                          vk::MemoryPropertyFlagBits::eHostCoherent);
+
+        const vk::ImportMemoryHostPointerInfoEXT importInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT,
+            host.data());
+        vk::MemoryAllocateInfo allocInfo(host.size(), memoryType);
+        allocInfo.pNext = &importInfo;
+        memory = device.allocateMemory(allocInfo);
+        device.bindBufferMemory(buffer, memory, 0);
+        return {*this, host, buffer, memory};
+      } catch (const std::exception &e) {
+        // The import may have failed at the bind, after the allocation
+        if (memory) {
+          device.freeMemory(memory);
+        }
+        fmt::println("Importing host memory failed, staging instead: {}",
+                     e.what());
+      }
+    }
+    device.destroyBuffer(buffer);
+  }
+
+  auto deviceCopy = createBuffer<std::byte>(
+      host.size(),
+      usage | vk::BufferUsageFlagBits::eTransferSrc |
+          vk::BufferUsageFlagBits::eTransferDst,
+      HostAccess::None, "host import");
+  return {*this, host, std::move(deviceCopy)};
+}
+
+} // namespace vcm
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "StagingEngine.hpp"
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+class VulkanComputeManager;
+
+/*
+Device buffer over an existing host allocation, from
+VulkanComputeManager::importHostMemory().
+
+With VK_EXT_external_memory_host the host pages themselves are imported as
+device memory and bound to the buffer: kernels read and write the host
+allocation directly and upload()/download() do nothing. Otherwise, or when
+the allocation is not aligned to minImportedHostPointerAlignment, the buffer
+is a device local copy and upload()/download() move the data through a
+StagingEngine. Callers write the same code for both.
+
+The host allocation must outlive the HostBuffer. Kernels writing an imported
+buffer should end with memoryBarrierComputeThenHost() so the writes are
+visible once their ticket completes.
+*/
+class HostBuffer {
+public:
+  HostBuffer() = default;
+
+  HostBuffer(const HostBuffer &) = delete;
+  HostBuffer &operator=(const HostBuffer &) = delete;
+
+  HostBuffer(HostBuffer &&other) noexcept { swap(other); }
+  HostBuffer &operator=(HostBuffer &&other) noexcept {
+    HostBuffer(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  ~HostBuffer();
+
+  [[nodiscard]] vk::Buffer buffer() const { return m_buffer; }
+  [[nodiscard]] vk::DeviceSize size() const { return m_host.size(); }
+  [[nodiscard]] std::span<std::byte> host() const { return m_host; }
+  // True if the device accesses the host memory directly
+  [[nodiscard]] bool imported() const { return m_memory != VK_NULL_HANDLE; }
+
+  // Make host writes available to the device: a staged copy unless imported
+  void upload();
+  // Make device writes available to the host: a staged copy unless imported.
+  // The writes must have completed.
+  void download();
+
+  void swap(HostBuffer &other) noexcept {
+    std::swap(m_manager, other.m_manager);
+    std::swap(m_host, other.m_host);
+    std::swap(m_buffer, other.m_buffer);
+    std::swap(m_memory, other.m_memory);
+    std::swap(m_deviceCopy, other.m_deviceCopy);
+    std::swap(m_staging, other.m_staging);
+  }
+
+private:
+  friend class VulkanComputeManager;
+
+  // Imported
+  HostBuffer(const VulkanComputeManager &manager, std::span<std::byte> host,
+             vk::Buffer buffer, vk::DeviceMemory memory)
+      : m_manager(&manager), m_host(host), m_buffer(buffer), m_memory(memory) {}
+  // Staged
+  HostBuffer(const VulkanComputeManager &manager, std::span<std::byte> host,
+             Buffer<std::byte> deviceCopy)
+      : m_manager(&manager), m_host(host), m_buffer(deviceCopy.buffer()),
+        m_deviceCopy(std::move(deviceCopy)) {}
+
+  const VulkanComputeManager *m_manager{};
+  std::span<std::byte> m_host;
+  vk::Buffer m_buffer;
+
+  // Imported memory bound to m_buffer
+  vk::DeviceMemory m_memory;
+
+  // Fallback: device copy and the engine moving data to and from it,
+  // created on first use
+  Buffer<std::byte> m_deviceCopy;
+  std::unique_ptr<StagingEngine> m_staging;
+
+  StagingEngine &staging();
+};
+
+} // namespace vcm
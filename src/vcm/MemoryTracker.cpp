@@ -0,0 +1,232 @@
+#include "MemoryTracker.hpp"
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <utility>
+
+namespace vcm {
+
+MemoryTracker::MemoryTracker(VmaAllocator allocator,
+                             vk::PhysicalDevice physicalDevice,
+                             bool budgetExtension)
+    : m_allocator(allocator), m_budgetExtension(budgetExtension),
+      m_epoch(std::chrono::steady_clock::now()) {
+  const auto properties = physicalDevice.getMemoryProperties();
+  m_heaps.assign(properties.memoryHeaps.begin(),
+                 properties.memoryHeaps.begin() + properties.memoryHeapCount);
+  m_heapOverLimit.assign(m_heaps.size(), false);
+}
+
+MemoryTracker::~MemoryTracker() { stopSnapshots(); }
+
+std::vector<MemoryTracker::HeapBudget> MemoryTracker::heapBudgets() const {
+  std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+  vmaGetHeapBudgets(m_allocator, budgets.data());
+
+  std::vector<HeapBudget> heaps;
+  heaps.reserve(m_heaps.size());
+  for (uint32_t i = 0; i < m_heaps.size(); ++i) {
+    const auto &budget = budgets[i];
+    HeapBudget heap;
+    heap.heap = i;
+    heap.deviceLocal = static_cast<bool>(m_heaps[i].flags &
+                                         vk::MemoryHeapFlagBits::eDeviceLocal);
+    heap.size = m_heaps[i].size;
+    heap.usage = budget.usage;
+    heap.budget = budget.budget;
+    heap.blockBytes = budget.statistics.blockBytes;
+    heap.allocationBytes = budget.statistics.allocationBytes;
+    heap.blockCount = budget.statistics.blockCount;
+    heap.allocationCount = budget.statistics.allocationCount;
+    heaps.push_back(heap);
+  }
+  return heaps;
+}
+
+void MemoryTracker::track(VmaAllocation allocation, std::string_view tag) {
+  if (tag.empty()) {
+    tag = UNTAGGED;
+  }
+  VmaAllocationInfo info{};
+  vmaGetAllocationInfo(m_allocator, allocation, &info);
+  const std::string name(tag);
+  vmaSetAllocationName(m_allocator, allocation, name.c_str());
+
+  bool checkLimit = false;
+  {
+    std::scoped_lock lock(m_mutex);
+    m_allocations[allocation] = {name, info.size};
+    auto it = m_tags.find(tag);
+    if (it == m_tags.end()) {
+      it = m_tags.emplace(name, TagUsage{}).first;
+    }
+    auto &usage = it->second;
+    usage.bytes += info.size;
+    usage.count += 1;
+    usage.peakBytes = std::max(usage.peakBytes, usage.bytes);
+    checkLimit = static_cast<bool>(m_softLimitCallback);
+  }
+  if (checkLimit) {
+    checkSoftLimit();
+  }
+}
+
+void MemoryTracker::untrack(VmaAllocation allocation) {
+  bool checkLimit = false;
+  {
+    std::scoped_lock lock(m_mutex);
+    const auto it = m_allocations.find(allocation);
+    if (it == m_allocations.end()) {
+      return;
+    }
+    auto &usage = m_tags.find(it->second.tag)->second;
+    usage.bytes -= it->second.bytes;
+    usage.count -= 1;
+    m_allocations.erase(it);
+    // Only a heap over the limit can drop back below it
+    checkLimit = m_overSoftLimit;
+  }
+  if (checkLimit) {
+    checkSoftLimit();
+  }
+}
+
+std::map<std::string, MemoryTracker::TagUsage, std::less<>>
+MemoryTracker::tags() const {
+  std::scoped_lock lock(m_mutex);
+  return m_tags;
+}
+
+std::string MemoryTracker::snapshotJson() const {
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - m_epoch;
+
+  std::string json = fmt::format(
+      "{{\"timeMs\":{:.3f},\"budgetExtension\":{},\"overSoftLimit\":{},"
+      "\"heaps\":[",
+      elapsed.count(), m_budgetExtension, overSoftLimit());
+  const char *separator = "";
+  for (const auto &heap : heapBudgets()) {
+    json += fmt::format(
+        "{}{{\"heap\":{},\"deviceLocal\":{},\"size\":{},\"usage\":{},"
+        "\"budget\":{},\"blockBytes\":{},\"allocationBytes\":{},"
+        "\"blockCount\":{},\"allocationCount\":{}}}",
+        separator, heap.heap, heap.deviceLocal, heap.size, heap.usage,
+        heap.budget, heap.blockBytes, heap.allocationBytes, heap.blockCount,
+        heap.allocationCount);
+    separator = ",";
+  }
+  json += "],\"tags\":{";
+  separator = "";
+  for (const auto &[tag, usage] : tags()) {
+    json += fmt::format(
+        "{}\"{}\":{{\"bytes\":{},\"count\":{},\"peakBytes\":{}}}", separator,
+        jsonEscape(tag), usage.bytes, usage.count, usage.peakBytes);
+    separator = ",";
+  }
+  json += "}}";
+  return json;
+}
+
+void MemoryTracker::writeSnapshot(const fs::path &path) const {
+  // Readers polling the file never see half a snapshot
+  writeFileAtomically(path, [this](std::ostream &file) {
+    file << snapshotJson() << '\n';
+  });
+}
+
+void MemoryTracker::startSnapshots(std::chrono::milliseconds period,
+                                   SnapshotCallback sink) {
+  stopSnapshots();
+  m_stopSnapshots = false;
+  m_snapshotThread = std::thread([this, period, sink = std::move(sink)] {
+    std::unique_lock lock(m_snapshotMutex);
+    while (!m_snapshotCv.wait_for(lock, period,
+                                  [this] { return m_stopSnapshots; })) {
+      lock.unlock();
+      // Has VMA fetch the driver's current budget
+      vmaSetCurrentFrameIndex(m_allocator, ++m_frameIndex);
+      checkSoftLimit();
+      sink(snapshotJson());
+      lock.lock();
+    }
+  });
+}
+
+void MemoryTracker::startSnapshots(std::chrono::milliseconds period,
+                                   const fs::path &path) {
+  startSnapshots(period, [this, path](const std::string &) {
+    try {
+      writeSnapshot(path);
+    } catch (const std::exception &e) {
+      fmt::println("Memory snapshot not written: {}", e.what());
+    }
+  });
+}
+
+void MemoryTracker::stopSnapshots() {
+  if (!m_snapshotThread.joinable()) {
+    return;
+  }
+  {
+    std::scoped_lock lock(m_snapshotMutex);
+    m_stopSnapshots = true;
+  }
+  m_snapshotCv.notify_all();
+  m_snapshotThread.join();
+}
+
+void MemoryTracker::setSoftLimit(double fraction, SoftLimitCallback callback) {
+  if (fraction <= 0.0) {
+    throw std::runtime_error(
+        fmt::format("Soft memory limit must be positive, got {}.", fraction));
+  }
+  {
+    std::scoped_lock lock(m_mutex);
+    m_softLimit = fraction;
+    m_softLimitCallback = std::move(callback);
+    m_heapOverLimit.assign(m_heapOverLimit.size(), false);
+    m_overSoftLimit = false;
+  }
+  checkSoftLimit();
+}
+
+void MemoryTracker::clearSoftLimit() {
+  std::scoped_lock lock(m_mutex);
+  m_softLimit = 0.0;
+  m_softLimitCallback = nullptr;
+  m_heapOverLimit.assign(m_heapOverLimit.size(), false);
+  m_overSoftLimit = false;
+}
+
+void MemoryTracker::checkSoftLimit() {
+  const auto heaps = heapBudgets();
+
+  std::vector<HeapBudget> crossed;
+  SoftLimitCallback callback;
+  {
+    std::scoped_lock lock(m_mutex);
+    if (!m_softLimitCallback) {
+      return;
+    }
+    bool anyOver = false;
+    for (const auto &heap : heaps) {
+      const bool over = heap.usedFraction() >= m_softLimit;
+      if (over && !m_heapOverLimit[heap.heap]) {
+        crossed.push_back(heap);
+      }
+      m_heapOverLimit[heap.heap] = over;
+      anyOver = anyOver || over;
+    }
+    m_overSoftLimit = anyOver;
+    callback = m_softLimitCallback;
+  }
+
+  for (const auto &heap : crossed) {
+    callback(heap);
+  }
+}
+
+} // namespace vcm
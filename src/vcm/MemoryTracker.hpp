@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Common.hpp"
+#include "VmaUsage.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vcm {
+
+/*
+Device memory usage against the budget of each heap, and the bytes
+allocated under each caller supplied tag.
+
+Budgets come from vmaGetHeapBudgets: the driver's figures with
+VK_EXT_memory_budget, which account for other processes, and otherwise
+VMA's estimate of 80% of the heap. VMA refreshes the driver's figures every
+few allocations and on each periodic snapshot.
+
+The soft limit is a fraction of a heap's budget. Crossing it calls back once,
+and again only after usage has dropped below it, so a caller can throttle
+(or release memory) before the driver starts evicting. It is checked after
+each tracked allocation, after each release while over the limit, and on
+each periodic snapshot.
+
+Thread safe. The callbacks run on the allocating or the snapshot thread,
+without the tracker's lock held.
+*/
+class MemoryTracker {
+public:
+  struct HeapBudget {
+    uint32_t heap{};
+    bool deviceLocal{};
+    vk::DeviceSize size{};
+    // Bytes used and available, this and other processes
+    vk::DeviceSize usage{};
+    vk::DeviceSize budget{};
+    // This allocator's memory blocks and the allocations within them
+    vk::DeviceSize blockBytes{};
+    vk::DeviceSize allocationBytes{};
+    uint32_t blockCount{};
+    uint32_t allocationCount{};
+
+    [[nodiscard]] double usedFraction() const {
+      return budget > 0 ? static_cast<double>(usage) /
+                              static_cast<double>(budget)
+                        : 0.0;
+    }
+  };
+
+  struct TagUsage {
+    vk::DeviceSize bytes{};
+    uint32_t count{};
+    vk::DeviceSize peakBytes{};
+  };
+
+  using SoftLimitCallback = std::function<void(const HeapBudget &)>;
+  using SnapshotCallback = std::function<void(const std::string &json)>;
+
+  // Allocations without a tag are tracked under this one
+  static constexpr std::string_view UNTAGGED = "untagged";
+
+  MemoryTracker(VmaAllocator allocator, vk::PhysicalDevice physicalDevice,
+                bool budgetExtension);
+
+  MemoryTracker(const MemoryTracker &) = delete;
+  MemoryTracker(MemoryTracker &&) = delete;
+  MemoryTracker &operator=(const MemoryTracker &) = delete;
+  MemoryTracker &operator=(MemoryTracker &&) = delete;
+
+  // Stops the periodic snapshots
+  ~MemoryTracker();
+
+  // Budgets are the driver's (VK_EXT_memory_budget) rather than estimated
+  [[nodiscard]] bool hasBudgetExtension() const { return m_budgetExtension; }
+
+  [[nodiscard]] std::vector<HeapBudget> heapBudgets() const;
+
+  // Count the allocation under tag until untrack(). The tag also names the
+  // allocation in VMA's own statistics.
+  void track(VmaAllocation allocation, std::string_view tag);
+  void untrack(VmaAllocation allocation);
+
+  [[nodiscard]] std::map<std::string, TagUsage, std::less<>> tags() const;
+
+  // Heaps and tags as one JSON object
+  [[nodiscard]] std::string snapshotJson() const;
+  void writeSnapshot(const fs::path &path) const;
+
+  // Pass a snapshot to sink every period on a background thread, replacing
+  // any running snapshots
+  void startSnapshots(std::chrono::milliseconds period, SnapshotCallback sink);
+  // Rewrite path with a snapshot every period
+  void startSnapshots(std::chrono::milliseconds period, const fs::path &path);
+  void stopSnapshots();
+
+  // Call back when a heap's usage crosses fraction of its budget. Replaces
+  // the previous limit.
+  void setSoftLimit(double fraction, SoftLimitCallback callback);
+  void clearSoftLimit();
+  // Some heap is over the soft limit, as of the last check
+  [[nodiscard]] bool overSoftLimit() const { return m_overSoftLimit; }
+  // Compare the current usage with the soft limit
+  void checkSoftLimit();
+
+private:
+  struct Tracked {
+    std::string tag;
+    vk::DeviceSize bytes{};
+  };
+
+  VmaAllocator m_allocator;
+  bool m_budgetExtension;
+  std::vector<vk::MemoryHeap> m_heaps;
+  std::chrono::steady_clock::time_point m_epoch;
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<VmaAllocation, Tracked> m_allocations;
+  std::map<std::string, TagUsage, std::less<>> m_tags;
+
+  // Guarded by m_mutex
+  double m_softLimit{0.0};
+  SoftLimitCallback m_softLimitCallback;
+  std::vector<bool> m_heapOverLimit;
+  std::atomic<bool> m_overSoftLimit{false};
+
+  std::mutex m_snapshotMutex;
+  std::condition_variable m_snapshotCv;
+  bool m_stopSnapshots{false};
+  std::thread m_snapshotThread;
+  uint32_t m_frameIndex{0};
+};
+
+} // namespace vcm
@@ -0,0 +1,189 @@
+#include "MultiDevice.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace vcm {
+
+namespace {
+
+constexpr vk::BufferUsageFlags SHARD_USAGE =
+    vk::BufferUsageFlagBits::eStorageBuffer |
+    vk::BufferUsageFlagBits::eTransferSrc |
+    vk::BufferUsageFlagBits::eTransferDst;
+
+// Calibration submissions per device, the fastest counts
+constexpr int CALIBRATION_RUNS = 3;
+
+} // namespace
+
+MultiDevice::MultiDevice(size_t deviceCount,
+                         const fs::path &pipelineCacheDir) {
+  m_devices.push_back(
+      std::make_unique<VulkanComputeManager>(0, pipelineCacheDir));
+  const auto physicalDevices = m_devices.front()->get_suitableDeviceCount();
+  if (deviceCount == 0) {
+    deviceCount = physicalDevices;
+  }
+  for (size_t i = 1; i < deviceCount; ++i) {
+    m_devices.push_back(std::make_unique<VulkanComputeManager>(
+        i % physicalDevices, pipelineCacheDir));
+  }
+
+  m_primitives.resize(m_devices.size());
+  m_elementwise.resize(m_devices.size());
+  m_weights.assign(m_devices.size(), 1.0 / static_cast<double>(size()));
+  m_threads = std::make_unique<ThreadPool>(m_devices.size());
+
+  if (size() > 1) {
+    calibrate();
+  }
+}
+
+// Primitives, runners and the worker threads go before the devices they use
+MultiDevice::~MultiDevice() {
+  m_threads.reset();
+  m_primitives.clear();
+  m_elementwise.clear();
+}
+
+void MultiDevice::setWeights(std::span<const double> weights) {
+  const auto total = std::accumulate(weights.begin(), weights.end(), 0.0);
+  if (weights.size() != size() || !(total > 0.0) ||
+      std::ranges::any_of(weights, [](double w) { return w < 0.0; })) {
+    throw std::runtime_error(
+        fmt::format("Need {} non-negative device weights with a positive sum.",
+                    size()));
+  }
+  for (size_t i = 0; i < size(); ++i) {
+    m_weights[i] = weights[i] / total;
+  }
+}
+
+void MultiDevice::calibrate(uint64_t elements) {
+  // 4 floats per thread
+  const auto units = static_cast<uint32_t>((elements + 3) / 4);
+
+  std::vector<double> rates(size());
+  for (size_t d = 0; d < size(); ++d) {
+    auto &manager = *m_devices[d];
+    auto in = manager.createBuffer<float>(elements, SHARD_USAGE,
+                                          HostAccess::None, "calibration");
+    auto out = manager.createBuffer<float>(elements, SHARD_USAGE,
+                                           HostAccess::None, "calibration");
+
+    // Defined contents, so the kernel does not run on NaNs or denormals
+    {
+      auto commandBuffer = manager.beginOneTimeCommands();
+      commandBuffer.fillBuffer(in.buffer(), 0, vk::WholeSize, 0);
+      memoryBarrierTransferThenCompute(commandBuffer);
+      manager.submitOneTime(commandBuffer).wait();
+    }
+
+    auto &kernel =
+        getTypedKernel(manager, ElementwiseOp::Square, "float", true);
+    const std::array buffers{in.paddedDescriptor(), out.paddedDescriptor()};
+    const auto best = fastestOf(CALIBRATION_RUNS, [&] {
+      auto commandBuffer = manager.beginOneTimeCommands();
+      kernel.dispatchElements(commandBuffer, buffers, units);
+      return secondsOf([&] { manager.submitOneTime(commandBuffer).wait(); });
+    });
+    rates[d] = static_cast<double>(elements) / best;
+    fmt::println("Device {} '{}': {:.2f} Gelements/s", d,
+                 manager.get_physicalDeviceName(), rates[d] * 1e-9);
+  }
+  setWeights(rates);
+}
+
+std::vector<MultiDevice::Shard> MultiDevice::partition(uint64_t count) const {
+  std::vector<Shard> shards;
+  shards.reserve(size());
+  double cumulative = 0.0;
+  uint64_t first = 0;
+  for (size_t d = 0; d < size(); ++d) {
+    cumulative += m_weights[d];
+    // The last shard ends at count whatever the rounding
+    const auto end =
+        d + 1 == size()
+            ? count
+            : std::min(count, static_cast<uint64_t>(
+                                  cumulative * static_cast<double>(count)));
+    shards.push_back({d, first, end - std::min(end, first)});
+    first = std::max(first, end);
+  }
+  return shards;
+}
+
+void MultiDevice::elementwise(ElementwiseOp op, std::string_view type,
+                              size_t elementSize,
+                              std::span<const std::span<const std::byte>> inputs,
+                              std::span<std::byte> output, uint64_t count) {
+  const auto bytes = count * elementSize;
+  if (output.size() < bytes ||
+      std::ranges::any_of(inputs,
+                          [&](const auto &in) { return in.size() < bytes; })) {
+    throw std::runtime_error(fmt::format(
+        "Element-wise op over {} elements with a shorter input or output.",
+        count));
+  }
+
+  const auto shards = partition(count);
+  m_threads->parallelFor(shards.size(), [&](size_t i) {
+    const auto &shard = shards[i];
+    const auto offset = shard.first * elementSize;
+    const auto shardBytes = shard.count * elementSize;
+    std::vector<std::span<const std::byte>> shardInputs;
+    for (const auto &input : inputs) {
+      shardInputs.push_back(input.subspan(offset, shardBytes));
+    }
+    auto &runner = m_elementwise[shard.device];
+    if (!runner) {
+      runner = std::make_unique<ElementwiseRunner>(*m_devices[shard.device]);
+    }
+    runner->run(op, type, elementSize, shardInputs,
+                output.subspan(offset, shardBytes), shard.count);
+  });
+}
+
+ReduceResult MultiDevice::reduce(ReduceOp op,
+                                 std::span<const uint32_t> input) {
+  if (input.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error(
+        fmt::format("Cannot reduce {} elements, at most 2^32 - 1 are "
+                    "supported.",
+                    input.size()));
+  }
+
+  const auto shards = partition(input.size());
+  std::vector<ReduceResult> partials(shards.size());
+  m_threads->parallelFor(shards.size(), [&](size_t i) {
+    const auto &shard = shards[i];
+    if (shard.count == 0) {
+      return;
+    }
+    auto &manager = *m_devices[shard.device];
+    auto &primitives = m_primitives[shard.device];
+    if (!primitives) {
+      primitives = std::make_unique<Primitives>(manager);
+    }
+
+    partials[i] =
+        primitives->reduce(op, input.subspan(shard.first, shard.count));
+    if (partials[i].index != UINT32_MAX) {
+      partials[i].index += static_cast<uint32_t>(shard.first);
+    }
+  });
+
+  // Shards are in input order
+  auto result = reduceIdentity(op);
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (shards[i].count > 0) {
+      result = combine(op, result, partials[i]);
+    }
+  }
+  return result;
+}
+
+} // namespace vcm
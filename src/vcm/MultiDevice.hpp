@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Common.hpp"
+#include "Primitives.hpp"
+#include "ThreadPool.hpp"
+#include "TypedElementwise.hpp"
+#include "VulkanComputeManager.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace vcm {
+
+/*
+Work split across several devices, each a VulkanComputeManager with its own
+instance, logical device, allocator and queues.
+
+Element-wise ops and reductions over host arrays are cut into one contiguous
+shard per device, sized by the devices' weights: by default each device's
+element-wise throughput, measured at construction, over the sum of them.
+Every device uploads its shard, computes and reads back concurrently with
+the others, on a host thread of its own, and the results are gathered into
+the output array or, for reductions, combined on the host.
+
+By default there is one device per suitable physical device. Asking for more
+repeats physical devices, which puts several logical devices on one ICD;
+that exercises the sharding on a single GPU or a software implementation
+such as lavapipe.
+
+Not thread safe.
+*/
+class MultiDevice {
+public:
+  // Elements [first, first + count) go to device
+  struct Shard {
+    size_t device;
+    uint64_t first;
+    uint64_t count;
+  };
+
+  // deviceCount 0 for one device per suitable physical device
+  explicit MultiDevice(size_t deviceCount = 0,
+                       const fs::path &pipelineCacheDir =
+                           VulkanComputeManager::defaultPipelineCacheDir());
+
+  MultiDevice(const MultiDevice &) = delete;
+  MultiDevice(MultiDevice &&) = delete;
+  MultiDevice &operator=(const MultiDevice &) = delete;
+  MultiDevice &operator=(MultiDevice &&) = delete;
+
+  ~MultiDevice();
+
+  [[nodiscard]] size_t size() const { return m_devices.size(); }
+  [[nodiscard]] VulkanComputeManager &device(size_t i) const {
+    return *m_devices.at(i);
+  }
+
+  // Share of the work per device, summing to 1
+  [[nodiscard]] std::span<const double> weights() const { return m_weights; }
+  // Any non-negative values with a positive sum, normalized
+  void setWeights(std::span<const double> weights);
+
+  // Time a typed element-wise kernel over elements floats on each device in
+  // turn, and weight the devices by the element rate they reach
+  void calibrate(uint64_t elements = DEFAULT_CALIBRATION_ELEMENTS);
+
+  // Contiguous shards of count elements by weight, one per device
+  [[nodiscard]] std::vector<Shard> partition(uint64_t count) const;
+
+  // out = a + b
+  template <ShaderElement T>
+  void add(std::span<const T> a, std::span<const T> b, std::span<T> out) {
+    const std::array inputs{std::as_bytes(a), std::as_bytes(b)};
+    elementwise(ElementwiseOp::Add, shaderElementType<T>, sizeof(T), inputs,
+                std::as_writable_bytes(out), a.size());
+  }
+
+  // out = in * in
+  template <ShaderElement T>
+  void square(std::span<const T> in, std::span<T> out) {
+    const std::array inputs{std::as_bytes(in)};
+    elementwise(ElementwiseOp::Square, shaderElementType<T>, sizeof(T),
+                inputs, std::as_writable_bytes(out), in.size());
+  }
+
+  // As Primitives::reduce, with indices into the whole input
+  ReduceResult reduce(ReduceOp op, std::span<const uint32_t> input);
+  uint32_t sum(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Sum, input).value;
+  }
+  uint32_t min(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Min, input).value;
+  }
+  uint32_t max(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Max, input).value;
+  }
+  uint32_t argMin(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::ArgMin, input).index;
+  }
+  uint32_t argMax(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::ArgMax, input).index;
+  }
+
+  static constexpr uint64_t DEFAULT_CALIBRATION_ELEMENTS = 1 << 24;
+
+private:
+  std::vector<std::unique_ptr<VulkanComputeManager>> m_devices;
+  // Per device, created on its first reduction
+  std::vector<std::unique_ptr<Primitives>> m_primitives;
+  // Per device, created on its first element-wise op
+  std::vector<std::unique_ptr<ElementwiseRunner>> m_elementwise;
+  std::vector<double> m_weights;
+  // One thread per device
+  std::unique_ptr<ThreadPool> m_threads;
+
+  // Sizes are in bytes, count in elements
+  void elementwise(ElementwiseOp op, std::string_view type, size_t elementSize,
+                   std::span<const std::span<const std::byte>> inputs,
+                   std::span<std::byte> output, uint64_t count);
+};
+
+} // namespace vcm
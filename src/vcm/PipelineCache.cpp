@@ -0,0 +1,151 @@
+#include "PipelineCache.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+
+namespace vcm {
+
+namespace {
+
+constexpr uint32_t CACHE_FILE_MAGIC = 0x50434D56; // "VCMP"
+constexpr uint32_t CACHE_FILE_VERSION = 1;
+
+// Our own header in front of the driver's blob. The driver blob header
+// (VkPipelineCacheHeaderVersionOne) doesn't carry the driver version, so a
+// driver update would otherwise hand stale data to the new driver.
+struct CacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  std::array<uint8_t, VK_UUID_SIZE> pipelineCacheUUID;
+  uint64_t dataSize;
+  uint64_t checksum;
+};
+
+// FNV-1a, enough to catch truncated or corrupted files
+uint64_t checksum(const uint8_t *data, size_t size) { return fnv1a(data, size); }
+
+// Validate the VkPipelineCacheHeaderVersionOne at the start of the blob
+bool driverHeaderMatches(const std::vector<uint8_t> &blob,
+                         const vk::PhysicalDeviceProperties &props) {
+  // headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+  constexpr size_t minHeaderSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (blob.size() < minHeaderSize) {
+    return false;
+  }
+
+  std::array<uint32_t, 4> fields{};
+  std::memcpy(fields.data(), blob.data(), sizeof(fields));
+  const auto [headerSize, headerVersion, vendorID, deviceID] = fields;
+
+  return headerSize >= minHeaderSize &&
+         headerVersion ==
+             static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne) &&
+         vendorID == props.vendorID && deviceID == props.deviceID &&
+         std::memcmp(blob.data() + sizeof(fields), // NOLINT
+                     props.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+} // namespace
+
+PipelineCache::PipelineCache(vk::Device device,
+                             vk::PhysicalDevice physicalDevice,
+                             const fs::path &cacheDir)
+    : m_device(device), m_properties(physicalDevice.getProperties()),
+      m_path(cacheDir / fmt::format("pipeline_cache_{:04x}_{:04x}.bin",
+                                    m_properties.vendorID,
+                                    m_properties.deviceID)) {
+
+  const auto blob = loadValidatedBlob();
+  m_loadedFromDisk = !blob.empty();
+
+  vk::PipelineCacheCreateInfo createInfo{};
+  createInfo.initialDataSize = blob.size();
+  createInfo.pInitialData = blob.data();
+  m_cache = m_device.createPipelineCache(createInfo);
+
+  fmt::println("{} pipeline cache '{}' ({} bytes).",
+               m_loadedFromDisk ? "Loaded" : "Created empty", m_path.string(),
+               blob.size());
+}
+
+PipelineCache::~PipelineCache() {
+  try {
+    save();
+  } catch (const std::exception &e) {
+    fmt::println("Failed to save pipeline cache: {}", e.what());
+  }
+  m_device.destroyPipelineCache(m_cache);
+}
+
+std::vector<uint8_t> PipelineCache::loadValidatedBlob() const {
+  std::ifstream file(m_path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    return {};
+  }
+
+  const auto fileSize = static_cast<size_t>(file.tellg());
+  file.seekg(0);
+
+  CacheFileHeader header{};
+  if (fileSize < sizeof(header) ||
+      !file.read(reinterpret_cast<char *>(&header), // NOLINT
+                 sizeof(header))) {
+    return {};
+  }
+
+  const auto &props = m_properties;
+  if (header.magic != CACHE_FILE_MAGIC ||
+      header.version != CACHE_FILE_VERSION ||
+      header.vendorID != props.vendorID || header.deviceID != props.deviceID ||
+      header.driverVersion != props.driverVersion ||
+      !std::equal(header.pipelineCacheUUID.begin(),
+                  header.pipelineCacheUUID.end(),
+                  props.pipelineCacheUUID.begin()) ||
+      header.dataSize != fileSize - sizeof(header)) {
+    fmt::println("Discarding pipeline cache '{}': device or driver mismatch.",
+                 m_path.string());
+    return {};
+  }
+
+  std::vector<uint8_t> blob(header.dataSize);
+  if (!file.read(reinterpret_cast<char *>(blob.data()), // NOLINT
+                 static_cast<std::streamsize>(blob.size())) ||
+      checksum(blob.data(), blob.size()) != header.checksum ||
+      !driverHeaderMatches(blob, props)) {
+    fmt::println("Discarding pipeline cache '{}': corrupt blob.",
+                 m_path.string());
+    return {};
+  }
+
+  return blob;
+}
+
+void PipelineCache::save() const {
+  const auto blob = m_device.getPipelineCacheData(m_cache);
+
+  CacheFileHeader header{};
+  header.magic = CACHE_FILE_MAGIC;
+  header.version = CACHE_FILE_VERSION;
+  header.vendorID = m_properties.vendorID;
+  header.deviceID = m_properties.deviceID;
+  header.driverVersion = m_properties.driverVersion;
+  std::copy(m_properties.pipelineCacheUUID.begin(),
+            m_properties.pipelineCacheUUID.end(),
+            header.pipelineCacheUUID.begin());
+  header.dataSize = blob.size();
+  header.checksum = checksum(blob.data(), blob.size());
+
+  writeFileAtomically(m_path, [&](std::ostream &file) {
+    file.write(reinterpret_cast<const char *>(&header), // NOLINT
+               sizeof(header));
+    file.write(reinterpret_cast<const char *>(blob.data()), // NOLINT
+               static_cast<std::streamsize>(blob.size()));
+  });
+}
+
+} // namespace vcm
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Common.hpp"
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+/*
+Persistent vk::PipelineCache
+
+The cache blob is stored on disk behind a small header that records the
+vendor ID, device ID, driver version and pipelineCacheUUID of the physical
+device that produced it. A blob written by another device or driver is
+discarded at load time instead of being handed to the driver.
+
+Threads creating pipelines, such as VulkanComputeManager::warmUp()'s
+workers, all build into the one cache; Vulkan synchronizes it internally.
+
+https://docs.vulkan.org/samples/latest/samples/performance/hpp_pipeline_cache/README.html
+*/
+class PipelineCache {
+public:
+  PipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice,
+                const fs::path &cacheDir);
+
+  PipelineCache(const PipelineCache &) = delete;
+  PipelineCache(PipelineCache &&) = delete;
+  PipelineCache &operator=(const PipelineCache &) = delete;
+  PipelineCache &operator=(PipelineCache &&) = delete;
+
+  // Saves the cache to disk and destroys it
+  ~PipelineCache();
+
+  [[nodiscard]] auto get() const { return m_cache; }
+  [[nodiscard]] auto &path() const { return m_path; }
+
+  // True if a valid blob was loaded from disk at construction
+  [[nodiscard]] auto loadedFromDisk() const { return m_loadedFromDisk; }
+
+  // Write the cache to disk. The file is written to a temporary path first
+  // and renamed over the old file so readers never see a partial blob.
+  void save() const;
+
+private:
+  vk::Device m_device;
+  vk::PhysicalDeviceProperties m_properties;
+  fs::path m_path;
+  vk::PipelineCache m_cache;
+  bool m_loadedFromDisk{false};
+
+  [[nodiscard]] std::vector<uint8_t> loadValidatedBlob() const;
+};
+
+} // namespace vcm
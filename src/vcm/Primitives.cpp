@@ -0,0 +1,309 @@
+#include "Primitives.hpp"
+#include "Shader.hpp"
+#include "StagingEngine.hpp"
+#include "VulkanComputeManager.hpp"
+#include <algorithm>
+#include <array>
+#include <fmt/format.h>
+#include <span>
+#include <stdexcept>
+
+namespace vcm {
+
+namespace {
+
+// Push constant blocks of the shaders
+struct ReducePushConstants {
+  uint32_t count;
+  uint32_t op;
+  uint32_t pass;
+};
+
+struct ScanReducePushConstants {
+  uint32_t count;
+  uint32_t firstTile;
+};
+
+struct ScanPushConstants {
+  uint32_t count;
+  uint32_t firstTile;
+  uint32_t inclusive;
+  uint32_t hasOffsets;
+};
+
+uint32_t tilesFor(uint32_t count) {
+  return (count + Primitives::TILE_SIZE - 1) / Primitives::TILE_SIZE;
+}
+
+uint32_t checkedCount(size_t count) {
+  if (count > UINT32_MAX) {
+    throw std::runtime_error(
+        fmt::format("Primitives take at most {} elements, got {}.",
+                    UINT32_MAX, count));
+  }
+  return static_cast<uint32_t>(count);
+}
+
+} // namespace
+
+ReduceResult reduceIdentity(ReduceOp op) {
+  switch (op) {
+  case ReduceOp::Min:
+  case ReduceOp::ArgMin:
+    return {UINT32_MAX, UINT32_MAX};
+  case ReduceOp::Max:
+  case ReduceOp::ArgMax:
+    return {0, UINT32_MAX};
+  default:
+    return {0, 0};
+  }
+}
+
+// Ties go to the lower index, like the kernel
+ReduceResult combine(ReduceOp op, const ReduceResult &a,
+                     const ReduceResult &b) {
+  switch (op) {
+  case ReduceOp::Min:
+    return {std::min(a.value, b.value), 0};
+  case ReduceOp::Max:
+    return {std::max(a.value, b.value), 0};
+  case ReduceOp::ArgMin:
+    return (b.value < a.value || (b.value == a.value && b.index < a.index))
+               ? b
+               : a;
+  case ReduceOp::ArgMax:
+    return (b.value > a.value || (b.value == a.value && b.index < a.index))
+               ? b
+               : a;
+  default:
+    return {a.value + b.value, 0};
+  }
+}
+
+Primitives::Primitives(VulkanComputeManager &manager) : m_manager(manager) {
+  const auto physicalDevice = m_manager.get_physicalDevice();
+  const auto subgroup =
+      physicalDevice
+          .getProperties2<vk::PhysicalDeviceProperties2,
+                          vk::PhysicalDeviceSubgroupProperties>()
+          .get<vk::PhysicalDeviceSubgroupProperties>();
+  const auto operations = vk::SubgroupFeatureFlagBits::eBasic |
+                          vk::SubgroupFeatureFlagBits::eArithmetic;
+  if (!(subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) ||
+      (subgroup.supportedOperations & operations) != operations) {
+    throw std::runtime_error(
+        "Primitives need subgroup arithmetic in compute shaders.");
+  }
+
+  // Whole alignment units, so reduce() can bind chunks back to back
+  const auto &limits = physicalDevice.getProperties().limits;
+  const auto unit = std::max<vk::DeviceSize>(
+      limits.minStorageBufferOffsetAlignment / sizeof(uint32_t), 1);
+  const auto maxElements = limits.maxStorageBufferRange / sizeof(uint32_t);
+  m_maxElements = static_cast<uint32_t>(
+      std::min<vk::DeviceSize>(maxElements - maxElements % unit, UINT32_MAX));
+
+  m_reduce = loadKernel(m_manager, "shaders/reduce.spv", "reduce");
+  m_scanReduce =
+      loadKernel(m_manager, "shaders/scan_reduce.spv", "scan reduce");
+  m_scan = loadKernel(m_manager, "shaders/scan.spv", "scan");
+
+  const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  m_partials = m_manager.createBuffer<ReduceResult>(
+      MAX_REDUCE_GROUPS, usage, HostAccess::None, "primitives");
+  m_result = m_manager.createBuffer<ReduceResult>(1, usage, HostAccess::Random,
+                                                  "primitives");
+}
+
+// Out of line, where StagingEngine is complete
+Primitives::~Primitives() = default;
+
+std::unique_ptr<ComputeKernel>
+Primitives::loadKernel(VulkanComputeManager &manager, const char *fileName,
+                       std::string name) {
+  const auto spirv = readSpirv(fileName);
+  auto kernel = std::make_unique<ComputeKernel>(
+      manager.get_device(), manager.get_pipelineCache(),
+      manager.get_descriptorSetCache(), spirv, "Main", &manager.get_profiler(),
+      std::move(name), &manager.get_shaderModuleCache());
+  if (kernel->workgroupSize()[0] != GROUP_SIZE) {
+    throw std::runtime_error(
+        fmt::format("Kernel '{}' has workgroup size {}, expected {}.",
+                    kernel->name(), kernel->workgroupSize()[0], GROUP_SIZE));
+  }
+  kernel->setDispatchLimits(
+      DispatchLimits::fromDevice(manager.get_physicalDevice()));
+  return kernel;
+}
+
+void Primitives::checkRange(uint32_t count) const {
+  if (count > m_maxElements) {
+    throw std::runtime_error(fmt::format(
+        "Primitives bind at most {} elements (maxStorageBufferRange), got {}.",
+        m_maxElements, count));
+  }
+}
+
+void Primitives::recordReduce(vk::CommandBuffer commandBuffer, ReduceOp op,
+                              const vk::DescriptorBufferInfo &input,
+                              uint32_t count,
+                              const vk::DescriptorBufferInfo &result) {
+  checkRange(count);
+  // Enough work per workgroup to hide the second pass, few enough partials
+  // for one workgroup
+  const auto groups = std::clamp(tilesFor(count), 1U, MAX_REDUCE_GROUPS);
+
+  const std::array buffers{input, m_partials.descriptor(), result};
+  const auto descriptorSet =
+      m_reduce->bind(std::span<const vk::DescriptorBufferInfo>(buffers));
+
+  m_reduce->pushConstants(commandBuffer, ReducePushConstants{
+                                             count, static_cast<uint32_t>(op),
+                                             0});
+  m_reduce->dispatch(commandBuffer, descriptorSet, groups);
+  memoryBarrierComputeThenCompute(commandBuffer);
+  m_reduce->pushConstants(commandBuffer, ReducePushConstants{
+                                             groups, static_cast<uint32_t>(op),
+                                             1});
+  m_reduce->dispatch(commandBuffer, descriptorSet, 1);
+}
+
+void Primitives::recordScan(vk::CommandBuffer commandBuffer,
+                            const vk::DescriptorBufferInfo &input,
+                            const vk::DescriptorBufferInfo &output,
+                            uint32_t count, bool inclusive) {
+  checkRange(count);
+  if (count > 0) {
+    recordScanLevel(commandBuffer, 0, input, output, count, inclusive);
+  }
+}
+
+void Primitives::recordScanLevel(vk::CommandBuffer commandBuffer,
+                                 size_t level,
+                                 const vk::DescriptorBufferInfo &input,
+                                 const vk::DescriptorBufferInfo &output,
+                                 uint32_t count, bool inclusive) {
+  const auto tiles = tilesFor(count);
+  if (tiles == 1) {
+    // Input bound again in place of the unused offsets
+    const std::array buffers{input, input, output};
+    const auto descriptorSet =
+        m_scan->bind(std::span<const vk::DescriptorBufferInfo>(buffers));
+    dispatchTiles(commandBuffer, *m_scan, descriptorSet, 1,
+                  ScanPushConstants{count, 0, inclusive, 0});
+    return;
+  }
+
+  if (m_scanLevels.size() <= level) {
+    m_scanLevels.resize(level + 1);
+  }
+  auto &[sums, offsets] = m_scanLevels[level];
+  if (sums.size() < tiles) {
+    const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    sums = m_manager.createBuffer<uint32_t>(tiles, usage, HostAccess::None,
+                                            "primitives");
+    offsets = m_manager.createBuffer<uint32_t>(tiles, usage,
+                                               HostAccess::None, "primitives");
+  }
+  // The next level may grow m_scanLevels
+  const auto sumsInfo = sums.descriptor(0, tiles);
+  const auto offsetsInfo = offsets.descriptor(0, tiles);
+
+  const std::array reduceBuffers{input, sumsInfo};
+  dispatchTiles(commandBuffer, *m_scanReduce,
+                m_scanReduce->bind(
+                    std::span<const vk::DescriptorBufferInfo>(reduceBuffers)),
+                tiles, ScanReducePushConstants{count, 0});
+  memoryBarrierComputeThenCompute(commandBuffer);
+
+  recordScanLevel(commandBuffer, level + 1, sumsInfo, offsetsInfo, tiles,
+                  false);
+  memoryBarrierComputeThenCompute(commandBuffer);
+
+  const std::array scanBuffers{input, offsetsInfo, output};
+  dispatchTiles(commandBuffer, *m_scan,
+                m_scan->bind(
+                    std::span<const vk::DescriptorBufferInfo>(scanBuffers)),
+                tiles, ScanPushConstants{count, 0, inclusive, 1});
+}
+
+ReduceResult Primitives::reduce(ReduceOp op, const Buffer<uint32_t> &input) {
+  return reduce(op, input, checkedCount(input.size()));
+}
+
+ReduceResult Primitives::reduce(ReduceOp op, const Buffer<uint32_t> &input,
+                                uint32_t count) {
+  if (count <= m_maxElements) {
+    auto commandBuffer = m_manager.beginOneTimeCommands();
+    recordReduce(commandBuffer, op, input.descriptor(), count,
+                 m_result.descriptor());
+    memoryBarrierComputeThenHost(commandBuffer);
+    m_manager.submitOneTime(commandBuffer).wait();
+    return m_result.read()[0];
+  }
+
+  // One bindable range at a time, combined in order on the host
+  const bool hasIndex = op == ReduceOp::ArgMin || op == ReduceOp::ArgMax;
+  auto result = reduceIdentity(op);
+  for (uint32_t first = 0; first < count;) {
+    const auto chunk = std::min(m_maxElements, count - first);
+    auto commandBuffer = m_manager.beginOneTimeCommands();
+    recordReduce(commandBuffer, op, input.descriptor(first, chunk), chunk,
+                 m_result.descriptor());
+    memoryBarrierComputeThenHost(commandBuffer);
+    m_manager.submitOneTime(commandBuffer).wait();
+
+    auto partial = m_result.read()[0];
+    if (hasIndex) {
+      partial.index += first;
+    }
+    result = combine(op, result, partial);
+    first += chunk;
+  }
+  return result;
+}
+
+ReduceResult Primitives::reduce(ReduceOp op,
+                                std::span<const uint32_t> input) {
+  if (input.empty()) {
+    return reduceIdentity(op);
+  }
+  const auto count = checkedCount(input.size());
+  if (!m_staging) {
+    m_staging = std::make_unique<StagingEngine>(m_manager);
+  }
+  m_manager.growBuffer(m_upload, count,
+                       vk::BufferUsageFlagBits::eStorageBuffer |
+                           vk::BufferUsageFlagBits::eTransferDst,
+                       HostAccess::None, "primitives");
+  // upload() orders the copy before the reduction's dispatches
+  m_staging->upload(std::as_bytes(input), m_upload.buffer());
+  return reduce(op, m_upload, count);
+}
+
+void Primitives::scan(const Buffer<uint32_t> &input, Buffer<uint32_t> &output,
+                      bool inclusive) {
+  if (output.size() < input.size()) {
+    throw std::runtime_error(
+        fmt::format("Scan output of {} elements is smaller than its input "
+                    "of {}.",
+                    output.size(), input.size()));
+  }
+  auto commandBuffer = m_manager.beginOneTimeCommands();
+  recordScan(commandBuffer, input.descriptor(), output.descriptor(),
+             checkedCount(input.size()), inclusive);
+  memoryBarrierComputeThenHost(commandBuffer);
+  m_manager.submitOneTime(commandBuffer).wait();
+}
+
+void Primitives::inclusiveScan(const Buffer<uint32_t> &input,
+                               Buffer<uint32_t> &output) {
+  scan(input, output, true);
+}
+
+void Primitives::exclusiveScan(const Buffer<uint32_t> &input,
+                               Buffer<uint32_t> &output) {
+  scan(input, output, false);
+}
+
+} // namespace vcm
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "ComputeKernel.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+class StagingEngine;
+class VulkanComputeManager;
+
+enum class ReduceOp : uint32_t { Sum, Min, Max, ArgMin, ArgMax };
+
+// Result of a reduction, as written by the reduce kernel. index is the first
+// element holding value for ArgMin/ArgMax (UINT32_MAX for no elements) and 0
+// otherwise.
+struct ReduceResult {
+  uint32_t value;
+  uint32_t index;
+};
+
+// The result of reducing no elements, and of reducing a's elements followed
+// by b's, as the reduce kernel combines them. For combining reductions of
+// parts of an input on the host.
+ReduceResult reduceIdentity(ReduceOp op);
+ReduceResult combine(ReduceOp op, const ReduceResult &a,
+                     const ReduceResult &b);
+
+/*
+Reductions and prefix sums over uint32 arrays, on subgroup operations and
+workgroup shared memory.
+
+reduce() takes two dispatches: a grid of at most MAX_REDUCE_GROUPS
+workgroups, each reducing a grid stride share of the input to one partial,
+then one workgroup over the partials. Sums wrap around like uint32 on the
+host.
+
+Scans are reduce-then-scan over tiles of TILE_SIZE elements: the sum of
+every tile, an exclusive scan of those sums (recursively, until they fit
+one tile), then a scan of each tile offset by the sum before it. That is
+about three passes over the input, against the two of a decoupled look-back
+single pass scan, but needs no forward progress guarantees between
+workgroups, which Vulkan does not give.
+
+record*() record into a caller's command buffer with barriers between
+their own dispatches only; the caller orders them against the producers
+and consumers of the buffers. The other calls submit and wait. Inputs are
+bound whole, so record*() and the scans take at most maxElements(), the
+elements of one maxStorageBufferRange; reduce() splits larger buffers and
+combines the results on the host.
+
+Intermediate buffers are owned by the object and grown on demand, so work
+recorded from one Primitives must complete before more is recorded. So are
+the staging engine and device buffer of reductions over host arrays,
+created by the first one. Not thread safe.
+*/
+class Primitives {
+public:
+  // Must match the shaders
+  static constexpr uint32_t GROUP_SIZE = 256;
+  static constexpr uint32_t ITEMS_PER_THREAD = 8;
+  static constexpr uint32_t TILE_SIZE = GROUP_SIZE * ITEMS_PER_THREAD;
+  static constexpr uint32_t MAX_REDUCE_GROUPS = 1024;
+
+  // Throws if the device lacks subgroup arithmetic in compute shaders
+  explicit Primitives(VulkanComputeManager &manager);
+
+  Primitives(const Primitives &) = delete;
+  Primitives(Primitives &&) = delete;
+  Primitives &operator=(const Primitives &) = delete;
+  Primitives &operator=(Primitives &&) = delete;
+
+  ~Primitives();
+
+  // Largest count record*() take: the device's maxStorageBufferRange in
+  // elements, rounded down to whole minStorageBufferOffsetAlignment units
+  [[nodiscard]] uint32_t maxElements() const { return m_maxElements; }
+
+  // Reduce the first count elements of input to one ReduceResult in result
+  void recordReduce(vk::CommandBuffer commandBuffer, ReduceOp op,
+                    const vk::DescriptorBufferInfo &input, uint32_t count,
+                    const vk::DescriptorBufferInfo &result);
+
+  // Prefix sum of the first count elements of input into output, which may
+  // be the same range
+  void recordScan(vk::CommandBuffer commandBuffer,
+                  const vk::DescriptorBufferInfo &input,
+                  const vk::DescriptorBufferInfo &output, uint32_t count,
+                  bool inclusive);
+
+  ReduceResult reduce(ReduceOp op, const Buffer<uint32_t> &input);
+  // Over a host array, uploaded to a device buffer kept for the next call
+  ReduceResult reduce(ReduceOp op, std::span<const uint32_t> input);
+  uint32_t sum(const Buffer<uint32_t> &input) {
+    return reduce(ReduceOp::Sum, input).value;
+  }
+  uint32_t min(const Buffer<uint32_t> &input) {
+    return reduce(ReduceOp::Min, input).value;
+  }
+  uint32_t max(const Buffer<uint32_t> &input) {
+    return reduce(ReduceOp::Max, input).value;
+  }
+  // Index of the first smallest/largest element
+  uint32_t argMin(const Buffer<uint32_t> &input) {
+    return reduce(ReduceOp::ArgMin, input).index;
+  }
+  uint32_t argMax(const Buffer<uint32_t> &input) {
+    return reduce(ReduceOp::ArgMax, input).index;
+  }
+
+  // output[i] = input[0] + ... + input[i]
+  void inclusiveScan(const Buffer<uint32_t> &input, Buffer<uint32_t> &output);
+  // output[i] = input[0] + ... + input[i - 1], output[0] = 0
+  void exclusiveScan(const Buffer<uint32_t> &input, Buffer<uint32_t> &output);
+
+  // Kernel from a shader with a fixed GROUP_SIZE workgroup, as the
+  // primitives use. Not from the manager's cache, so never retuned.
+  static std::unique_ptr<ComputeKernel>
+  loadKernel(VulkanComputeManager &manager, const char *fileName,
+             std::string name);
+
+  // Record tileCount workgroups of a kernel with one workgroup per tile,
+  // split into several dispatches past maxGroupCountX. PushConstants has a
+  // firstTile member, the tile of workgroup 0 in each dispatch.
+  template <typename PushConstants>
+  static void dispatchTiles(vk::CommandBuffer commandBuffer,
+                            const ComputeKernel &kernel,
+                            vk::DescriptorSet descriptorSet,
+                            uint32_t tileCount, PushConstants pushConstants) {
+    const auto maxGroups = kernel.dispatchLimits().maxGroupCountX;
+    for (uint32_t first = 0; first < tileCount; first += maxGroups) {
+      pushConstants.firstTile = first;
+      kernel.pushConstants(commandBuffer, pushConstants);
+      kernel.dispatch(commandBuffer, descriptorSet,
+                      std::min(maxGroups, tileCount - first));
+    }
+  }
+
+private:
+  VulkanComputeManager &m_manager;
+  uint32_t m_maxElements;
+  std::unique_ptr<ComputeKernel> m_reduce;
+  std::unique_ptr<ComputeKernel> m_scanReduce;
+  std::unique_ptr<ComputeKernel> m_scan;
+
+  Buffer<ReduceResult> m_partials;
+  Buffer<ReduceResult> m_result;
+
+  // Tile sums and their exclusive scan, per recursion level of a scan
+  struct ScanLevel {
+    Buffer<uint32_t> sums;
+    Buffer<uint32_t> offsets;
+  };
+  std::vector<ScanLevel> m_scanLevels;
+
+  // Host arrays to reduce() go through these
+  std::unique_ptr<StagingEngine> m_staging;
+  Buffer<uint32_t> m_upload;
+
+  void recordScanLevel(vk::CommandBuffer commandBuffer, size_t level,
+                       const vk::DescriptorBufferInfo &input,
+                       const vk::DescriptorBufferInfo &output, uint32_t count,
+                       bool inclusive);
+  void scan(const Buffer<uint32_t> &input, Buffer<uint32_t> &output,
+            bool inclusive);
+  void checkRange(uint32_t count) const;
+  // The first count elements of input
+  ReduceResult reduce(ReduceOp op, const Buffer<uint32_t> &input,
+                      uint32_t count);
+};
+
+} // namespace vcm
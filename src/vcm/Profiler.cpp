@@ -0,0 +1,276 @@
+#include "Profiler.hpp"
+#include "CommandPools.hpp"
+#include "Timeline.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <fmt/os.h>
+
+namespace vcm {
+
+namespace {
+
+// Chrome trace track ids for GPU queue families, above any host thread's
+constexpr uint32_t GPU_TRACK_BASE = 1000;
+
+} // namespace
+
+Profiler::Profiler(vk::Device device, vk::PhysicalDevice physicalDevice,
+                   bool hostQueryReset, uint32_t defaultQueueFamilyIndex)
+    : m_device(device), m_defaultQueueFamilyIndex(defaultQueueFamilyIndex),
+      m_epoch(std::chrono::steady_clock::now()) {
+  const auto properties = physicalDevice.getProperties();
+  m_timestampPeriod = properties.limits.timestampPeriod;
+  for (const auto &family : physicalDevice.getQueueFamilyProperties()) {
+    m_timestampValidBits.push_back(family.timestampValidBits);
+  }
+  m_calibrations.resize(m_timestampValidBits.size());
+
+  const bool anyTimestamps = std::ranges::any_of(
+      m_timestampValidBits, [](uint32_t bits) { return bits > 0; });
+  if (!hostQueryReset || !anyTimestamps || m_timestampPeriod <= 0.0) {
+    fmt::println("-- GPU profiling unsupported on this device");
+    return;
+  }
+
+  m_queryPool = m_device.createQueryPool(
+      {vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, 2 * MAX_SCOPES});
+
+  m_freeScopes.reserve(MAX_SCOPES);
+  for (uint32_t i = MAX_SCOPES; i > 0; --i) {
+    m_freeScopes.push_back(i - 1);
+  }
+
+  // NOLINTNEXTLINE(concurrency-mt-unsafe)
+  if (const char *env = std::getenv("VCM_PROFILE");
+      env != nullptr && std::string_view(env) != "0") {
+    setEnabled(true);
+  }
+}
+
+Profiler::~Profiler() { m_device.destroyQueryPool(m_queryPool); }
+
+GpuScope Profiler::beginGpuScope(vk::CommandBuffer commandBuffer,
+                                 std::string_view name,
+                                 uint32_t queueFamilyIndex) {
+  if (queueFamilyIndex >= m_timestampValidBits.size() ||
+      m_timestampValidBits[queueFamilyIndex] == 0) {
+    return {};
+  }
+
+  uint32_t scope = 0;
+  {
+    std::scoped_lock lock(m_mutex);
+    if (m_freeScopes.empty()) {
+      // Too many scopes in flight without a collect(); skip rather than
+      // block or grow the pool
+      if (m_dropped++ == 0) {
+        fmt::println("-- GPU profiler: all {} query pairs in use, dropping "
+                     "scopes until collect() frees some",
+                     MAX_SCOPES);
+      }
+      return {};
+    }
+    scope = m_freeScopes.back();
+    m_freeScopes.pop_back();
+    m_pending.emplace(scope, PendingScope{std::string(name), queueFamilyIndex,
+                                          commandBuffer});
+  }
+
+  // The pair is not in use by the GPU (it was free), so it can be reset here
+  // rather than with a command, which transfer queues do not support
+  const auto query = 2 * scope;
+  m_device.resetQueryPool(m_queryPool, query, 2);
+  commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                               m_queryPool, query);
+  return {this, commandBuffer, query};
+}
+
+void Profiler::endGpuScope(vk::CommandBuffer commandBuffer, uint32_t query) {
+  commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                               m_queryPool, query + 1);
+}
+
+void Profiler::endCpuScope(std::string name,
+                           std::chrono::steady_clock::time_point start) {
+  const auto end = std::chrono::steady_clock::now();
+
+  std::scoped_lock lock(m_mutex);
+  const auto [it, inserted] = m_threadTracks.try_emplace(
+      std::this_thread::get_id(),
+      static_cast<uint32_t>(m_threadTracks.size()));
+  m_events.push_back({std::move(name), hostNs(start),
+                      hostNs(end) - hostNs(start), false, it->second});
+}
+
+void Profiler::calibrate(TimelineQueue &queue,
+                         CommandBufferRecycler &commands) {
+  if (!supported() || m_timestampValidBits[queue.familyIndex()] == 0) {
+    return;
+  }
+
+  // Borrow a query pair; the pool is fixed size so one is always free unless
+  // every scope is in flight
+  uint32_t scope = 0;
+  {
+    std::scoped_lock lock(m_mutex);
+    if (m_freeScopes.empty()) {
+      return;
+    }
+    scope = m_freeScopes.back();
+    m_freeScopes.pop_back();
+  }
+  const auto query = 2 * scope;
+  m_device.resetQueryPool(m_queryPool, query, 1);
+
+  auto commandBuffer = commands.begin();
+  commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                               m_queryPool, query);
+  commandBuffer.end();
+
+  // The timestamp is written somewhere between submitting and the wait
+  // returning; the midpoint bounds the error by half the round trip
+  const auto before = std::chrono::steady_clock::now();
+  const auto ticket = queue.submit(commandBuffer);
+  ticket.wait();
+  const auto after = std::chrono::steady_clock::now();
+  commands.recycle(commandBuffer, ticket);
+
+  uint64_t ticks = 0;
+  const auto result = m_device.getQueryPoolResults(
+      m_queryPool, query, 1, sizeof(ticks), &ticks, sizeof(ticks),
+      vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+
+  std::scoped_lock lock(m_mutex);
+  m_freeScopes.push_back(scope);
+  if (result == vk::Result::eSuccess) {
+    m_calibrations[queue.familyIndex()] = {
+        ticks, (hostNs(before) + hostNs(after)) / 2.0, true};
+  }
+}
+
+std::optional<std::pair<uint64_t, uint64_t>>
+Profiler::timestamps(uint32_t scope) const {
+  // Begin and end timestamps, each followed by its availability
+  std::array<uint64_t, 4> results{};
+  const auto result = m_device.getQueryPoolResults(
+      m_queryPool, 2 * scope, 2, sizeof(results), results.data(),
+      2 * sizeof(uint64_t),
+      vk::QueryResultFlagBits::e64 |
+          vk::QueryResultFlagBits::eWithAvailability);
+  if ((result != vk::Result::eSuccess && result != vk::Result::eNotReady) ||
+      results[1] == 0 || results[3] == 0) {
+    return std::nullopt;
+  }
+  return std::pair{results[0], results[2]};
+}
+
+void Profiler::collect() {
+  if (!supported()) {
+    return;
+  }
+
+  std::scoped_lock lock(m_mutex);
+  for (auto it = m_pending.begin(); it != m_pending.end();) {
+    const auto &[scope, pending] = *it;
+    const auto ticks = timestamps(scope);
+    if (!ticks) {
+      ++it;
+      continue;
+    }
+
+    const auto validBits = m_timestampValidBits[pending.queueFamilyIndex];
+    const auto mask =
+        validBits >= 64 ? ~uint64_t{0} : (uint64_t{1} << validBits) - 1;
+    const auto begin = ticks->first & mask;
+    const auto end = ticks->second & mask;
+
+    // Signed so scopes recorded before calibration still land correctly
+    const auto &calibration =
+        m_calibrations[pending.queueFamilyIndex].valid
+            ? m_calibrations[pending.queueFamilyIndex]
+            : m_calibrations[m_defaultQueueFamilyIndex];
+    const auto sinceCalibration =
+        static_cast<double>(static_cast<int64_t>(begin - calibration.ticks));
+    m_events.push_back(
+        {pending.name,
+         calibration.hostNs + sinceCalibration * m_timestampPeriod,
+         static_cast<double>((end - begin) & mask) * m_timestampPeriod, true,
+         pending.queueFamilyIndex});
+
+    m_freeScopes.push_back(scope);
+    it = m_pending.erase(it);
+  }
+}
+
+void Profiler::discard(vk::CommandBuffer commandBuffer) {
+  if (!supported()) {
+    return;
+  }
+
+  std::scoped_lock lock(m_mutex);
+  for (auto it = m_pending.begin(); it != m_pending.end();) {
+    // Executed scopes keep their results for collect()
+    if (it->second.commandBuffer != commandBuffer || timestamps(it->first)) {
+      ++it;
+      continue;
+    }
+    m_freeScopes.push_back(it->first);
+    it = m_pending.erase(it);
+  }
+}
+
+void Profiler::writeChromeTrace(const fs::path &path) {
+  collect();
+
+  std::scoped_lock lock(m_mutex);
+  auto out = fmt::output_file(path.string());
+  out.print("{{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+  // Track names
+  bool first = true;
+  const auto separator = [&first] {
+    const char *sep = first ? "" : ",\n";
+    first = false;
+    return sep;
+  };
+  for (uint32_t family = 0; family < m_timestampValidBits.size(); ++family) {
+    out.print("{}{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,"
+              "\"tid\":{},\"args\":{{\"name\":\"GPU queue family {}\"}}}}",
+              separator(), GPU_TRACK_BASE + family, family);
+  }
+  for (const auto &[thread, track] : m_threadTracks) {
+    out.print("{}{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,"
+              "\"tid\":{},\"args\":{{\"name\":\"Host thread {}\"}}}}",
+              separator(), track, track);
+  }
+
+  // Complete events, timestamps in microseconds
+  for (const auto &event : m_events) {
+    out.print("{}{{\"ph\":\"X\",\"name\":\"{}\",\"cat\":\"{}\",\"pid\":0,"
+              "\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+              separator(), jsonEscape(event.name), event.gpu ? "gpu" : "cpu",
+              event.gpu ? GPU_TRACK_BASE + event.track : event.track,
+              event.startNs / 1e3, event.durationNs / 1e3);
+  }
+  out.print("\n]}}\n");
+
+  fmt::println("-- Wrote {} profiler events to {}{}", m_events.size(),
+               path.string(),
+               m_dropped > 0 ? fmt::format(" ({} scopes dropped)", m_dropped)
+                             : "");
+}
+
+void Profiler::clear() {
+  std::scoped_lock lock(m_mutex);
+  m_events.clear();
+  m_dropped = 0;
+}
+
+std::vector<Profiler::Event> Profiler::events() const {
+  std::scoped_lock lock(m_mutex);
+  return m_events;
+}
+
+} // namespace vcm
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "Common.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Build with -DVCM_PROFILING=0 to compile all profiling scopes away
+#ifndef VCM_PROFILING
+#define VCM_PROFILING 1
+#endif
+
+namespace vcm {
+
+constexpr bool PROFILING_COMPILED = VCM_PROFILING != 0;
+
+class Profiler;
+class TimelineQueue;
+class CommandBufferRecycler;
+
+/*
+Times the commands recorded while it is alive with a pair of timestamp
+queries. Empty (and free) when profiling is off.
+*/
+class GpuScope {
+public:
+  GpuScope() = default;
+  GpuScope(Profiler *profiler, vk::CommandBuffer commandBuffer,
+           uint32_t query)
+      : m_profiler(profiler), m_commandBuffer(commandBuffer), m_query(query) {}
+
+  GpuScope(const GpuScope &) = delete;
+  GpuScope &operator=(const GpuScope &) = delete;
+  GpuScope(GpuScope &&other) noexcept
+      : m_profiler(std::exchange(other.m_profiler, nullptr)),
+        m_commandBuffer(other.m_commandBuffer), m_query(other.m_query) {}
+  GpuScope &operator=(GpuScope &&) = delete;
+
+  ~GpuScope();
+
+private:
+  Profiler *m_profiler{};
+  vk::CommandBuffer m_commandBuffer;
+  uint32_t m_query{};
+};
+
+// Times the host code in its lifetime. Empty when profiling is off.
+class CpuScope {
+public:
+  CpuScope() = default;
+  CpuScope(Profiler *profiler, std::string_view name)
+      : m_profiler(profiler), m_name(name),
+        m_start(std::chrono::steady_clock::now()) {}
+
+  CpuScope(const CpuScope &) = delete;
+  CpuScope &operator=(const CpuScope &) = delete;
+  CpuScope(CpuScope &&other) noexcept
+      : m_profiler(std::exchange(other.m_profiler, nullptr)),
+        m_name(std::move(other.m_name)), m_start(other.m_start) {}
+  CpuScope &operator=(CpuScope &&) = delete;
+
+  ~CpuScope();
+
+private:
+  Profiler *m_profiler{};
+  std::string m_name;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+/*
+GPU timestamp profiler with Chrome trace export.
+
+gpuScope() brackets recorded commands with timestamp queries. Once the GPU
+has executed them, collect() reads the results, converts ticks to
+nanoseconds with timestampPeriod and moves them onto the host clock using an
+offset measured by calibrate() on a queue of the same family. cpuScope()
+records host work on the same clock, so both show up on one timeline in
+writeChromeTrace() output (chrome://tracing or ui.perfetto.dev).
+
+Each scope holds one of MAX_SCOPES query pairs until collect() reads it, or
+discard() finds its command buffer was never executed. Scopes begun while
+every pair is held are dropped, with a warning.
+
+Disabled at runtime by default; enable with setEnabled() or the VCM_PROFILE
+environment variable. Disabled scopes cost one relaxed atomic load, and
+nothing at all when built with VCM_PROFILING=0.
+*/
+class Profiler {
+public:
+  static constexpr uint32_t MAX_SCOPES = 4096;
+
+  // Needs hostQueryReset; without it, or without timestamp support on the
+  // device, the profiler stays disabled. Scopes without a queue family are
+  // assumed to be recorded for defaultQueueFamilyIndex.
+  Profiler(vk::Device device, vk::PhysicalDevice physicalDevice,
+           bool hostQueryReset, uint32_t defaultQueueFamilyIndex);
+
+  Profiler(const Profiler &) = delete;
+  Profiler(Profiler &&) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+  Profiler &operator=(Profiler &&) = delete;
+
+  ~Profiler();
+
+  [[nodiscard]] bool supported() const {
+    return static_cast<bool>(m_queryPool);
+  }
+  [[nodiscard]] bool enabled() const {
+    return PROFILING_COMPILED && m_enabled.load(std::memory_order_relaxed);
+  }
+  void setEnabled(bool enabled) { m_enabled = enabled && supported(); }
+
+  // Time the commands recorded into commandBuffer, a command buffer for
+  // queueFamilyIndex, until the scope ends
+  [[nodiscard]] GpuScope gpuScope(vk::CommandBuffer commandBuffer,
+                                  std::string_view name,
+                                  uint32_t queueFamilyIndex) {
+    if constexpr (PROFILING_COMPILED) {
+      if (enabled()) {
+        return beginGpuScope(commandBuffer, name, queueFamilyIndex);
+      }
+    }
+    return {};
+  }
+  [[nodiscard]] GpuScope gpuScope(vk::CommandBuffer commandBuffer,
+                                  std::string_view name) {
+    return gpuScope(commandBuffer, name, m_defaultQueueFamilyIndex);
+  }
+
+  [[nodiscard]] CpuScope cpuScope(std::string_view name) {
+    if constexpr (PROFILING_COMPILED) {
+      if (enabled()) {
+        return {this, name};
+      }
+    }
+    return {};
+  }
+
+  // Measure the offset between the GPU timestamp counter and the host clock
+  // with a timestamp written on queue, for the scopes of its family. Blocks
+  // until it has executed. Families never calibrated use the default one's.
+  void calibrate(TimelineQueue &queue, CommandBufferRecycler &commands);
+
+  // Read back all scopes the GPU has finished. Scopes recorded into command
+  // buffers that are not yet executed stay pending.
+  void collect();
+
+  // Release the query pairs of scopes in commandBuffer that never executed,
+  // before it is reset or freed. It must not be pending on the GPU.
+  void discard(vk::CommandBuffer commandBuffer);
+
+  // Collect, then write all events so far as Chrome trace JSON
+  void writeChromeTrace(const fs::path &path);
+
+  // Drop collected events
+  void clear();
+
+  struct Event {
+    std::string name;
+    // Nanoseconds on the host clock since the profiler was created
+    double startNs;
+    double durationNs;
+    // GPU events: the queue family. Host events: the thread.
+    bool gpu;
+    uint32_t track;
+  };
+  [[nodiscard]] std::vector<Event> events() const;
+
+private:
+  friend class GpuScope;
+  friend class CpuScope;
+
+  vk::Device m_device;
+  uint32_t m_defaultQueueFamilyIndex;
+  vk::QueryPool m_queryPool;
+  double m_timestampPeriod{1.0};
+  // Valid bits of the timestamps of each queue family, 0 if unsupported
+  std::vector<uint32_t> m_timestampValidBits;
+
+  std::atomic<bool> m_enabled{false};
+  std::chrono::steady_clock::time_point m_epoch;
+
+  // GPU ticks of a queue family at host time hostNs
+  struct Calibration {
+    uint64_t ticks{0};
+    double hostNs{0.0};
+    bool valid{false};
+  };
+  // Per queue family
+  std::vector<Calibration> m_calibrations;
+
+  struct PendingScope {
+    std::string name;
+    uint32_t queueFamilyIndex;
+    vk::CommandBuffer commandBuffer;
+  };
+
+  mutable std::mutex m_mutex;
+  // Scopes own query pairs (2 * index, 2 * index + 1)
+  std::vector<uint32_t> m_freeScopes;
+  std::unordered_map<uint32_t, PendingScope> m_pending;
+  std::vector<Event> m_events;
+  std::unordered_map<std::thread::id, uint32_t> m_threadTracks;
+  uint64_t m_dropped{0};
+
+  GpuScope beginGpuScope(vk::CommandBuffer commandBuffer,
+                         std::string_view name, uint32_t queueFamilyIndex);
+  void endGpuScope(vk::CommandBuffer commandBuffer, uint32_t query);
+  void endCpuScope(std::string name,
+                   std::chrono::steady_clock::time_point start);
+  // Begin and end ticks of a scope, if the GPU has written both
+  [[nodiscard]] std::optional<std::pair<uint64_t, uint64_t>>
+  timestamps(uint32_t scope) const;
+
+  [[nodiscard]] double hostNs(std::chrono::steady_clock::time_point time) const {
+    return std::chrono::duration<double, std::nano>(time - m_epoch).count();
+  }
+};
+
+inline GpuScope::~GpuScope() {
+  if (m_profiler) {
+    m_profiler->endGpuScope(m_commandBuffer, m_query);
+  }
+}
+
+inline CpuScope::~CpuScope() {
+  if (m_profiler) {
+    m_profiler->endCpuScope(std::move(m_name), m_start);
+  }
+}
+
+} // namespace vcm
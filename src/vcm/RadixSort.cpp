@@ -0,0 +1,172 @@
+#include "RadixSort.hpp"
+#include "VulkanComputeManager.hpp"
+#include <array>
+#include <fmt/format.h>
+#include <span>
+#include <stdexcept>
+
+namespace vcm {
+
+namespace {
+
+// Push constant blocks of the shaders
+struct HistogramPushConstants {
+  uint32_t count;
+  uint32_t firstTile;
+  uint32_t tileCount;
+  uint32_t shift;
+};
+
+struct ScatterPushConstants {
+  uint32_t count;
+  uint32_t firstTile;
+  uint32_t tileCount;
+  uint32_t shift;
+  uint32_t hasValues;
+};
+
+} // namespace
+
+RadixSort::RadixSort(VulkanComputeManager &manager)
+    : m_manager(manager), m_primitives(manager) {
+  const auto subgroup =
+      m_manager.get_physicalDevice()
+          .getProperties2<vk::PhysicalDeviceProperties2,
+                          vk::PhysicalDeviceSubgroupProperties>()
+          .get<vk::PhysicalDeviceSubgroupProperties>();
+  if (!(subgroup.supportedOperations & vk::SubgroupFeatureFlagBits::eBallot) ||
+      subgroup.subgroupSize < MIN_SUBGROUP_SIZE) {
+    throw std::runtime_error(fmt::format(
+        "Radix sort needs subgroup ballot and subgroups of at least {} "
+        "lanes, the device has {}.",
+        MIN_SUBGROUP_SIZE, subgroup.subgroupSize));
+  }
+
+  m_histogram = Primitives::loadKernel(
+      m_manager, "shaders/sort_histogram.spv", "sort histogram");
+  m_scatter = Primitives::loadKernel(m_manager, "shaders/sort_scatter.spv",
+                                     "sort scatter");
+}
+
+void RadixSort::recordSort(vk::CommandBuffer commandBuffer,
+                           const vk::DescriptorBufferInfo &keys,
+                           uint32_t count, uint32_t keyBits) {
+  record(commandBuffer, keys, nullptr, count, keyBits);
+}
+
+void RadixSort::recordSort(vk::CommandBuffer commandBuffer,
+                           const vk::DescriptorBufferInfo &keys,
+                           const vk::DescriptorBufferInfo &values,
+                           uint32_t count, uint32_t keyBits) {
+  record(commandBuffer, keys, &values, count, keyBits);
+}
+
+void RadixSort::record(vk::CommandBuffer commandBuffer,
+                       const vk::DescriptorBufferInfo &keys,
+                       const vk::DescriptorBufferInfo *values, uint32_t count,
+                       uint32_t keyBits) {
+  if (keyBits == 0 || keyBits > 32) {
+    throw std::runtime_error(
+        fmt::format("Radix sort keys have 1 to 32 bits, not {}.", keyBits));
+  }
+  if (count > maxKeys()) {
+    throw std::runtime_error(fmt::format(
+        "Radix sort binds at most {} keys (maxStorageBufferRange), got {}.",
+        maxKeys(), count));
+  }
+  if (count <= 1) {
+    return;
+  }
+
+  // Whole bytes, so an even number of passes
+  const auto passes = (keyBits + 7) / 8 * (8 / RADIX_BITS);
+  const auto tiles = (count + TILE_SIZE - 1) / TILE_SIZE;
+  const auto histogramSize = tiles * RADIX;
+
+  const auto usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  if (m_keys.size() < count) {
+    m_keys = m_manager.createBuffer<uint32_t>(count, usage, HostAccess::None,
+                                              "radix sort");
+  }
+  if (values != nullptr && m_values.size() < count) {
+    m_values = m_manager.createBuffer<uint32_t>(
+        count, usage, HostAccess::None, "radix sort");
+  }
+  if (m_histograms.size() < histogramSize) {
+    m_histograms = m_manager.createBuffer<uint32_t>(
+        histogramSize, usage, HostAccess::None, "radix sort");
+    m_offsets = m_manager.createBuffer<uint32_t>(
+        histogramSize, usage, HostAccess::None, "radix sort");
+  }
+
+  // Pass i reads [i % 2] and writes the other. Without values, the keys are
+  // bound in their place and not written.
+  const std::array keyBuffers{keys, m_keys.descriptor(0, count)};
+  const auto valueBuffers =
+      values != nullptr
+          ? std::array{*values, m_values.descriptor(0, count)}
+          : keyBuffers;
+  const auto histograms = m_histograms.descriptor(0, histogramSize);
+  const auto offsets = m_offsets.descriptor(0, histogramSize);
+
+  for (uint32_t pass = 0; pass < passes; ++pass) {
+    const auto src = pass % 2;
+    const auto dst = 1 - src;
+    const auto shift = pass * RADIX_BITS;
+
+    const std::array histogramBuffers{keyBuffers[src], histograms};
+    Primitives::dispatchTiles(
+        commandBuffer, *m_histogram,
+        m_histogram->bind(
+            std::span<const vk::DescriptorBufferInfo>(histogramBuffers)),
+        tiles, HistogramPushConstants{count, 0, tiles, shift});
+    memoryBarrierComputeThenCompute(commandBuffer);
+
+    m_primitives.recordScan(commandBuffer, histograms, offsets, histogramSize,
+                            false);
+    memoryBarrierComputeThenCompute(commandBuffer);
+
+    const std::array scatterBuffers{keyBuffers[src], valueBuffers[src],
+                                    offsets, keyBuffers[dst],
+                                    valueBuffers[dst]};
+    Primitives::dispatchTiles(
+        commandBuffer, *m_scatter,
+        m_scatter->bind(
+            std::span<const vk::DescriptorBufferInfo>(scatterBuffers)),
+        tiles,
+        ScatterPushConstants{count, 0, tiles, shift, values != nullptr});
+    if (pass + 1 < passes) {
+      memoryBarrierComputeThenCompute(commandBuffer);
+    }
+  }
+}
+
+void RadixSort::sort(Buffer<uint32_t> &keys, uint32_t keyBits) {
+  if (keys.size() > UINT32_MAX) {
+    throw std::runtime_error(
+        fmt::format("Radix sort takes at most {} keys, got {}.", UINT32_MAX,
+                    keys.size()));
+  }
+  auto commandBuffer = m_manager.beginOneTimeCommands();
+  recordSort(commandBuffer, keys.descriptor(),
+             static_cast<uint32_t>(keys.size()), keyBits);
+  memoryBarrierComputeThenHost(commandBuffer);
+  m_manager.submitOneTime(commandBuffer).wait();
+}
+
+void RadixSort::sort(Buffer<uint32_t> &keys, Buffer<uint32_t> &values,
+                     uint32_t keyBits) {
+  if (keys.size() > UINT32_MAX || values.size() < keys.size()) {
+    throw std::runtime_error(fmt::format(
+        "Radix sort takes at most {} keys and a value for each, got {} keys "
+        "and {} values.",
+        UINT32_MAX, keys.size(), values.size()));
+  }
+  auto commandBuffer = m_manager.beginOneTimeCommands();
+  recordSort(commandBuffer, keys.descriptor(), values.descriptor(),
+             static_cast<uint32_t>(keys.size()), keyBits);
+  memoryBarrierComputeThenHost(commandBuffer);
+  m_manager.submitOneTime(commandBuffer).wait();
+}
+
+} // namespace vcm
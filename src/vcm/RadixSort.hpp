@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "ComputeKernel.hpp"
+#include "Primitives.hpp"
+#include <cstdint>
+#include <memory>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+class VulkanComputeManager;
+
+/*
+Stable ascending LSD radix sort of uint32 keys, optionally carrying a uint32
+value per key, for data already in device buffers.
+
+Each pass sorts by one 4 bit digit in three steps: a histogram of the
+digits of every tile of TILE_SIZE keys, an exclusive scan of the histograms
+(Primitives::recordScan) giving each digit of each tile its first output
+position, and a scatter that ranks the keys of a tile with subgroup ballot
+counts. Passes ping-pong between the caller's buffers and temporary ones,
+always an even number so the result ends where the keys started.
+
+A single pass onesweep sort would need decoupled look-back, which relies on
+forward progress between workgroups that Vulkan does not guarantee.
+
+Keys, values and temporaries are bound whole, so at most maxKeys() keys are
+sorted, the elements of one maxStorageBufferRange.
+
+Temporary buffers are owned by the object and grown on demand; as with
+Primitives, work recorded from one RadixSort must complete before more is
+recorded. Not thread safe.
+*/
+class RadixSort {
+public:
+  // Must match the shaders
+  static constexpr uint32_t GROUP_SIZE = Primitives::GROUP_SIZE;
+  static constexpr uint32_t TILE_SIZE = Primitives::TILE_SIZE;
+  static constexpr uint32_t RADIX_BITS = 4;
+  static constexpr uint32_t RADIX = 1U << RADIX_BITS;
+  static constexpr uint32_t MIN_SUBGROUP_SIZE = 4;
+
+  // Throws if the device lacks the subgroup operations the shaders use
+  explicit RadixSort(VulkanComputeManager &manager);
+
+  RadixSort(const RadixSort &) = delete;
+  RadixSort(RadixSort &&) = delete;
+  RadixSort &operator=(const RadixSort &) = delete;
+  RadixSort &operator=(RadixSort &&) = delete;
+
+  [[nodiscard]] uint32_t maxKeys() const { return m_primitives.maxElements(); }
+
+  // Record sorting the first count keys in place. Only the low keyBits bits
+  // are sorted by, rounded up to a multiple of 8; keys known to be small
+  // take fewer passes.
+  void recordSort(vk::CommandBuffer commandBuffer,
+                  const vk::DescriptorBufferInfo &keys, uint32_t count,
+                  uint32_t keyBits = 32);
+  // The same, moving values[i] along with keys[i]
+  void recordSort(vk::CommandBuffer commandBuffer,
+                  const vk::DescriptorBufferInfo &keys,
+                  const vk::DescriptorBufferInfo &values, uint32_t count,
+                  uint32_t keyBits = 32);
+
+  // Sort and wait
+  void sort(Buffer<uint32_t> &keys, uint32_t keyBits = 32);
+  void sort(Buffer<uint32_t> &keys, Buffer<uint32_t> &values,
+            uint32_t keyBits = 32);
+
+private:
+  VulkanComputeManager &m_manager;
+  Primitives m_primitives;
+  std::unique_ptr<ComputeKernel> m_histogram;
+  std::unique_ptr<ComputeKernel> m_scatter;
+
+  Buffer<uint32_t> m_keys;
+  Buffer<uint32_t> m_values;
+  Buffer<uint32_t> m_histograms;
+  Buffer<uint32_t> m_offsets;
+
+  void record(vk::CommandBuffer commandBuffer,
+              const vk::DescriptorBufferInfo &keys,
+              const vk::DescriptorBufferInfo *values, uint32_t count,
+              uint32_t keyBits);
+};
+
+} // namespace vcm
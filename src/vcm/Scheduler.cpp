@@ -0,0 +1,130 @@
+#include "Scheduler.hpp"
+#include "StagingEngine.hpp"
+#include <algorithm>
+#include <exception>
+#include <fmt/format.h>
+#include <vector>
+
+namespace vcm {
+
+namespace {
+
+// Timed runs per measurement, the fastest counts, after one untimed run
+constexpr int RUNS = 3;
+
+template <typename Run> double bestSeconds(Run &&run) {
+  return fastestOf(RUNS, [&] { return secondsOf(run); });
+}
+
+} // namespace
+
+Scheduler::Scheduler() {
+  try {
+    m_ownedManager = std::make_unique<VulkanComputeManager>();
+    m_manager = m_ownedManager.get();
+  } catch (const std::exception &e) {
+    fmt::println("No usable Vulkan device, running on the CPU: {}", e.what());
+  }
+  init();
+}
+
+Scheduler::Scheduler(VulkanComputeManager &manager) : m_manager(&manager) {
+  init();
+}
+
+// Device objects go before the manager they use
+Scheduler::~Scheduler() {
+  m_primitives.reset();
+  m_elementwise.reset();
+}
+
+void Scheduler::init() {
+  m_cpu = std::make_unique<CpuBackend>();
+  if (m_manager == nullptr) {
+    return;
+  }
+  m_elementwise = std::make_unique<ElementwiseRunner>(*m_manager);
+  try {
+    m_primitives = std::make_unique<Primitives>(*m_manager);
+  } catch (const std::exception &e) {
+    fmt::println("Reductions run on the CPU: {}", e.what());
+  }
+  calibrate();
+}
+
+void Scheduler::calibrate() {
+  constexpr auto elements = CALIBRATION_ELEMENTS;
+  constexpr auto bytes = elements * sizeof(float);
+  CostModel model;
+
+  std::vector<float> host(elements, 1.0F);
+  std::vector<float> hostOut(elements);
+  const auto cpuSeconds =
+      bestSeconds([&] { m_cpu->square<float>(host, hostOut); });
+  model.cpuRate = 2.0 * bytes / cpuSeconds;
+  model.cpuLatency = bestSeconds([&] {
+    m_cpu->forChunks(CpuBackend::GRAIN * m_cpu->threadCount(),
+                     [](size_t, size_t) {});
+  });
+
+  if (m_manager != nullptr) {
+    auto &manager = *m_manager;
+    model.gpuLatency = bestSeconds([&] {
+      manager.submitOneTime(manager.beginOneTimeCommands()).wait();
+    });
+
+    const auto usage = vk::BufferUsageFlagBits::eStorageBuffer |
+                       vk::BufferUsageFlagBits::eTransferSrc |
+                       vk::BufferUsageFlagBits::eTransferDst;
+    auto in = manager.createBuffer<float>(elements, usage, HostAccess::None,
+                                          "calibration");
+    auto out = manager.createBuffer<float>(elements, usage, HostAccess::None,
+                                           "calibration");
+    auto &staging = m_elementwise->staging();
+    const auto transferSeconds = bestSeconds([&] {
+      staging.upload(std::as_bytes(std::span(host)), in.buffer());
+      staging.download(in.buffer(), 0,
+                       std::as_writable_bytes(std::span(hostOut)));
+    });
+    model.transferRate = 2.0 * bytes / transferSeconds;
+
+    auto &kernel =
+        getTypedKernel(manager, ElementwiseOp::Square, "float", true);
+    const std::array buffers{in.paddedDescriptor(), out.paddedDescriptor()};
+    const auto units = static_cast<uint32_t>((elements + 3) / 4);
+    const auto gpuSeconds = bestSeconds([&] {
+      auto commandBuffer = manager.beginOneTimeCommands();
+      kernel.dispatchElements(commandBuffer, buffers, units);
+      manager.submitOneTime(commandBuffer).wait();
+    });
+    model.gpuRate =
+        2.0 * bytes / std::max(gpuSeconds - model.gpuLatency, 1e-9);
+  }
+
+  m_costModel = model;
+  fmt::println("Cost model: GPU {:.1f} us + {:.2f} GB/s transfer, {:.2f} "
+               "GB/s compute; CPU {:.1f} us + {:.2f} GB/s",
+               model.gpuLatency * 1e6, model.transferRate * 1e-9,
+               model.gpuRate * 1e-9, model.cpuLatency * 1e6,
+               model.cpuRate * 1e-9);
+}
+
+Backend Scheduler::choose(uint64_t bytes) const {
+  if (m_manager == nullptr || m_manager->get_memoryTracker().overSoftLimit()) {
+    return Backend::Cpu;
+  }
+  const auto size = static_cast<double>(bytes);
+  return m_costModel.gpuSeconds(size) < m_costModel.cpuSeconds(size)
+             ? Backend::Gpu
+             : Backend::Cpu;
+}
+
+ReduceResult Scheduler::reduce(ReduceOp op, std::span<const uint32_t> input) {
+  if (m_primitives && run(input.size_bytes()) == Backend::Gpu) {
+    return m_primitives->reduce(op, input);
+  }
+  m_lastBackend = Backend::Cpu;
+  return m_cpu->reduce(op, input);
+}
+
+} // namespace vcm
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "CpuBackend.hpp"
+#include "Primitives.hpp"
+#include "TypedElementwise.hpp"
+#include "VulkanComputeManager.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace vcm {
+
+enum class Backend { Cpu, Gpu };
+
+/*
+Predicted seconds for an operation over host arrays, linear in the bytes of
+host memory it reads and writes.
+
+On the GPU those bytes are staged to and from the device and read and
+written again by the kernel, after the fixed cost of a blocking submission.
+On the CPU they are read and written once, after the fixed cost of handing
+chunks to the worker threads.
+*/
+struct CostModel {
+  // Seconds
+  double gpuLatency{};
+  // Bytes/s through the staging engine, both directions
+  double transferRate{1.0};
+  // Bytes/s of device memory traffic of an element-wise kernel
+  double gpuRate{1.0};
+  // Seconds
+  double cpuLatency{};
+  // Bytes/s of host memory traffic of an element-wise loop
+  double cpuRate{1.0};
+
+  [[nodiscard]] double gpuSeconds(double bytes) const {
+    return gpuLatency + bytes / transferRate + bytes / gpuRate;
+  }
+  [[nodiscard]] double cpuSeconds(double bytes) const {
+    return cpuLatency + bytes / cpuRate;
+  }
+};
+
+/*
+Runs each call on the CPU (CpuBackend) or the GPU, whichever the cost model
+predicts to finish first: small arrays, where submitting and waiting
+dominates, stay on the CPU.
+
+The model is calibrated at construction by timing an empty submission,
+staging transfers and the float square kernel on the device, and the square
+loop on the CPU. GPU calls reuse one staging engine and set of device
+buffers, as calibrated, rather than paying for their creation each time.
+Without a usable Vulkan device, or while its memory is over the
+MemoryTracker's soft limit, every call runs on the CPU.
+
+Not thread safe.
+*/
+class Scheduler {
+public:
+  // Creates its own manager, or runs on the CPU only if that fails
+  Scheduler();
+  explicit Scheduler(VulkanComputeManager &manager);
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler(Scheduler &&) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+  Scheduler &operator=(Scheduler &&) = delete;
+
+  ~Scheduler();
+
+  [[nodiscard]] bool hasGpu() const { return m_manager != nullptr; }
+  // Null without a GPU
+  [[nodiscard]] VulkanComputeManager *manager() const { return m_manager; }
+  [[nodiscard]] CpuBackend &cpu() const { return *m_cpu; }
+
+  [[nodiscard]] const CostModel &costModel() const { return m_costModel; }
+  void setCostModel(const CostModel &costModel) { m_costModel = costModel; }
+  // Measure the cost model's constants. Blocks for a moment.
+  void calibrate();
+
+  // Backend for an operation reading and writing bytes of host memory
+  [[nodiscard]] Backend choose(uint64_t bytes) const;
+  // Backend the last operation ran on
+  [[nodiscard]] Backend lastBackend() const { return m_lastBackend; }
+
+  // out = a + b
+  template <ShaderElement T>
+  void add(std::span<const T> a, std::span<const T> b, std::span<T> out) {
+    if (run(3 * a.size() * sizeof(T)) == Backend::Cpu) {
+      m_cpu->add(a, b, out);
+      return;
+    }
+    const std::array inputs{std::as_bytes(a), std::as_bytes(b)};
+    m_elementwise->run(ElementwiseOp::Add, shaderElementType<T>, sizeof(T),
+                       inputs, std::as_writable_bytes(out), a.size());
+  }
+
+  // out = in * in
+  template <ShaderElement T>
+  void square(std::span<const T> in, std::span<T> out) {
+    if (run(2 * in.size() * sizeof(T)) == Backend::Cpu) {
+      m_cpu->square(in, out);
+      return;
+    }
+    const std::array inputs{std::as_bytes(in)};
+    m_elementwise->run(ElementwiseOp::Square, shaderElementType<T>, sizeof(T),
+                       inputs, std::as_writable_bytes(out), in.size());
+  }
+
+  ReduceResult reduce(ReduceOp op, std::span<const uint32_t> input);
+  uint32_t sum(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Sum, input).value;
+  }
+  uint32_t min(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Min, input).value;
+  }
+  uint32_t max(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::Max, input).value;
+  }
+  uint32_t argMin(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::ArgMin, input).index;
+  }
+  uint32_t argMax(std::span<const uint32_t> input) {
+    return reduce(ReduceOp::ArgMax, input).index;
+  }
+
+  // Elements of the calibration runs
+  static constexpr uint64_t CALIBRATION_ELEMENTS = 1 << 22;
+
+private:
+  std::unique_ptr<VulkanComputeManager> m_ownedManager;
+  VulkanComputeManager *m_manager{};
+  std::unique_ptr<CpuBackend> m_cpu;
+  // Null without a GPU
+  std::unique_ptr<ElementwiseRunner> m_elementwise;
+  // Null if the device cannot run them
+  std::unique_ptr<Primitives> m_primitives;
+
+  CostModel m_costModel;
+  Backend m_lastBackend{Backend::Cpu};
+
+  void init();
+  // choose() and record the choice
+  Backend run(uint64_t bytes) {
+    m_lastBackend = choose(bytes);
+    return m_lastBackend;
+  }
+};
+
+} // namespace vcm
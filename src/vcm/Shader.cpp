@@ -1,29 +1,128 @@
 #include "Shader.hpp"
+#include "Common.hpp"
+#include <algorithm>
 #include <fmt/format.h>
 #include <fstream>
+#include <map>
 
 namespace vcm {
 
-auto loadShader(vk::Device device, const char *shaderFileName)
-    -> vk::ShaderModule {
+namespace {
 
-  // Load shader
-  std::vector<char> shaderContents;
+struct EmbeddedSpirv {
+  std::mutex mutex;
+  std::map<std::string, std::span<const uint32_t>, std::less<>> shaders;
+};
+
+// Function local so registrations from other translation units' static
+// initializers find it constructed
+EmbeddedSpirv &embeddedSpirv() {
+  static EmbeddedSpirv registry;
+  return registry;
+}
+
+} // namespace
+
+EmbeddedSpirvRegistration::EmbeddedSpirvRegistration(
+    std::initializer_list<
+        std::pair<std::string_view, std::span<const uint32_t>>>
+        shaders) {
+  auto &registry = embeddedSpirv();
+  std::scoped_lock lock(registry.mutex);
+  for (const auto &[name, spirv] : shaders) {
+    registry.shaders.insert_or_assign(std::string(name), spirv);
+  }
+}
+
+auto findEmbeddedSpirv(std::string_view name) -> std::span<const uint32_t> {
+  auto &registry = embeddedSpirv();
+  std::scoped_lock lock(registry.mutex);
+  // Both "shaders/x.spv" and "./shaders/x.spv" name the same shader
+  if (name.starts_with("./")) {
+    name.remove_prefix(2);
+  }
+  const auto it = registry.shaders.find(name);
+  return it != registry.shaders.end() ? it->second
+                                      : std::span<const uint32_t>{};
+}
+
+auto embeddedSpirvNames() -> std::vector<std::string> {
+  auto &registry = embeddedSpirv();
+  std::scoped_lock lock(registry.mutex);
+  std::vector<std::string> names;
+  names.reserve(registry.shaders.size());
+  for (const auto &[name, spirv] : registry.shaders) {
+    names.push_back(name);
+  }
+  return names;
+}
+
+auto readSpirv(const char *shaderFileName) -> std::vector<uint32_t> {
+  if (const auto embedded = findEmbeddedSpirv(shaderFileName);
+      !embedded.empty()) {
+    return {embedded.begin(), embedded.end()};
+  }
+
+  std::vector<uint32_t> shaderContents;
   if (std::ifstream shaderFile{shaderFileName,
                                std::ios::binary | std::ios::ate}) {
     const size_t fileSize = shaderFile.tellg();
+    if (fileSize % sizeof(uint32_t) != 0) {
+      throw std::runtime_error(fmt::format(
+          "Shader object file {} is not valid SPIR-V.", shaderFileName));
+    }
     shaderFile.seekg(0);
-    shaderContents.resize(fileSize, '\0');
-    shaderFile.read(shaderContents.data(), fileSize);
+    shaderContents.resize(fileSize / sizeof(uint32_t), 0);
+    shaderFile.read(reinterpret_cast<char *>(shaderContents.data()), // NOLINT
+                    static_cast<std::streamsize>(fileSize));
   } else {
     throw std::runtime_error(
         fmt::format("Shader object file {} not found.", shaderFileName));
   }
+  return shaderContents;
+}
+
+auto loadShader(vk::Device device, const char *shaderFileName)
+    -> vk::ShaderModule {
+  // Load shader
+  const auto shaderContents = readSpirv(shaderFileName);
+  return loadShader(device, shaderContents);
+}
 
+auto loadShader(vk::Device device, std::span<const uint32_t> code)
+    -> vk::ShaderModule {
   vk::ShaderModuleCreateInfo shaderModuleCreateInfo(
-      vk::ShaderModuleCreateFlags(), shaderContents.size(),
-      reinterpret_cast<const uint32_t *>(shaderContents.data())); // NOLINT
+      vk::ShaderModuleCreateFlags(), code.size_bytes(), code.data());
   return device.createShaderModule(shaderModuleCreateInfo);
 }
 
-} // namespace vcm
\ No newline at end of file
+ShaderModuleCache::~ShaderModuleCache() {
+  for (const auto &[key, entries] : m_modules) {
+    for (const auto &entry : entries) {
+      m_device.destroyShaderModule(entry.module);
+    }
+  }
+}
+
+vk::ShaderModule ShaderModuleCache::get(std::span<const uint32_t> spirv) {
+  const auto key = fnv1a(spirv.data(), spirv.size_bytes());
+  std::scoped_lock lock(m_mutex);
+  auto &entries = m_modules[key];
+  const auto hit = std::ranges::find_if(entries, [&](const Entry &entry) {
+    return std::ranges::equal(entry.code, spirv);
+  });
+  if (hit != entries.end()) {
+    return hit->module;
+  }
+  const auto module = loadShader(m_device, spirv);
+  entries.push_back({{spirv.begin(), spirv.end()}, module});
+  ++m_count;
+  return module;
+}
+
+size_t ShaderModuleCache::size() const {
+  std::scoped_lock lock(m_mutex);
+  return m_count;
+}
+
+} // namespace vcm
@@ -1,11 +1,78 @@
 #pragma once
 
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 namespace vcm {
 
+// Read a compiled spv shader object: the SPIR-V embedded in the binary
+// under that name if there is one, the file otherwise
+auto readSpirv(const char *shaderFileName) -> std::vector<uint32_t>;
+
 // Load a compiled spv shader object
 auto loadShader(vk::Device device, const char *shaderFileName)
     -> vk::ShaderModule;
 
-} // namespace vcm
\ No newline at end of file
+// Create a shader module from SPIR-V code
+auto loadShader(vk::Device device, std::span<const uint32_t> code)
+    -> vk::ShaderModule;
+
+// SPIR-V compiled into the binary by vcm_add_hlsl_shaders, by the path it is
+// also written to, e.g. "shaders/square.spv". Empty if there is none.
+auto findEmbeddedSpirv(std::string_view name) -> std::span<const uint32_t>;
+
+// Names of all embedded shaders
+auto embeddedSpirvNames() -> std::vector<std::string>;
+
+// Registers a generated source's shaders during static initialization. The
+// SPIR-V must stay valid for the program's lifetime.
+struct EmbeddedSpirvRegistration {
+  EmbeddedSpirvRegistration(
+      std::initializer_list<
+          std::pair<std::string_view, std::span<const uint32_t>>>
+          shaders);
+};
+
+/*
+Shader modules by SPIR-V content, so each module is created once per device
+however many kernels and pipelines use it. Modules live until the cache is
+destroyed, which must be after every pipeline creation using them. Thread
+safe.
+*/
+class ShaderModuleCache {
+public:
+  explicit ShaderModuleCache(vk::Device device) : m_device(device) {}
+
+  ShaderModuleCache(const ShaderModuleCache &) = delete;
+  ShaderModuleCache(ShaderModuleCache &&) = delete;
+  ShaderModuleCache &operator=(const ShaderModuleCache &) = delete;
+  ShaderModuleCache &operator=(ShaderModuleCache &&) = delete;
+
+  ~ShaderModuleCache();
+
+  vk::ShaderModule get(std::span<const uint32_t> spirv);
+
+  [[nodiscard]] size_t size() const;
+
+private:
+  // The code is kept so a hash collision can't hand back another module
+  struct Entry {
+    std::vector<uint32_t> code;
+    vk::ShaderModule module;
+  };
+
+  vk::Device m_device;
+  mutable std::mutex m_mutex;
+  std::unordered_map<uint64_t, std::vector<Entry>> m_modules;
+  size_t m_count = 0;
+};
+
+} // namespace vcm
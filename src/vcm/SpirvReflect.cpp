@@ -0,0 +1,554 @@
+#include "SpirvReflect.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fmt/format.h>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace vcm {
+
+namespace {
+
+// Subset of the SPIR-V spec enums used here
+// https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html
+namespace spv {
+constexpr uint32_t MagicNumber = 0x07230203;
+constexpr uint32_t HeaderWords = 5;
+
+enum Op : uint16_t {
+  OpNop = 0,
+  OpSourceContinued = 2,
+  OpSource = 3,
+  OpSourceExtension = 4,
+  OpName = 5,
+  OpMemberName = 6,
+  OpString = 7,
+  OpLine = 8,
+  OpExtension = 10,
+  OpExtInstImport = 11,
+  OpMemoryModel = 14,
+  OpEntryPoint = 15,
+  OpExecutionMode = 16,
+  OpCapability = 17,
+  OpTypeBool = 20,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeMatrix = 24,
+  OpTypeImage = 25,
+  OpTypeSampler = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpSpecConstant = 50,
+  OpSpecConstantComposite = 51,
+  OpFunction = 54,
+  OpVariable = 59,
+  OpDecorate = 71,
+  OpMemberDecorate = 72,
+  OpNoLine = 317,
+  OpModuleProcessed = 330,
+  OpExecutionModeId = 331,
+};
+
+enum Decoration : uint32_t {
+  DecorationSpecId = 1,
+  DecorationBlock = 2,
+  DecorationBufferBlock = 3,
+  DecorationArrayStride = 6,
+  DecorationBuiltIn = 11,
+  DecorationNonWritable = 24,
+  DecorationNonReadable = 25,
+  DecorationBinding = 33,
+  DecorationDescriptorSet = 34,
+  DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+  StorageClassUniformConstant = 0,
+  StorageClassUniform = 2,
+  StorageClassPushConstant = 9,
+  StorageClassStorageBuffer = 12,
+};
+
+constexpr uint32_t BuiltInWorkgroupSize = 25;
+constexpr uint32_t ExecutionModelGLCompute = 5;
+constexpr uint32_t ExecutionModeLocalSize = 17;
+constexpr uint32_t DimBuffer = 5;
+} // namespace spv
+
+struct Instruction {
+  uint16_t opcode;
+  std::span<const uint32_t> operands;
+};
+
+struct Decorations {
+  std::optional<uint32_t> binding;
+  std::optional<uint32_t> set;
+  std::optional<uint32_t> arrayStride;
+  bool block{false};
+  bool bufferBlock{false};
+  bool nonWritable{false};
+  bool nonReadable{false};
+  // Struct members decorated NonWritable / NonReadable
+  uint32_t nonWritableMembers{0};
+  uint32_t nonReadableMembers{0};
+};
+
+struct Variable {
+  uint32_t id;
+  uint32_t pointerType;
+  uint32_t storageClass;
+};
+
+uint32_t instructionWord(uint16_t opcode, size_t wordCount) {
+  return static_cast<uint32_t>(wordCount << 16U) | opcode;
+}
+
+// Instructions allowed before the annotation section
+bool isPreamble(uint16_t opcode) {
+  switch (opcode) {
+  case spv::OpNop:
+  case spv::OpCapability:
+  case spv::OpExtension:
+  case spv::OpExtInstImport:
+  case spv::OpMemoryModel:
+  case spv::OpEntryPoint:
+  case spv::OpExecutionMode:
+  case spv::OpExecutionModeId:
+  case spv::OpSourceContinued:
+  case spv::OpSource:
+  case spv::OpSourceExtension:
+  case spv::OpName:
+  case spv::OpMemberName:
+  case spv::OpString:
+  case spv::OpLine:
+  case spv::OpNoLine:
+  case spv::OpModuleProcessed:
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::string readString(std::span<const uint32_t> words) {
+  const auto *chars = reinterpret_cast<const char *>(words.data()); // NOLINT
+  return {chars, strnlen(chars, words.size_bytes())};
+}
+
+class Reflector {
+public:
+  explicit Reflector(std::span<const uint32_t> code) {
+    if (code.size() < spv::HeaderWords || code[0] != spv::MagicNumber) {
+      throw std::runtime_error("Not a SPIR-V module");
+    }
+
+    size_t offset = spv::HeaderWords;
+    while (offset < code.size()) {
+      const uint32_t wordCount = code[offset] >> 16U;
+      const auto opcode = static_cast<uint16_t>(code[offset] & 0xFFFFU);
+      if (wordCount == 0 || offset + wordCount > code.size()) {
+        throw std::runtime_error("Malformed SPIR-V instruction stream");
+      }
+      parse({opcode, code.subspan(offset + 1, wordCount - 1)});
+      offset += wordCount;
+    }
+  }
+
+  ShaderReflection reflect(const char *entryPoint) const {
+    ShaderReflection reflection;
+
+    const auto entry = m_entryPoints.find(entryPoint);
+    if (entry == m_entryPoints.end()) {
+      throw std::runtime_error(
+          fmt::format("Entry point '{}' not found in SPIR-V", entryPoint));
+    }
+    if (const auto it = m_localSize.find(entry->second);
+        it != m_localSize.end()) {
+      reflection.localSize = it->second;
+    }
+
+    for (const auto &var : m_variables) {
+      const auto &pointer = type(var.pointerType);
+      const uint32_t pointee = pointer.operands[2];
+
+      if (var.storageClass == spv::StorageClassPushConstant) {
+        reflection.pushConstantSize =
+            std::max(reflection.pushConstantSize, sizeOf(pointee));
+        continue;
+      }
+
+      const auto deco = m_decorations.find(var.id);
+      if (deco == m_decorations.end() || !deco->second.binding.has_value()) {
+        continue;
+      }
+
+      ShaderReflection::Binding binding;
+      binding.set = deco->second.set.value_or(0);
+      binding.binding = deco->second.binding.value();
+      if (const auto name = m_names.find(var.id); name != m_names.end()) {
+        binding.name = name->second;
+      }
+
+      // Arrays of resources
+      uint32_t resourceType = pointee;
+      if (type(resourceType).opcode == spv::OpTypeArray) {
+        binding.count = constant(type(resourceType).operands[2]);
+        resourceType = type(resourceType).operands[1];
+      }
+      binding.type = descriptorType(var.storageClass, resourceType);
+      // DXC decorates the block's members, glslang the variable
+      const auto [readOnly, writeOnly] = access(var.id, resourceType);
+      binding.readOnly = readOnly;
+      binding.writeOnly = writeOnly;
+      binding.elementStride = runtimeArrayStride(resourceType);
+
+      reflection.bindings.push_back(std::move(binding));
+    }
+
+    std::ranges::sort(reflection.bindings, [](const auto &a, const auto &b) {
+      return std::tie(a.set, a.binding) < std::tie(b.set, b.binding);
+    });
+    return reflection;
+  }
+
+private:
+  std::unordered_map<std::string, uint32_t> m_entryPoints;
+  std::unordered_map<uint32_t, std::array<uint32_t, 3>> m_localSize;
+  std::unordered_map<uint32_t, std::string> m_names;
+  std::unordered_map<uint32_t, Decorations> m_decorations;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> m_memberOffsets;
+  std::unordered_map<uint32_t, Instruction> m_types;
+  std::unordered_map<uint32_t, uint32_t> m_constants;
+  std::vector<Variable> m_variables;
+
+  void parse(const Instruction &inst) {
+    const auto &ops = inst.operands;
+    switch (inst.opcode) {
+    case spv::OpName:
+      m_names[ops[0]] = readString(ops.subspan(1));
+      break;
+
+    case spv::OpEntryPoint:
+      if (ops[0] == spv::ExecutionModelGLCompute) {
+        m_entryPoints[readString(ops.subspan(2))] = ops[1];
+      }
+      break;
+
+    case spv::OpExecutionMode:
+      if (ops[1] == spv::ExecutionModeLocalSize && ops.size() >= 5) {
+        m_localSize[ops[0]] = {ops[2], ops[3], ops[4]};
+      }
+      break;
+
+    case spv::OpDecorate: {
+      auto &deco = m_decorations[ops[0]];
+      switch (ops[1]) {
+      case spv::DecorationBinding:
+        deco.binding = ops[2];
+        break;
+      case spv::DecorationDescriptorSet:
+        deco.set = ops[2];
+        break;
+      case spv::DecorationArrayStride:
+        deco.arrayStride = ops[2];
+        break;
+      case spv::DecorationBlock:
+        deco.block = true;
+        break;
+      case spv::DecorationBufferBlock:
+        deco.bufferBlock = true;
+        break;
+      case spv::DecorationNonWritable:
+        deco.nonWritable = true;
+        break;
+      case spv::DecorationNonReadable:
+        deco.nonReadable = true;
+        break;
+      default:
+        break;
+      }
+      break;
+    }
+
+    case spv::OpMemberDecorate:
+      if (ops[2] == spv::DecorationOffset) {
+        auto &offsets = m_memberOffsets[ops[0]];
+        offsets.resize(std::max<size_t>(offsets.size(), ops[1] + 1));
+        offsets[ops[1]] = ops[3];
+      } else if (ops[2] == spv::DecorationNonWritable) {
+        ++m_decorations[ops[0]].nonWritableMembers;
+      } else if (ops[2] == spv::DecorationNonReadable) {
+        ++m_decorations[ops[0]].nonReadableMembers;
+      }
+      break;
+
+    case spv::OpTypeBool:
+    case spv::OpTypeInt:
+    case spv::OpTypeFloat:
+    case spv::OpTypeVector:
+    case spv::OpTypeMatrix:
+    case spv::OpTypeImage:
+    case spv::OpTypeSampler:
+    case spv::OpTypeSampledImage:
+    case spv::OpTypeArray:
+    case spv::OpTypeRuntimeArray:
+    case spv::OpTypeStruct:
+    case spv::OpTypePointer:
+      m_types[ops[0]] = inst;
+      break;
+
+    case spv::OpConstant:
+    case spv::OpSpecConstant:
+      m_constants[ops[1]] = ops[2];
+      break;
+
+    case spv::OpVariable:
+      m_variables.push_back({ops[1], ops[0], ops[2]});
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  [[nodiscard]] const Instruction &type(uint32_t id) const {
+    const auto it = m_types.find(id);
+    if (it == m_types.end()) {
+      throw std::runtime_error(fmt::format("SPIR-V type %{} not found", id));
+    }
+    return it->second;
+  }
+
+  [[nodiscard]] uint32_t constant(uint32_t id) const {
+    const auto it = m_constants.find(id);
+    if (it == m_constants.end()) {
+      throw std::runtime_error(
+          fmt::format("SPIR-V constant %{} not found", id));
+    }
+    return it->second;
+  }
+
+  [[nodiscard]] bool hasDecoration(uint32_t id,
+                                   bool Decorations::*decoration) const {
+    const auto it = m_decorations.find(id);
+    return it != m_decorations.end() && it->second.*decoration;
+  }
+
+  // (read only, write only) of a resource variable
+  [[nodiscard]] std::pair<bool, bool> access(uint32_t varId,
+                                             uint32_t typeId) const {
+    bool readOnly = hasDecoration(varId, &Decorations::nonWritable);
+    bool writeOnly = hasDecoration(varId, &Decorations::nonReadable);
+
+    const auto &t = type(typeId);
+    const auto deco = m_decorations.find(typeId);
+    if (t.opcode == spv::OpTypeStruct && t.operands.size() > 1 &&
+        deco != m_decorations.end()) {
+      const auto members = static_cast<uint32_t>(t.operands.size() - 1);
+      readOnly |= deco->second.nonWritableMembers == members;
+      writeOnly |= deco->second.nonReadableMembers == members;
+    }
+    return {readOnly, writeOnly};
+  }
+
+  // ArrayStride of the runtime array ending a block, 0 if there is none
+  [[nodiscard]] uint32_t runtimeArrayStride(uint32_t typeId) const {
+    const auto &t = type(typeId);
+    if (t.opcode != spv::OpTypeStruct || t.operands.size() < 2) {
+      return 0;
+    }
+    const uint32_t last = t.operands.back();
+    const auto deco = m_decorations.find(last);
+    if (type(last).opcode != spv::OpTypeRuntimeArray ||
+        deco == m_decorations.end()) {
+      return 0;
+    }
+    return deco->second.arrayStride.value_or(0);
+  }
+
+  // Size in bytes of a type laid out with explicit offsets/strides
+  [[nodiscard]] uint32_t sizeOf(uint32_t id) const {
+    const auto &t = type(id);
+    const auto &ops = t.operands;
+    switch (t.opcode) {
+    case spv::OpTypeBool:
+      return 4;
+    case spv::OpTypeInt:
+    case spv::OpTypeFloat:
+      return ops[1] / 8;
+    case spv::OpTypeVector:
+    case spv::OpTypeMatrix:
+      return sizeOf(ops[1]) * ops[2];
+    case spv::OpTypeArray: {
+      const auto deco = m_decorations.find(id);
+      const uint32_t stride =
+          deco != m_decorations.end() && deco->second.arrayStride.has_value()
+              ? deco->second.arrayStride.value()
+              : sizeOf(ops[1]);
+      return stride * constant(ops[2]);
+    }
+    case spv::OpTypeStruct: {
+      const auto offsets = m_memberOffsets.find(id);
+      uint32_t size = 0;
+      uint32_t packed = 0;
+      for (size_t i = 1; i < ops.size(); ++i) {
+        const uint32_t memberOffset =
+            offsets != m_memberOffsets.end() && i - 1 < offsets->second.size()
+                ? offsets->second[i - 1]
+                : packed;
+        packed = memberOffset + sizeOf(ops[i]);
+        size = std::max(size, packed);
+      }
+      return size;
+    }
+    default:
+      return 0;
+    }
+  }
+
+  [[nodiscard]] vk::DescriptorType descriptorType(uint32_t storageClass,
+                                                  uint32_t typeId) const {
+    const auto &t = type(typeId);
+
+    switch (storageClass) {
+    case spv::StorageClassStorageBuffer:
+      return vk::DescriptorType::eStorageBuffer;
+
+    case spv::StorageClassUniform:
+      // Before SPIR-V 1.3 storage buffers are Uniform + BufferBlock
+      return hasDecoration(typeId, &Decorations::bufferBlock)
+                 ? vk::DescriptorType::eStorageBuffer
+                 : vk::DescriptorType::eUniformBuffer;
+
+    case spv::StorageClassUniformConstant:
+      if (t.opcode == spv::OpTypeSampler) {
+        return vk::DescriptorType::eSampler;
+      }
+      if (t.opcode == spv::OpTypeSampledImage) {
+        return vk::DescriptorType::eCombinedImageSampler;
+      }
+      if (t.opcode == spv::OpTypeImage) {
+        // OpTypeImage: result, sampled type, dim, depth, arrayed, ms, sampled
+        const bool storage = t.operands[6] == 2;
+        if (t.operands[2] == spv::DimBuffer) {
+          return storage ? vk::DescriptorType::eStorageTexelBuffer
+                         : vk::DescriptorType::eUniformTexelBuffer;
+        }
+        return storage ? vk::DescriptorType::eStorageImage
+                       : vk::DescriptorType::eSampledImage;
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    throw std::runtime_error(fmt::format(
+        "Unsupported SPIR-V resource (storage class {})", storageClass));
+  }
+};
+
+} // namespace
+
+auto reflectSpirv(std::span<const uint32_t> code, const char *entryPoint)
+    -> ShaderReflection {
+  return Reflector(code).reflect(entryPoint);
+}
+
+auto makeWorkgroupSizeSpecializable(std::span<const uint32_t> code,
+                                    const char *entryPoint)
+    -> std::optional<std::vector<uint32_t>> {
+  const auto localSize = reflectSpirv(code, entryPoint).localSize;
+
+  // Find what can be reused and where the new instructions go
+  std::optional<uint32_t> uintType;
+  std::optional<uint32_t> uint3Type;
+  size_t annotationsAt = 0;
+  size_t functionsAt = code.size();
+  for (size_t offset = spv::HeaderWords; offset < code.size();) {
+    const uint32_t wordCount = code[offset] >> 16U;
+    const auto opcode = static_cast<uint16_t>(code[offset] & 0xFFFFU);
+    const auto ops = code.subspan(offset + 1, wordCount - 1);
+
+    if (annotationsAt == 0 && !isPreamble(opcode)) {
+      annotationsAt = offset;
+    }
+    if (opcode == spv::OpDecorate && ops[1] == spv::DecorationBuiltIn &&
+        ops[2] == spv::BuiltInWorkgroupSize) {
+      return std::nullopt;
+    }
+    if (opcode == spv::OpTypeInt && ops[1] == 32 && ops[2] == 0) {
+      uintType = ops[0];
+    }
+    if (opcode == spv::OpTypeVector && uintType && ops[1] == *uintType &&
+        ops[2] == 3) {
+      uint3Type = ops[0];
+    }
+    if (opcode == spv::OpFunction) {
+      functionsAt = offset;
+      break;
+    }
+    offset += wordCount;
+  }
+
+  uint32_t bound = code[3];
+  std::vector<uint32_t> decorations;
+  std::vector<uint32_t> constants;
+
+  // Non-aggregate types must be unique, so only declare missing ones
+  if (!uintType) {
+    uintType = bound++;
+    constants.insert(constants.end(),
+                     {instructionWord(spv::OpTypeInt, 4), *uintType, 32, 0});
+  }
+  if (!uint3Type) {
+    uint3Type = bound++;
+    constants.insert(constants.end(), {instructionWord(spv::OpTypeVector, 4),
+                                       *uint3Type, *uintType, 3});
+  }
+
+  std::array<uint32_t, 3> components{};
+  for (size_t i = 0; i < 3; ++i) {
+    components[i] = bound++;
+    constants.insert(constants.end(),
+                     {instructionWord(spv::OpSpecConstant, 4), *uintType,
+                      components[i], localSize[i]});
+    decorations.insert(decorations.end(),
+                       {instructionWord(spv::OpDecorate, 4), components[i],
+                        spv::DecorationSpecId, WORKGROUP_SIZE_SPEC_IDS[i]});
+  }
+
+  const uint32_t workgroupSize = bound++;
+  constants.insert(constants.end(),
+                   {instructionWord(spv::OpSpecConstantComposite, 6),
+                    *uint3Type, workgroupSize, components[0], components[1],
+                    components[2]});
+  decorations.insert(decorations.end(),
+                     {instructionWord(spv::OpDecorate, 4), workgroupSize,
+                      spv::DecorationBuiltIn, spv::BuiltInWorkgroupSize});
+
+  std::vector<uint32_t> patched;
+  patched.reserve(code.size() + decorations.size() + constants.size());
+  patched.insert(patched.end(), code.begin(),
+                 code.begin() + static_cast<ptrdiff_t>(annotationsAt));
+  patched[3] = bound;
+  patched.insert(patched.end(), decorations.begin(), decorations.end());
+  patched.insert(patched.end(),
+                 code.begin() + static_cast<ptrdiff_t>(annotationsAt),
+                 code.begin() + static_cast<ptrdiff_t>(functionsAt));
+  patched.insert(patched.end(), constants.begin(), constants.end());
+  patched.insert(patched.end(),
+                 code.begin() + static_cast<ptrdiff_t>(functionsAt),
+                 code.end());
+  return patched;
+}
+
+} // namespace vcm
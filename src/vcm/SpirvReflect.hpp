@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+/*
+Minimal SPIR-V reflection for compute shaders.
+
+Walks the module once and pulls out what is needed to build descriptor set
+and pipeline layouts: resource bindings, the push constant block size and
+the workgroup size of the entry point.
+*/
+struct ShaderReflection {
+  struct Binding {
+    uint32_t set{};
+    uint32_t binding{};
+    vk::DescriptorType type{};
+    uint32_t count{1};
+    std::string name;
+    // NonWritable / NonReadable, e.g. HLSL StructuredBuffer is read only
+    bool readOnly{false};
+    bool writeOnly{false};
+    // Storage buffers ending in a runtime array (HLSL StructuredBuffer): its
+    // ArrayStride, the size of one element. 0 otherwise.
+    uint32_t elementStride{0};
+  };
+
+  // Sorted by (set, binding)
+  std::vector<Binding> bindings;
+
+  // Size in bytes of the push constant block, 0 if there is none
+  uint32_t pushConstantSize{};
+
+  // [numthreads(x, y, z)] of the entry point
+  std::array<uint32_t, 3> localSize{1, 1, 1};
+};
+
+// Reflect the given entry point of a SPIR-V module.
+// Throws std::runtime_error on malformed input.
+auto reflectSpirv(std::span<const uint32_t> code,
+                  const char *entryPoint = "Main") -> ShaderReflection;
+
+// Specialization constant ids of the workgroup size (x, y, z) in modules
+// rewritten by makeWorkgroupSizeSpecializable
+constexpr std::array<uint32_t, 3> WORKGROUP_SIZE_SPEC_IDS{1000, 1001, 1002};
+
+// Rewrite a compute module so its workgroup size comes from specialization
+// constants WORKGROUP_SIZE_SPEC_IDS, defaulting to the entry point's
+// [numthreads]. HLSL only allows literal numthreads, so this adds what
+// glslang emits for local_size_x_id: a WorkgroupSize built-in decorated
+// OpSpecConstantComposite, which takes precedence over LocalSize.
+// Returns nullopt if the module already declares a WorkgroupSize built-in.
+auto makeWorkgroupSizeSpecializable(std::span<const uint32_t> code,
+                                    const char *entryPoint = "Main")
+    -> std::optional<std::vector<uint32_t>>;
+
+} // namespace vcm
@@ -0,0 +1,341 @@
+#include "StagingEngine.hpp"
+#include "Common.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vcm {
+
+namespace {
+
+constexpr auto COMPUTE_STAGES = vk::PipelineStageFlagBits::eComputeShader |
+                                vk::PipelineStageFlagBits::eTransfer;
+constexpr auto COMPUTE_ACCESS =
+    vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite |
+    vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+
+} // namespace
+
+StagingEngine::StagingEngine(const VulkanComputeManager &manager,
+                             vk::DeviceSize chunkSize, uint32_t slotCount)
+    : m_device(manager.get_device()), m_allocator(manager.get_allocator()),
+      m_memory(manager.get_memoryTracker()),
+      m_transferQueue(manager.get_transferQueue()),
+      m_computeQueue(manager.get_computeQueue()),
+      m_profiler(manager.get_profiler()),
+      m_singleQueue(&m_transferQueue == &m_computeQueue),
+      m_crossFamily(m_transferQueue.familyIndex() !=
+                    m_computeQueue.familyIndex()),
+      m_chunkSize(chunkSize), m_slots(slotCount) {
+
+  if (chunkSize == 0 || slotCount == 0) {
+    throw std::invalid_argument("StagingEngine needs chunkSize, slotCount > 0");
+  }
+
+  vk::CommandPoolCreateInfo poolInfo{};
+  poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer |
+                   vk::CommandPoolCreateFlagBits::eTransient;
+  poolInfo.queueFamilyIndex = m_transferQueue.familyIndex();
+  m_transferCommandPool = m_device.createCommandPool(poolInfo);
+  poolInfo.queueFamilyIndex = m_computeQueue.familyIndex();
+  m_computeCommandPool = m_device.createCommandPool(poolInfo);
+
+  const auto transferCommandBuffers = m_device.allocateCommandBuffers(
+      {m_transferCommandPool, vk::CommandBufferLevel::ePrimary, 2 * slotCount});
+  const auto computeCommandBuffers = m_device.allocateCommandBuffers(
+      {m_computeCommandPool, vk::CommandBufferLevel::ePrimary, 2 * slotCount});
+
+  // Host visible, persistently mapped. HOST_ACCESS_RANDOM lets VMA pick cached
+  // memory, which keeps readback fast; it may not be coherent, hence the
+  // explicit flush/invalidate around each memcpy.
+  vk::BufferCreateInfo bufCreateInfo{vk::BufferCreateFlags(), chunkSize,
+                                     vk::BufferUsageFlagBits::eTransferSrc |
+                                         vk::BufferUsageFlagBits::eTransferDst,
+                                     vk::SharingMode::eExclusive};
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                    VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+  for (size_t i = 0; i < m_slots.size(); ++i) {
+    auto &slot = m_slots[i];
+    VmaAllocationInfo info{};
+    if (vmaCreateBuffer(m_allocator, toVk(&bufCreateInfo), &allocInfo,
+                        &slot.buffer, &slot.allocation,
+                        &info) != VK_SUCCESS) {
+      // The destructor does not run, release what was created so far
+      for (size_t j = 0; j < i; ++j) {
+        vmaDestroyBuffer(m_allocator, m_slots[j].buffer,
+                         m_slots[j].allocation);
+        m_memory.untrack(m_slots[j].allocation);
+      }
+      m_device.destroyCommandPool(m_computeCommandPool);
+      m_device.destroyCommandPool(m_transferCommandPool);
+      throw std::runtime_error("Failed to allocate staging buffer");
+    }
+    m_memory.track(slot.allocation, "staging");
+    slot.mapped = static_cast<std::byte *>(info.pMappedData);
+    slot.transferCommandBuffers = {transferCommandBuffers[2 * i],
+                                   transferCommandBuffers[2 * i + 1]};
+    slot.computeCommandBuffers = {computeCommandBuffers[2 * i],
+                                  computeCommandBuffers[2 * i + 1]};
+  }
+}
+
+StagingEngine::~StagingEngine() {
+  try {
+    finish();
+  } catch (const std::exception &) { // NOLINT(*-empty-catch)
+    // Device lost, nothing left to wait for
+  }
+
+  for (auto &slot : m_slots) {
+    vmaDestroyBuffer(m_allocator, slot.buffer, slot.allocation);
+    m_memory.untrack(slot.allocation);
+  }
+  m_device.destroyCommandPool(m_computeCommandPool);
+  m_device.destroyCommandPool(m_transferCommandPool);
+}
+
+StagingEngine::Slot &StagingEngine::acquire() {
+  auto &slot = m_slots[m_next];
+  m_next = (m_next + 1) % m_slots.size();
+  retire(slot);
+  return slot;
+}
+
+vk::CommandBuffer StagingEngine::begin(vk::CommandBuffer commandBuffer) {
+  commandBuffer.reset();
+  commandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  return commandBuffer;
+}
+
+Ticket StagingEngine::submit(TimelineQueue &queue,
+                             vk::CommandBuffer commandBuffer,
+                             const Ticket &waitFor) {
+  commandBuffer.end();
+  // On a single queue, submission order and the recorded barriers are enough
+  if (m_singleQueue) {
+    return queue.submit(commandBuffer);
+  }
+  return queue.submit(commandBuffer, {&waitFor, 1});
+}
+
+void StagingEngine::releaseToCompute(vk::CommandBuffer commandBuffer,
+                                     vk::Buffer buffer, vk::DeviceSize offset,
+                                     vk::DeviceSize size) const {
+  if (m_crossFamily) {
+    releaseBufferOwnership(commandBuffer, buffer, m_transferQueue.familyIndex(),
+                           m_computeQueue.familyIndex(),
+                           vk::PipelineStageFlagBits::eTransfer,
+                           vk::AccessFlagBits::eTransferWrite, offset, size);
+  }
+}
+
+void StagingEngine::acquireFromTransfer(vk::CommandBuffer commandBuffer,
+                                        vk::Buffer buffer,
+                                        vk::DeviceSize offset,
+                                        vk::DeviceSize size) const {
+  if (m_crossFamily) {
+    acquireBufferOwnership(commandBuffer, buffer, m_transferQueue.familyIndex(),
+                           m_computeQueue.familyIndex(), COMPUTE_STAGES,
+                           COMPUTE_ACCESS, offset, size);
+  }
+}
+
+void StagingEngine::releaseToTransfer(vk::CommandBuffer commandBuffer,
+                                      vk::Buffer buffer, vk::DeviceSize offset,
+                                      vk::DeviceSize size) const {
+  if (m_crossFamily) {
+    releaseBufferOwnership(
+        commandBuffer, buffer, m_computeQueue.familyIndex(),
+        m_transferQueue.familyIndex(), COMPUTE_STAGES,
+        vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+        offset, size);
+  }
+}
+
+void StagingEngine::acquireFromCompute(vk::CommandBuffer commandBuffer,
+                                       vk::Buffer buffer,
+                                       vk::DeviceSize offset,
+                                       vk::DeviceSize size) const {
+  if (m_crossFamily) {
+    acquireBufferOwnership(commandBuffer, buffer, m_computeQueue.familyIndex(),
+                           m_transferQueue.familyIndex(),
+                           vk::PipelineStageFlagBits::eTransfer,
+                           vk::AccessFlagBits::eTransferRead, offset, size);
+  }
+}
+
+void StagingEngine::retire(Slot &slot) {
+  if (!slot.ticket.valid()) {
+    return;
+  }
+  slot.ticket.wait();
+  slot.ticket = {};
+
+  if (!slot.pendingReadback.empty()) {
+    vmaInvalidateAllocation(m_allocator, slot.allocation, 0,
+                            slot.pendingReadback.size());
+    std::memcpy(slot.pendingReadback.data(), slot.mapped,
+                slot.pendingReadback.size());
+    slot.pendingReadback = {};
+  }
+}
+
+void StagingEngine::finish() {
+  // Retire in submission order so readbacks complete in order
+  for (size_t i = 0; i < m_slots.size(); ++i) {
+    retire(m_slots[(m_next + i) % m_slots.size()]);
+  }
+}
+
+void StagingEngine::upload(std::span<const std::byte> src, vk::Buffer dst,
+                           vk::DeviceSize dstOffset) {
+  for (size_t offset = 0; offset < src.size(); offset += m_chunkSize) {
+    const auto size = std::min<size_t>(m_chunkSize, src.size() - offset);
+    const auto dstChunk = dstOffset + offset;
+    auto &slot = acquire();
+
+    // Host memcpy of this chunk overlaps the DMA of the previous ones
+    std::memcpy(slot.mapped, src.data() + offset, size);
+    vmaFlushAllocation(m_allocator, slot.allocation, 0, size);
+
+    // Overwrite dst only after compute work already submitted that may
+    // still read it
+    auto copy = begin(slot.transferCommandBuffers[0]);
+    if (m_singleQueue) {
+      memoryBarrierComputeThenTransfer(copy);
+    }
+    {
+      const auto scope = m_profiler.gpuScope(copy, "upload chunk",
+                                             m_transferQueue.familyIndex());
+      copy.copyBuffer(slot.buffer, dst, vk::BufferCopy{0, dstChunk, size});
+    }
+    // Compute work submitted after the call reads dst only after the copy.
+    // Across families the acquire below does that.
+    if (m_crossFamily) {
+      releaseToCompute(copy, dst, dstChunk, size);
+    } else {
+      memoryBarrierTransferThenCompute(copy);
+    }
+    slot.ticket = submit(m_transferQueue, copy, m_computeQueue.last());
+
+    if (m_crossFamily) {
+      auto acq = begin(slot.computeCommandBuffers[0]);
+      acquireFromTransfer(acq, dst, dstChunk, size);
+      slot.ticket = submit(m_computeQueue, acq, slot.ticket);
+    }
+  }
+  finish();
+}
+
+void StagingEngine::download(vk::Buffer src, vk::DeviceSize srcOffset,
+                             std::span<std::byte> dst) {
+  for (size_t offset = 0; offset < dst.size(); offset += m_chunkSize) {
+    const auto size = std::min<size_t>(m_chunkSize, dst.size() - offset);
+    const auto srcChunk = srcOffset + offset;
+
+    // Acquiring a slot finishes the readback of the chunk it last carried
+    auto &slot = acquire();
+
+    // Copy after compute work already submitted that may write src
+    Ticket computeDone = m_computeQueue.last();
+    if (m_crossFamily) {
+      auto rel = begin(slot.computeCommandBuffers[0]);
+      releaseToTransfer(rel, src, srcChunk, size);
+      computeDone = submit(m_computeQueue, rel);
+    }
+
+    auto copy = begin(slot.transferCommandBuffers[0]);
+    if (m_singleQueue) {
+      memoryBarrierComputeThenTransfer(copy);
+    }
+    acquireFromCompute(copy, src, srcChunk, size);
+    {
+      const auto scope = m_profiler.gpuScope(copy, "download chunk",
+                                             m_transferQueue.familyIndex());
+      copy.copyBuffer(src, slot.buffer, vk::BufferCopy{srcChunk, 0, size});
+    }
+    releaseToCompute(copy, src, srcChunk, size);
+    slot.ticket = submit(m_transferQueue, copy, computeDone);
+
+    if (m_crossFamily) {
+      auto acq = begin(slot.computeCommandBuffers[1]);
+      acquireFromTransfer(acq, src, srcChunk, size);
+      slot.ticket = submit(m_computeQueue, acq, slot.ticket);
+    }
+
+    slot.pendingReadback = dst.subspan(offset, size);
+  }
+  finish();
+}
+
+void StagingEngine::stream(std::span<const std::byte> src,
+                           vk::Buffer deviceIn, vk::Buffer deviceOut,
+                           std::span<std::byte> dst,
+                           const RecordChunk &recordCompute) {
+  if (src.size() != dst.size()) {
+    throw std::invalid_argument("StagingEngine::stream: size mismatch");
+  }
+
+  for (size_t offset = 0; offset < src.size(); offset += m_chunkSize) {
+    const auto size = std::min<size_t>(m_chunkSize, src.size() - offset);
+    auto &slot = acquire();
+
+    std::memcpy(slot.mapped, src.data() + offset, size);
+    vmaFlushAllocation(m_allocator, slot.allocation, 0, size);
+
+    // 1. Staging -> deviceIn on the transfer queue, after compute work
+    // already submitted that may still read it
+    auto copyIn = begin(slot.transferCommandBuffers[0]);
+    if (m_singleQueue) {
+      memoryBarrierComputeThenTransfer(copyIn);
+    }
+    {
+      const auto scope = m_profiler.gpuScope(copyIn, "stream upload chunk",
+                                             m_transferQueue.familyIndex());
+      copyIn.copyBuffer(slot.buffer, deviceIn,
+                        vk::BufferCopy{0, offset, size});
+    }
+    releaseToCompute(copyIn, deviceIn, offset, size);
+    slot.ticket = submit(m_transferQueue, copyIn, m_computeQueue.last());
+
+    // 2. Compute on the compute queue
+    auto compute = begin(slot.computeCommandBuffers[0]);
+    acquireFromTransfer(compute, deviceIn, offset, size);
+    if (m_singleQueue) {
+      memoryBarrierTransferThenCompute(compute);
+    }
+    recordCompute(compute, offset, size);
+    if (m_singleQueue) {
+      memoryBarrierComputeThenTransfer(compute);
+    }
+    releaseToTransfer(compute, deviceOut, offset, size);
+    slot.ticket = submit(m_computeQueue, compute, slot.ticket);
+
+    // 3. deviceOut -> staging on the transfer queue
+    auto copyOut = begin(slot.transferCommandBuffers[1]);
+    acquireFromCompute(copyOut, deviceOut, offset, size);
+    {
+      const auto scope = m_profiler.gpuScope(copyOut, "stream download chunk",
+                                             m_transferQueue.familyIndex());
+      copyOut.copyBuffer(deviceOut, slot.buffer,
+                         vk::BufferCopy{offset, 0, size});
+    }
+    releaseToCompute(copyOut, deviceOut, offset, size);
+    slot.ticket = submit(m_transferQueue, copyOut, slot.ticket);
+
+    // 4. Hand deviceOut back to the compute family
+    if (m_crossFamily) {
+      auto acq = begin(slot.computeCommandBuffers[1]);
+      acquireFromTransfer(acq, deviceOut, offset, size);
+      slot.ticket = submit(m_computeQueue, acq, slot.ticket);
+    }
+
+    slot.pendingReadback = dst.subspan(offset, size);
+  }
+  finish();
+}
+
+} // namespace vcm
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Timeline.hpp"
+#include "VmaUsage.hpp"
+#include "VulkanComputeManager.hpp"
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+/*
+Chunked host <-> device transfers through a ring of persistently mapped
+staging buffers.
+
+Large host arrays are split into chunks of at most chunkSize bytes. Each
+chunk goes through its own staging slot and command buffers, so the host
+memcpy of chunk i+1 overlaps the DMA (and compute) of chunk i. A slot is only
+reused after the ticket of its last submission completes.
+
+Copies run on the manager's transfer queue. When that is a dedicated queue
+from another family, device buffers are handed over with queue family
+ownership transfers and are owned by the compute family again when a call
+returns.
+
+All calls return once the whole transfer has completed. Uploaded data is
+visible to compute work submitted afterwards with no further barrier. Not
+thread safe: use one engine per thread.
+*/
+class StagingEngine {
+public:
+  static constexpr vk::DeviceSize DEFAULT_CHUNK_SIZE = 16ULL << 20U; // 16 MiB
+  static constexpr uint32_t DEFAULT_SLOT_COUNT = 3;
+
+  explicit StagingEngine(const VulkanComputeManager &manager,
+                         vk::DeviceSize chunkSize = DEFAULT_CHUNK_SIZE,
+                         uint32_t slotCount = DEFAULT_SLOT_COUNT);
+
+  StagingEngine(const StagingEngine &) = delete;
+  StagingEngine(StagingEngine &&) = delete;
+  StagingEngine &operator=(const StagingEngine &) = delete;
+  StagingEngine &operator=(StagingEngine &&) = delete;
+
+  ~StagingEngine();
+
+  [[nodiscard]] auto chunkSize() const { return m_chunkSize; }
+
+  // Host -> device, ordered before later compute work
+  void upload(std::span<const std::byte> src, vk::Buffer dst,
+              vk::DeviceSize dstOffset = 0);
+
+  // Device -> host
+  void download(vk::Buffer src, vk::DeviceSize srcOffset,
+                std::span<std::byte> dst);
+
+  // Records the compute work for one chunk. offset and size are in bytes
+  // into the device buffers passed to stream().
+  using RecordChunk = std::function<void(
+      vk::CommandBuffer commandBuffer, vk::DeviceSize offset,
+      vk::DeviceSize size)>;
+
+  // Host -> deviceIn -> compute -> deviceOut -> host, chunk by chunk.
+  // For element-wise kernels where chunk i of the output only depends on
+  // chunk i of the input. src and dst must be the same size.
+  void stream(std::span<const std::byte> src, vk::Buffer deviceIn,
+              vk::Buffer deviceOut, std::span<std::byte> dst,
+              const RecordChunk &recordCompute);
+
+private:
+  struct Slot {
+    VkBuffer buffer{};
+    VmaAllocation allocation{};
+    std::byte *mapped{};
+
+    std::array<vk::CommandBuffer, 2> transferCommandBuffers;
+    std::array<vk::CommandBuffer, 2> computeCommandBuffers;
+    Ticket ticket;
+
+    // Host destination to fill once the ticket completes
+    std::span<std::byte> pendingReadback;
+  };
+
+  vk::Device m_device;
+  VmaAllocator m_allocator;
+  MemoryTracker &m_memory;
+  TimelineQueue &m_transferQueue;
+  TimelineQueue &m_computeQueue;
+  Profiler &m_profiler;
+  vk::CommandPool m_transferCommandPool;
+  vk::CommandPool m_computeCommandPool;
+
+  // Transfer and compute share one queue: order by submission, no semaphores
+  bool m_singleQueue;
+  // Transfer and compute queues are in different families: transfer
+  // ownership of device buffers between them
+  bool m_crossFamily;
+
+  vk::DeviceSize m_chunkSize;
+  std::vector<Slot> m_slots;
+  size_t m_next{0};
+
+  // Wait for the next slot in the ring to be free
+  Slot &acquire();
+  // Wait for a slot's ticket and finish its readback
+  void retire(Slot &slot);
+  // Retire all slots
+  void finish();
+
+  static vk::CommandBuffer begin(vk::CommandBuffer commandBuffer);
+  Ticket submit(TimelineQueue &queue, vk::CommandBuffer commandBuffer,
+                const Ticket &waitFor = {});
+
+  void releaseToCompute(vk::CommandBuffer commandBuffer, vk::Buffer buffer,
+                        vk::DeviceSize offset, vk::DeviceSize size) const;
+  void acquireFromTransfer(vk::CommandBuffer commandBuffer, vk::Buffer buffer,
+                           vk::DeviceSize offset, vk::DeviceSize size) const;
+  void releaseToTransfer(vk::CommandBuffer commandBuffer, vk::Buffer buffer,
+                         vk::DeviceSize offset, vk::DeviceSize size) const;
+  void acquireFromCompute(vk::CommandBuffer commandBuffer, vk::Buffer buffer,
+                          vk::DeviceSize offset, vk::DeviceSize size) const;
+};
+
+} // namespace vcm
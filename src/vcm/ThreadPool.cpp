@@ -0,0 +1,75 @@
+#include "ThreadPool.hpp"
+#include <exception>
+#include <latch>
+
+namespace vcm {
+
+ThreadPool::ThreadPool(size_t threadCount) {
+  m_threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_threads.emplace_back([this] { workerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::scoped_lock lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  for (auto &thread : m_threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+      if (m_stop && m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t)> &func) {
+  if (count == 0) {
+    return;
+  }
+
+  std::latch done(static_cast<std::ptrdiff_t>(count));
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  {
+    std::scoped_lock lock(m_mutex);
+    for (size_t i = 0; i < count; ++i) {
+      m_tasks.emplace_back([&, i] {
+        try {
+          func(i);
+        } catch (...) {
+          std::scoped_lock errorLock(errorMutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+        done.count_down();
+      });
+    }
+  }
+  m_cv.notify_all();
+
+  done.wait();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace vcm
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vcm {
+
+/*
+Fixed set of worker threads.
+
+Workers live as long as the pool, so per-thread state (such as thread local
+command pools) is created once per worker rather than once per task.
+*/
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threadCount = defaultThreadCount());
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool(ThreadPool &&) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ThreadPool &operator=(ThreadPool &&) = delete;
+
+  ~ThreadPool();
+
+  [[nodiscard]] size_t size() const { return m_threads.size(); }
+
+  static size_t defaultThreadCount() {
+    return std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  // Run func(i) for i in [0, count) on the workers and wait for all of them.
+  // The first exception thrown by a task is rethrown here.
+  void parallelFor(size_t count, const std::function<void(size_t)> &func);
+
+private:
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::function<void()>> m_tasks;
+  bool m_stop{false};
+
+  void workerLoop();
+};
+
+} // namespace vcm
@@ -0,0 +1,96 @@
+#include "Timeline.hpp"
+#include <stdexcept>
+#include <vector>
+
+namespace vcm {
+
+bool Ticket::ready() const {
+  return !valid() || m_device.getSemaphoreCounterValue(m_semaphore) >= m_value;
+}
+
+bool Ticket::wait(uint64_t timeoutNs) const {
+  if (!valid()) {
+    return true;
+  }
+
+  vk::SemaphoreWaitInfo waitInfo{};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &m_semaphore;
+  waitInfo.pValues = &m_value;
+
+  const auto result = m_device.waitSemaphores(waitInfo, timeoutNs);
+  if (result == vk::Result::eTimeout) {
+    return false;
+  }
+  if (result != vk::Result::eSuccess) {
+    throw std::runtime_error("Failed waiting for timeline semaphore");
+  }
+  return true;
+}
+
+TimelineQueue::TimelineQueue(vk::Device device, vk::Queue queue,
+                             uint32_t familyIndex)
+    : m_device(device), m_queue(queue), m_familyIndex(familyIndex) {
+  vk::SemaphoreTypeCreateInfo typeInfo{vk::SemaphoreType::eTimeline, 0};
+  vk::SemaphoreCreateInfo createInfo{};
+  createInfo.pNext = &typeInfo;
+  m_semaphore = m_device.createSemaphore(createInfo);
+}
+
+TimelineQueue::~TimelineQueue() {
+  try {
+    waitIdle();
+  } catch (const std::exception &) { // NOLINT(*-empty-catch)
+    // Device lost, nothing left to wait for
+  }
+  m_device.destroySemaphore(m_semaphore);
+}
+
+Ticket TimelineQueue::submit(std::span<const vk::CommandBuffer> commandBuffers,
+                             std::span<const Ticket> waitFor,
+                             vk::PipelineStageFlags waitStage) {
+  std::vector<vk::Semaphore> waitSemaphores;
+  std::vector<uint64_t> waitValues;
+  waitSemaphores.reserve(waitFor.size());
+  waitValues.reserve(waitFor.size());
+  for (const auto &ticket : waitFor) {
+    if (ticket.valid()) {
+      waitSemaphores.push_back(ticket.semaphore());
+      waitValues.push_back(ticket.value());
+    }
+  }
+  const std::vector<vk::PipelineStageFlags> waitStages(waitSemaphores.size(),
+                                                       waitStage);
+
+  std::scoped_lock lock(m_mutex);
+  const uint64_t signalValue = m_value + 1;
+
+  vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.waitSemaphoreValueCount =
+      static_cast<uint32_t>(waitValues.size());
+  timelineInfo.pWaitSemaphoreValues = waitValues.data();
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+  vk::SubmitInfo submitInfo{};
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+  submitInfo.pCommandBuffers = commandBuffers.data();
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &m_semaphore;
+
+  m_queue.submit(submitInfo);
+  m_value = signalValue;
+
+  return {m_device, m_semaphore, signalValue};
+}
+
+Ticket TimelineQueue::last() const {
+  std::scoped_lock lock(m_mutex);
+  return {m_device, m_semaphore, m_value};
+}
+
+} // namespace vcm
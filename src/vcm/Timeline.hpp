@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+/*
+Handle to an asynchronous submission: a value on a timeline semaphore that
+the GPU signals when the submission completes. Cheap to copy.
+*/
+class Ticket {
+public:
+  Ticket() = default;
+  Ticket(vk::Device device, vk::Semaphore semaphore, uint64_t value)
+      : m_device(device), m_semaphore(semaphore), m_value(value) {}
+
+  [[nodiscard]] bool valid() const { return static_cast<bool>(m_semaphore); }
+  [[nodiscard]] auto semaphore() const { return m_semaphore; }
+  [[nodiscard]] auto value() const { return m_value; }
+
+  // True once the GPU has finished the submission. An invalid ticket is
+  // always ready.
+  [[nodiscard]] bool ready() const;
+
+  // Block until the submission completes. Returns false on timeout.
+  bool wait(uint64_t timeoutNs = UINT64_MAX) const; // NOLINT(*-nodiscard)
+
+private:
+  vk::Device m_device;
+  vk::Semaphore m_semaphore;
+  uint64_t m_value{};
+};
+
+/*
+A queue with a timeline semaphore that is signalled by every submission.
+
+submit() is thread safe and returns immediately with a Ticket, so the host
+can keep recording while the GPU runs. Submissions can wait on tickets from
+any TimelineQueue, which chains work across queues without host round trips.
+*/
+class TimelineQueue {
+public:
+  TimelineQueue(vk::Device device, vk::Queue queue, uint32_t familyIndex);
+
+  TimelineQueue(const TimelineQueue &) = delete;
+  TimelineQueue(TimelineQueue &&) = delete;
+  TimelineQueue &operator=(const TimelineQueue &) = delete;
+  TimelineQueue &operator=(TimelineQueue &&) = delete;
+
+  ~TimelineQueue();
+
+  [[nodiscard]] auto queue() const { return m_queue; }
+  [[nodiscard]] auto familyIndex() const { return m_familyIndex; }
+
+  // Submit command buffers that start after all of waitFor have completed.
+  // waitStage is the first stage of the submission that depends on them.
+  Ticket submit(std::span<const vk::CommandBuffer> commandBuffers,
+                std::span<const Ticket> waitFor = {},
+                vk::PipelineStageFlags waitStage =
+                    vk::PipelineStageFlagBits::eAllCommands);
+
+  Ticket submit(vk::CommandBuffer commandBuffer,
+                std::span<const Ticket> waitFor = {},
+                vk::PipelineStageFlags waitStage =
+                    vk::PipelineStageFlagBits::eAllCommands) {
+    return submit(std::span<const vk::CommandBuffer>(&commandBuffer, 1),
+                  waitFor, waitStage);
+  }
+
+  // Ticket of the most recent submission
+  [[nodiscard]] Ticket last() const;
+
+  // Wait for everything submitted so far. Unlike vkQueueWaitIdle this doesn't
+  // block other threads from submitting.
+  void waitIdle() const { last().wait(); }
+
+private:
+  vk::Device m_device;
+  vk::Queue m_queue;
+  uint32_t m_familyIndex;
+
+  vk::Semaphore m_semaphore;
+  uint64_t m_value{0};
+
+  // vkQueueSubmit requires external synchronization of the queue
+  mutable std::mutex m_mutex;
+};
+
+} // namespace vcm
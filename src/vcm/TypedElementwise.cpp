@@ -0,0 +1,172 @@
+#include "TypedElementwise.hpp"
+#include "StagingEngine.hpp"
+#include "VulkanComputeManager.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <vector>
+
+namespace vcm {
+
+Half Half::fromFloat(float value) {
+  const auto bits = std::bit_cast<uint32_t>(value);
+  const auto sign = static_cast<uint16_t>((bits >> 16U) & 0x8000U);
+  const auto floatExponent = (bits >> 23U) & 0xFFU;
+  auto mantissa = bits & 0x7FFFFFU;
+
+  // Infinity stays, NaN stays a (quiet) NaN
+  if (floatExponent == 0xFF) {
+    return {static_cast<uint16_t>(sign | 0x7C00U | (mantissa != 0 ? 0x200U : 0))};
+  }
+  const auto exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+  if (exponent >= 31) {
+    return {static_cast<uint16_t>(sign | 0x7C00U)};
+  }
+
+  // Drop shift bits of mantissa, rounding to nearest even. A carry out of
+  // the mantissa correctly bumps the exponent.
+  const auto round = [](uint32_t mantissa, uint32_t shift) {
+    auto result = mantissa >> shift;
+    const auto rest = mantissa & ((1U << shift) - 1);
+    const auto halfway = 1U << (shift - 1);
+    if (rest > halfway || (rest == halfway && (result & 1U) != 0)) {
+      ++result;
+    }
+    return result;
+  };
+
+  if (exponent <= 0) {
+    // Subnormal or zero
+    if (exponent < -10) {
+      return {sign};
+    }
+    mantissa |= 0x800000U;
+    return {static_cast<uint16_t>(
+        sign | round(mantissa, static_cast<uint32_t>(14 - exponent)))};
+  }
+  return {static_cast<uint16_t>(
+      sign | round((static_cast<uint32_t>(exponent) << 23U) | mantissa, 13))};
+}
+
+float Half::toFloat() const {
+  const auto sign = static_cast<uint32_t>(bits & 0x8000U) << 16U;
+  const auto exponent = (bits >> 10U) & 0x1FU;
+  const auto mantissa = static_cast<uint32_t>(bits & 0x3FFU);
+  if (exponent == 0x1F) {
+    return std::bit_cast<float>(sign | 0x7F800000U | (mantissa << 13U));
+  }
+  if (exponent == 0) {
+    // Subnormal: mantissa * 2^-24, exact in a float
+    const auto magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign != 0 ? -magnitude : magnitude;
+  }
+  return std::bit_cast<float>(sign | ((exponent + 112U) << 23U) |
+                              (mantissa << 13U));
+}
+
+ComputeKernel &getTypedKernel(VulkanComputeManager &manager,
+                              ElementwiseOp op, std::string_view type,
+                              bool vectorized) {
+  const auto *name = op == ElementwiseOp::Add ? "typed_add" : "typed_square";
+  return manager.getKernel(fmt::format("shaders/{}_{}_x{}.spv", name, type,
+                                       vectorized ? 4 : 1));
+}
+
+void recordElementwise(VulkanComputeManager &manager,
+                       vk::CommandBuffer commandBuffer, ElementwiseOp op,
+                       std::string_view type, size_t elementSize,
+                       std::span<const vk::DescriptorBufferInfo> buffers,
+                       uint64_t count) {
+  const auto bytes = count * elementSize;
+  const auto fits = [&](vk::DeviceSize unitBytes) {
+    const auto needed = (bytes + unitBytes - 1) / unitBytes * unitBytes;
+    return std::ranges::all_of(buffers, [&](const auto &buffer) {
+      return buffer.offset % unitBytes == 0 &&
+             (buffer.range == vk::WholeSize || buffer.range >= needed);
+    });
+  };
+
+  const vk::DeviceSize vectorBytes = 4 * sizeof(uint32_t);
+  const bool vectorized = fits(vectorBytes);
+  if (!vectorized && !fits(sizeof(uint32_t))) {
+    throw std::runtime_error(fmt::format(
+        "Typed kernels need buffer ranges aligned to 4 bytes and covering "
+        "{} elements of {} bytes rounded up to 4.",
+        count, elementSize));
+  }
+
+  // Ranges of exactly the units processed, so chunks of them line up
+  const auto unitBytes = vectorized ? vectorBytes : sizeof(uint32_t);
+  const auto units = (bytes + unitBytes - 1) / unitBytes;
+  std::vector<vk::DescriptorBufferInfo> ranges(buffers.begin(), buffers.end());
+  for (auto &range : ranges) {
+    range.range = units * unitBytes;
+  }
+
+  getTypedKernel(manager, op, type, vectorized)
+      .dispatchElements(commandBuffer, ranges, units);
+}
+
+ElementwiseRunner::ElementwiseRunner(VulkanComputeManager &manager)
+    : m_manager(manager), m_staging(std::make_unique<StagingEngine>(manager)) {
+}
+
+// Out of line, where StagingEngine is complete
+ElementwiseRunner::~ElementwiseRunner() = default;
+
+void ElementwiseRunner::run(ElementwiseOp op, std::string_view type,
+                            size_t elementSize,
+                            std::span<const std::span<const std::byte>> inputs,
+                            std::span<std::byte> output, uint64_t count) {
+  const auto bytes = count * elementSize;
+  if (output.size() < bytes ||
+      std::ranges::any_of(inputs,
+                          [&](const auto &in) { return in.size() < bytes; })) {
+    throw std::runtime_error(fmt::format(
+        "Element-wise op over {} elements with a shorter input or output.",
+        count));
+  }
+  if (count == 0) {
+    return;
+  }
+
+  const auto usage = vk::BufferUsageFlagBits::eStorageBuffer |
+                     vk::BufferUsageFlagBits::eTransferSrc |
+                     vk::BufferUsageFlagBits::eTransferDst;
+  m_buffers.resize(std::max(m_buffers.size(), inputs.size() + 1));
+  for (size_t i = 0; i <= inputs.size(); ++i) {
+    m_manager.growBuffer(m_buffers[i], bytes, usage, HostAccess::None,
+                         "elementwise");
+  }
+  auto &outputBuffer = m_buffers[inputs.size()];
+
+  // Ranges of the elements, padded to whole vectors, at the start of the
+  // possibly larger buffers
+  const auto rangeBytes = (bytes + Buffer<std::byte>::VECTOR_BYTES - 1) /
+                          Buffer<std::byte>::VECTOR_BYTES *
+                          Buffer<std::byte>::VECTOR_BYTES;
+  std::vector<vk::DescriptorBufferInfo> descriptors;
+  for (size_t i = 0; i <= inputs.size(); ++i) {
+    descriptors.emplace_back(m_buffers[i].buffer(), 0, rangeBytes);
+  }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    m_staging->upload(inputs[i].first(bytes), m_buffers[i].buffer());
+  }
+
+  // upload() orders the copies before this dispatch, no barrier needed
+  auto commandBuffer = m_manager.beginOneTimeCommands();
+  recordElementwise(m_manager, commandBuffer, op, type, elementSize,
+                    descriptors, count);
+  m_manager.submitOneTime(commandBuffer).wait();
+
+  m_staging->download(outputBuffer.buffer(), 0, output.first(bytes));
+}
+
+void runElementwise(VulkanComputeManager &manager, ElementwiseOp op,
+                    std::string_view type, size_t elementSize,
+                    std::span<const std::span<const std::byte>> inputs,
+                    std::span<std::byte> output, uint64_t count) {
+  ElementwiseRunner(manager).run(op, type, elementSize, inputs, output, count);
+}
+
+} // namespace vcm
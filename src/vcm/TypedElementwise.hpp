@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "ComputeKernel.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+class StagingEngine;
+class VulkanComputeManager;
+
+// IEEE 754 binary16 as its bits, for Buffer<Half>. Typed kernels compute in
+// fp32 and round back to half.
+struct Half {
+  uint16_t bits;
+
+  // Rounds to nearest even, out of range values become infinities
+  static Half fromFloat(float value);
+  [[nodiscard]] float toFloat() const;
+};
+
+// Permutation name of the element types typed kernels are built for (see
+// VCM_HLSL_ELEMENT_TYPES), empty for others
+template <typename T> inline constexpr std::string_view shaderElementType{};
+template <> inline constexpr std::string_view shaderElementType<float> = "float";
+template <> inline constexpr std::string_view shaderElementType<Half> = "half";
+template <>
+inline constexpr std::string_view shaderElementType<int16_t> = "int16";
+template <>
+inline constexpr std::string_view shaderElementType<uint8_t> = "uint8";
+template <>
+inline constexpr std::string_view shaderElementType<int32_t> = "int32";
+template <>
+inline constexpr std::string_view shaderElementType<uint32_t> = "uint32";
+
+template <typename T>
+concept ShaderElement = !shaderElementType<T>.empty();
+
+enum class ElementwiseOp { Add, Square };
+
+// The permutation of a typed element-wise shader for an element type, with 4
+// words (128 bits) per thread if vectorized or 1 otherwise
+ComputeKernel &getTypedKernel(VulkanComputeManager &manager,
+                              ElementwiseOp op, std::string_view type,
+                              bool vectorized);
+
+/*
+Record op over count elements of elementSize bytes in buffers, the inputs
+then the output.
+
+Every range must start at a multiple of the device's
+minStorageBufferOffsetAlignment (up to 256 bytes), as any bound range, and
+of 4 bytes. Vectorized when every range also starts at a multiple of 16
+bytes and covers the elements rounded up to 16 bytes, 4 bytes per thread
+otherwise; that needs ranges covering the elements rounded up to 4.
+Elements in the rounding past count are computed too. Whole Buffer<T>
+allocations are padded for the vectorized path (Buffer::paddedDescriptor).
+*/
+void recordElementwise(VulkanComputeManager &manager,
+                       vk::CommandBuffer commandBuffer, ElementwiseOp op,
+                       std::string_view type, size_t elementSize,
+                       std::span<const vk::DescriptorBufferInfo> buffers,
+                       uint64_t count);
+
+/*
+Element-wise ops over host arrays: uploads the inputs to device buffers,
+computes and downloads the output. Blocks until done.
+
+The staging engine and device buffers are kept between calls, the buffers
+grown to the largest call so far, so repeated calls pay for transfers and
+the kernel only. Not thread safe.
+*/
+class ElementwiseRunner {
+public:
+  explicit ElementwiseRunner(VulkanComputeManager &manager);
+
+  ElementwiseRunner(const ElementwiseRunner &) = delete;
+  ElementwiseRunner(ElementwiseRunner &&) = delete;
+  ElementwiseRunner &operator=(const ElementwiseRunner &) = delete;
+  ElementwiseRunner &operator=(ElementwiseRunner &&) = delete;
+
+  ~ElementwiseRunner();
+
+  [[nodiscard]] StagingEngine &staging() const { return *m_staging; }
+
+  // op over count elements, the inputs then the output as bytes
+  void run(ElementwiseOp op, std::string_view type, size_t elementSize,
+           std::span<const std::span<const std::byte>> inputs,
+           std::span<std::byte> output, uint64_t count);
+
+private:
+  VulkanComputeManager &m_manager;
+  std::unique_ptr<StagingEngine> m_staging;
+  // The inputs then the output
+  std::vector<Buffer<std::byte>> m_buffers;
+};
+
+// ElementwiseRunner::run() on a runner of its own, which is created and
+// destroyed with the call. Prefer a runner for repeated calls.
+void runElementwise(VulkanComputeManager &manager, ElementwiseOp op,
+                    std::string_view type, size_t elementSize,
+                    std::span<const std::span<const std::byte>> inputs,
+                    std::span<std::byte> output, uint64_t count);
+
+// out = a + b, the permutation picked at compile time from T
+template <ShaderElement T>
+void recordAdd(VulkanComputeManager &manager, vk::CommandBuffer commandBuffer,
+               const Buffer<T> &a, const Buffer<T> &b, Buffer<T> &out) {
+  if (b.size() < a.size() || out.size() < a.size()) {
+    throw std::runtime_error(fmt::format(
+        "Add of {} elements into buffers of {} and {}.", a.size(), b.size(),
+        out.size()));
+  }
+  const std::array buffers{a.paddedDescriptor(), b.paddedDescriptor(),
+                           out.paddedDescriptor()};
+  recordElementwise(manager, commandBuffer, ElementwiseOp::Add,
+                    shaderElementType<T>, sizeof(T), buffers, a.size());
+}
+
+// out = in * in
+template <ShaderElement T>
+void recordSquare(VulkanComputeManager &manager,
+                  vk::CommandBuffer commandBuffer, const Buffer<T> &in,
+                  Buffer<T> &out) {
+  if (out.size() < in.size()) {
+    throw std::runtime_error(fmt::format(
+        "Square of {} elements into a buffer of {}.", in.size(), out.size()));
+  }
+  const std::array buffers{in.paddedDescriptor(), out.paddedDescriptor()};
+  recordElementwise(manager, commandBuffer, ElementwiseOp::Square,
+                    shaderElementType<T>, sizeof(T), buffers, in.size());
+}
+
+} // namespace vcm
@@ -1,12 +1,15 @@
 #include "VulkanComputeManager.hpp"
 #include "Common.hpp"
 #include "VmaUsage.hpp"
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <fmt/format.h>
 #include <fstream>
 #include <ios>
 #include <map>
 #include <stdexcept>
+#include <string_view>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
@@ -16,24 +19,72 @@ namespace vcm {
 
 constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-VulkanComputeManager::VulkanComputeManager() {
+namespace {
+
+// Milliseconds step takes
+template <typename Step> double timeMs(Step &&step) {
+  const auto start = std::chrono::steady_clock::now();
+  step();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+VulkanComputeManager::VulkanComputeManager(const fs::path &pipelineCacheDir)
+    : VulkanComputeManager(0, pipelineCacheDir) {}
+
+VulkanComputeManager::VulkanComputeManager(size_t deviceRank,
+                                           const fs::path &pipelineCacheDir) {
   // Step 1: Init Vulkan instance
-  createInstance();
+  m_startup.instanceMs = timeMs([&] { createInstance(); });
 
   // Step 2: pick physical device
-  pickPhysicalDevice();
+  m_startup.deviceSelectionMs =
+      timeMs([&] { pickPhysicalDevice(deviceRank); });
 
   // Step 3: create logical device
-  createLogicalDevice();
+  m_startup.deviceCreationMs = timeMs([&] { createLogicalDevice(); });
 
   // Step 4: create VMA allocator
-  createVmaAllocator();
+  m_startup.allocatorMs = timeMs([&] { createVmaAllocator(); });
+  m_memory = std::make_unique<MemoryTracker>(m_allocator, physicalDevice,
+                                             m_memoryBudget);
+
+  // Step 5: load the pipeline cache for this device and driver
+  m_startup.pipelineCacheMs = timeMs([&] {
+    m_pipelineCache = std::make_unique<PipelineCache>(device, physicalDevice,
+                                                      pipelineCacheDir);
+  });
+
+  // Before the command pools, which discard the scopes of command buffers
+  // that never executed
+  m_profiler = std::make_unique<Profiler>(device, physicalDevice,
+                                          m_hostQueryReset, queueFamilyIndex);
 
   createCommandPool();
 
+  m_threadCommandPools = std::make_unique<CommandPoolRegistry>(
+      device, queueFamilyIndex, m_profiler.get());
+
   createCommandBuffer();
 
-  createDescriptorPool();
+  createDescriptorAllocators();
+
+  if (m_profiler->enabled()) {
+    calibrateProfiler();
+  }
+
+  m_shaderModules = std::make_unique<ShaderModuleCache>(device);
+  m_kernels = std::make_unique<KernelCache>(
+      device, m_pipelineCache->get(), *m_descriptorSets, m_profiler.get(),
+      DispatchLimits::fromDevice(physicalDevice), m_shaderModules.get());
+  m_tuner = std::make_unique<WorkgroupTuner>(*this, pipelineCacheDir);
+  // Tuned once, as each kernel is created: applying a size to a kernel
+  // other threads already dispatch would race with them
+  m_kernels->setCreatedCallback(
+      [this](ComputeKernel &kernel) { m_tuner->apply(kernel); });
 
   {
     auto formatProperties =
@@ -48,12 +99,69 @@ VulkanComputeManager::VulkanComputeManager() {
 }
 
 VulkanComputeManager::~VulkanComputeManager() {
+  // Nothing is submitted from here on. Idle queues before their semaphores
+  // go, so no set waits on them.
+  for (const auto &queue : m_queues) {
+    queue->waitIdle();
+  }
+  m_descriptorSets->setQueues({});
+  // Waits for outstanding submissions
+  m_asyncComputeQueues.clear();
+  m_computeQueue = m_transferQueue = nullptr;
+  m_queues.clear();
+
+  m_workers.reset();
+  m_threadCommandPools.reset();
+  m_transferOneTimeCommands.reset();
+  m_oneTimeCommands.reset();
+
+  m_tuner.reset();
+  m_kernels.reset();
+  m_shaderModules.reset();
+  m_profiler.reset();
+  m_frameDescriptors.reset();
+  m_descriptorSets.reset();
+
+  // Saves the cache to disk
+  m_pipelineCache.reset();
+
+  m_memory.reset();
   vmaDestroyAllocator(m_allocator);
   device.destroyCommandPool(commandPool);
   device.destroy();
   instance.destroy();
 };
 
+ComputeKernel &VulkanComputeManager::getKernel(std::span<const uint32_t> spirv,
+                                               const char *entryPoint,
+                                               bool dynamicOffsets) {
+  return m_kernels->get(spirv, entryPoint, dynamicOffsets);
+}
+
+ComputeKernel &
+VulkanComputeManager::getKernel(const std::string &shaderFileName,
+                                const char *entryPoint, bool dynamicOffsets) {
+  return m_kernels->get(shaderFileName, entryPoint, dynamicOffsets);
+}
+
+std::vector<ComputeKernel *>
+VulkanComputeManager::warmUp(std::span<const std::string> shaderFileNames,
+                             const char *entryPoint) {
+  std::vector<ComputeKernel *> kernels(shaderFileNames.size());
+  const auto tunedBefore = m_tuner->tuningMs();
+  const auto elapsed = timeMs([&] {
+    get_workers().parallelFor(kernels.size(), [&](size_t i) {
+      kernels[i] = &m_kernels->get(shaderFileNames[i], entryPoint);
+    });
+  });
+
+  // Benchmarks of kernels never tuned on this device are reported apart
+  const auto tuning = m_tuner->tuningMs() - tunedBefore;
+  m_startup.tuningMs += tuning;
+  m_startup.pipelineCreationMs += std::max(0.0, elapsed - tuning);
+  return kernels;
+}
+
 void VulkanComputeManager::createCommandPool() {
   QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
@@ -81,6 +189,21 @@ void VulkanComputeManager::createCommandPool() {
   // Each command pool can only allocate command buffers that are submitted on a
   // single type of queue.
   commandPool = device.createCommandPool(poolInfo);
+
+  // Short lived command buffers for one time submits and copies are recycled
+  // from their own transient pools
+  m_oneTimeCommands = std::make_unique<CommandBufferRecycler>(
+      device, poolInfo.queueFamilyIndex, m_profiler.get());
+  m_transferOneTimeCommands = std::make_unique<CommandBufferRecycler>(
+      device, m_transferQueue->familyIndex(), m_profiler.get());
+}
+
+void VulkanComputeManager::calibrateProfiler() {
+  m_profiler->calibrate(*m_computeQueue, *m_oneTimeCommands);
+  // Timestamps of another family may count from another origin
+  if (m_transferQueue->familyIndex() != m_computeQueue->familyIndex()) {
+    m_profiler->calibrate(*m_transferQueue, *m_transferOneTimeCommands);
+  }
 }
 
 void VulkanComputeManager::createCommandBuffer() {
@@ -96,47 +219,141 @@ void VulkanComputeManager::createCommandBuffer() {
   commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
 }
 
-void VulkanComputeManager::createDescriptorPool() {
-  // Create descriptor pool
-  // describe which descriptor types our descriptor sets are going to contain
-  // and how many
-  std::array<vk::DescriptorPoolSize, 2> poolSize{{
-      {vk::DescriptorType::eStorageBuffer, 20},
-      {vk::DescriptorType::eUniformBuffer, 10},
-  }};
-
-  vk::DescriptorPoolCreateInfo poolInfo{};
-  poolInfo.maxSets = 20;
-  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSize.size());
-  poolInfo.pPoolSizes = poolSize.data();
-  poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
-
-  descriptorPool = device.createDescriptorPool(poolInfo);
+void VulkanComputeManager::createDescriptorAllocators() {
+  // Descriptor sets are allocated from pools that are chained on demand, so
+  // there is no fixed limit on the number of live kernels or sets.
+  // Sets dropped while submissions on these queues may still read them are
+  // rewritten once those complete
+  std::vector<const TimelineQueue *> queues;
+  for (const auto &queue : m_queues) {
+    queues.push_back(queue.get());
+  }
+  m_descriptorSets = std::make_unique<DescriptorSetCache>(device, queues);
+  m_frameDescriptors = std::make_unique<DescriptorAllocator>(device);
+}
+
+ThreadPool &VulkanComputeManager::get_workers() {
+  std::scoped_lock lock(m_workersMutex);
+  if (!m_workers) {
+    m_workers = std::make_unique<ThreadPool>();
+  }
+  return *m_workers;
+}
+
+void VulkanComputeManager::recordParallel(vk::CommandBuffer primary,
+                                          size_t taskCount,
+                                          const RecordTask &record) {
+  std::vector<vk::CommandBuffer> secondaries(taskCount);
+
+  get_workers().parallelFor(taskCount, [&](size_t task) {
+    auto secondary =
+        m_threadCommandPools->allocate(vk::CommandBufferLevel::eSecondary);
+
+    // Compute only: no render pass to inherit
+    vk::CommandBufferInheritanceInfo inheritanceInfo{};
+    secondary.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                     &inheritanceInfo});
+    record(secondary, task);
+    secondary.end();
+
+    secondaries[task] = secondary;
+  });
+
+  if (!secondaries.empty()) {
+    primary.executeCommands(secondaries);
+  }
 }
 
 void VulkanComputeManager::copyBuffer(vk::Buffer srcBuffer,
                                       vk::Buffer dstBuffer, vk::DeviceSize size,
                                       vk::CommandBuffer commandBuffer) const {
   // Memory transfer ops are executed using command buffers.
-  // We must first allocate a temporary command buffer.
-  // We can create a short-lived command pool for this because the
-  // implementation may be able to apply memory allocation optimizations.
-  // (should set VK_COMMAND_POOL_CREATE_TRANSIENT_BIT) flag during command
-  // pool creation
-
-  const bool allocTempCommandBuffer = !commandBuffer;
-
-  if (allocTempCommandBuffer) {
-    commandBuffer = beginTempOneTimeCommandBuffer();
+  // Without one from the caller, a recycled one time command buffer from a
+  // transient pool is used.
+  if (commandBuffer) {
+    vk::BufferCopy copyRegion{};
+    copyRegion.size = size;
+    const auto scope = m_profiler->gpuScope(commandBuffer, "copyBuffer");
+    commandBuffer.copyBuffer(srcBuffer, dstBuffer, copyRegion);
+    return;
   }
 
+  copyBufferAsync(srcBuffer, dstBuffer, size).wait();
+}
+
+Ticket VulkanComputeManager::copyBufferAsync(
+    vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size,
+    std::span<const Ticket> waitFor) const {
   vk::BufferCopy copyRegion{};
   copyRegion.size = size;
-  commandBuffer.copyBuffer(srcBuffer, dstBuffer, copyRegion);
 
-  if (allocTempCommandBuffer) {
-    endOneTimeCommandBuffer(commandBuffer);
+  if (!hasDedicatedTransferQueue()) {
+    auto copy = m_oneTimeCommands->begin();
+    {
+      const auto scope = m_profiler->gpuScope(copy, "copyBuffer");
+      copy.copyBuffer(srcBuffer, dstBuffer, copyRegion);
+    }
+    return submitOneTime(*m_computeQueue, *m_oneTimeCommands, copy, waitFor);
+  }
+
+  // Copy on the transfer queue, moving ownership of both buffers
+  // compute -> transfer -> compute.
+  const auto computeFamily = m_computeQueue->familyIndex();
+  const auto transferFamily = m_transferQueue->familyIndex();
+  const std::array buffers{srcBuffer, dstBuffer};
+
+  // 1. Release from the compute family after any pending compute work
+  auto release = m_oneTimeCommands->begin();
+  {
+    const auto scope = m_profiler->gpuScope(release, "release to transfer");
+    for (const auto buffer : buffers) {
+      releaseBufferOwnership(release, buffer, computeFamily, transferFamily,
+                             vk::PipelineStageFlagBits::eComputeShader |
+                                 vk::PipelineStageFlagBits::eTransfer,
+                             vk::AccessFlagBits::eShaderWrite |
+                                 vk::AccessFlagBits::eTransferWrite);
+    }
+  }
+  const auto released =
+      submitOneTime(*m_computeQueue, *m_oneTimeCommands, release, waitFor);
+
+  // 2. Acquire, copy and release back on the transfer queue
+  auto copy = m_transferOneTimeCommands->begin();
+  {
+    const auto scope = m_profiler->gpuScope(copy, "copyBuffer (transfer)",
+                                            transferFamily);
+    for (const auto buffer : buffers) {
+      acquireBufferOwnership(copy, buffer, computeFamily, transferFamily,
+                             vk::PipelineStageFlagBits::eTransfer,
+                             vk::AccessFlagBits::eTransferRead |
+                                 vk::AccessFlagBits::eTransferWrite);
+    }
+    copy.copyBuffer(srcBuffer, dstBuffer, copyRegion);
+    for (const auto buffer : buffers) {
+      releaseBufferOwnership(copy, buffer, transferFamily, computeFamily,
+                             vk::PipelineStageFlagBits::eTransfer,
+                             vk::AccessFlagBits::eTransferWrite);
+    }
+  }
+  const auto copied = submitOneTime(*m_transferQueue, *m_transferOneTimeCommands,
+                                    copy, {&released, 1});
+
+  // 3. Acquire back on the compute family
+  auto acquire = m_oneTimeCommands->begin();
+  {
+    const auto scope = m_profiler->gpuScope(acquire, "acquire from transfer");
+    for (const auto buffer : buffers) {
+      acquireBufferOwnership(acquire, buffer, transferFamily, computeFamily,
+                             vk::PipelineStageFlagBits::eComputeShader |
+                                 vk::PipelineStageFlagBits::eTransfer,
+                             vk::AccessFlagBits::eShaderRead |
+                                 vk::AccessFlagBits::eShaderWrite |
+                                 vk::AccessFlagBits::eTransferRead |
+                                 vk::AccessFlagBits::eTransferWrite);
+    }
   }
+  return submitOneTime(*m_computeQueue, *m_oneTimeCommands, acquire,
+                       {&copied, 1});
 }
 
 uint32_t
@@ -178,7 +395,7 @@ void VulkanComputeManager::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_1;
+  appInfo.apiVersion = VULKAN_API_VERSION;
 
   vk::InstanceCreateInfo createInfo{};
   createInfo.pApplicationInfo = &appInfo;
@@ -250,10 +467,20 @@ int VulkanComputeManager::rateDeviceSuitability(vk::PhysicalDevice device) {
     return 0;
   }
 
+  // Need Vulkan 1.2 with timeline semaphores
+  if (deviceProperties.apiVersion < VULKAN_API_VERSION) {
+    return 0;
+  }
+  const auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                            vk::PhysicalDeviceVulkan12Features>();
+  if (!features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore) {
+    return 0;
+  }
+
   return score;
 }
 
-void VulkanComputeManager::pickPhysicalDevice() {
+void VulkanComputeManager::pickPhysicalDevice(size_t rank) {
   physicalDevice = VK_NULL_HANDLE;
   physicalDeviceName = {};
 
@@ -267,19 +494,36 @@ void VulkanComputeManager::pickPhysicalDevice() {
   std::multimap<int, VkPhysicalDevice> candidates;
   for (const auto &device : devices) {
     const int score = rateDeviceSuitability(device);
-    candidates.insert({score, device});
+    if (score > 0) {
+      candidates.insert({score, device});
+    }
   }
 
-  if (candidates.rbegin()->first > 0) {
-    physicalDevice = candidates.rbegin()->second;
-
-    auto deviceProperties = physicalDevice.getProperties();
-    const auto &name = deviceProperties.deviceName;
-    physicalDeviceName = std::string{name.data(), name.size()};
-
-  } else {
+  m_suitableDeviceCount = candidates.size();
+  if (candidates.empty()) {
     throw std::runtime_error("Failed to find a suitable GPU");
   }
+  if (rank >= candidates.size()) {
+    throw std::runtime_error(
+        fmt::format("Found {} suitable GPUs, cannot pick number {}.",
+                    candidates.size(), rank + 1));
+  }
+
+  // Best first; equal scores stay in enumeration order
+  std::vector<VkPhysicalDevice> ranked;
+  for (auto it = candidates.begin(); it != candidates.end();) {
+    const auto end = candidates.upper_bound(it->first);
+    std::vector<VkPhysicalDevice> tied;
+    for (; it != end; ++it) {
+      tied.push_back(it->second);
+    }
+    ranked.insert(ranked.begin(), tied.begin(), tied.end());
+  }
+  physicalDevice = ranked[rank];
+
+  auto deviceProperties = physicalDevice.getProperties();
+  const auto &name = deviceProperties.deviceName;
+  physicalDeviceName = std::string{name.data()};
 
   fmt::println("Picked physical device '{}'.", physicalDeviceName);
 }
@@ -291,15 +535,44 @@ VulkanComputeManager::findQueueFamilies(vk::PhysicalDevice device) {
   std::vector<vk::QueueFamilyProperties> queueFamilies =
       device.getQueueFamilyProperties();
 
-  int i = 0;
-  for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) {
+  const auto has = [](const vk::QueueFamilyProperties &family,
+                      vk::QueueFlags flags) {
+    return (family.queueFlags & flags) == flags;
+  };
+
+  for (uint32_t i = 0; i < queueFamilies.size(); ++i) {
+    const auto &queueFamily = queueFamilies[i];
+    const bool graphics = has(queueFamily, vk::QueueFlagBits::eGraphics);
+    const bool compute = has(queueFamily, vk::QueueFlagBits::eCompute);
+    // Graphics and compute queues support transfer even if the bit isn't set
+    const bool transfer =
+        has(queueFamily, vk::QueueFlagBits::eTransfer) || graphics || compute;
+
+    if (graphics && !indices.graphicsFamily.has_value()) {
       indices.graphicsFamily = i;
     }
-    if (queueFamily.queueFlags & vk::QueueFlagBits::eCompute) {
-      indices.computeFamily = i;
+
+    if (compute) {
+      if (!indices.computeFamily.has_value() ||
+          (graphics &&
+           !has(queueFamilies[indices.computeFamily.value()],
+                vk::QueueFlagBits::eGraphics))) {
+        indices.computeFamily = i;
+      }
+      if (!graphics && !indices.asyncComputeFamily.has_value()) {
+        indices.asyncComputeFamily = i;
+      }
     }
-    i++;
+
+    if (transfer && !graphics && !compute &&
+        !indices.transferFamily.has_value()) {
+      indices.transferFamily = i;
+    }
+  }
+
+  // The main compute family can't double as the async one
+  if (indices.asyncComputeFamily == indices.computeFamily) {
+    indices.asyncComputeFamily.reset();
   }
 
   return indices;
@@ -309,39 +582,139 @@ void VulkanComputeManager::createLogicalDevice() {
   // Specify the queues to be created
   const auto indices = findQueueFamilies(physicalDevice);
 
-  vk::DeviceQueueCreateInfo queueCreateInfo{};
-  if (indices.computeFamily.has_value()) {
-    queueCreateInfo.queueFamilyIndex = indices.computeFamily.value();
-    queueCreateInfo.queueCount = 1;
-  } else {
+  if (!indices.computeFamily.has_value()) {
     const auto msg =
         fmt::format("Compute queue not supported on physical device {}",
                     physicalDeviceName);
     throw std::runtime_error(msg);
   }
 
-  float queuePriority = 1.0F;
-  queueCreateInfo.pQueuePriorities = &queuePriority;
+  // Create up to MAX_QUEUES_PER_FAMILY queues in each family we use
+  const auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+  std::map<uint32_t, uint32_t> queueCounts;
+  for (const auto &family :
+       {indices.computeFamily, indices.asyncComputeFamily,
+        indices.transferFamily}) {
+    if (family.has_value()) {
+      queueCounts[family.value()] = std::min(
+          queueFamilies[family.value()].queueCount, MAX_QUEUES_PER_FAMILY);
+    }
+  }
+
+  const std::vector<float> queuePriorities(MAX_QUEUES_PER_FAMILY, 1.0F);
+  std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
+  for (const auto [family, count] : queueCounts) {
+    queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags(), family, count,
+                                  queuePriorities.data());
+  }
 
   vk::PhysicalDeviceFeatures deviceFeatures{};
 
+  vk::PhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+
+  // Optional: resetting queries from the host, used by the profiler
+  const auto supportedFeatures =
+      physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                  vk::PhysicalDeviceVulkan12Features>();
+  m_hostQueryReset = supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>()
+                         .hostQueryReset == VK_TRUE;
+  vulkan12Features.hostQueryReset = m_hostQueryReset ? VK_TRUE : VK_FALSE;
+
+  // Optional: buffers passed to kernels by address (core in Vulkan 1.2, was
+  // VK_KHR_buffer_device_address), which needs 64 bit integers in shaders
+  m_bufferDeviceAddress =
+      supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>()
+              .bufferDeviceAddress == VK_TRUE &&
+      supportedFeatures.get<vk::PhysicalDeviceFeatures2>()
+              .features.shaderInt64 == VK_TRUE;
+  vulkan12Features.bufferDeviceAddress =
+      m_bufferDeviceAddress ? VK_TRUE : VK_FALSE;
+  deviceFeatures.shaderInt64 = m_bufferDeviceAddress ? VK_TRUE : VK_FALSE;
+
   std::vector<const char *> deviceExtensions;
 #ifdef __APPLE__
   deviceExtensions.push_back("VK_KHR_portability_subset");
 #endif
 
+  // Optional: importing host allocations as device memory
+  const auto availableExtensions =
+      physicalDevice.enumerateDeviceExtensionProperties();
+  m_externalMemoryHost = std::ranges::any_of(
+      availableExtensions, [](const vk::ExtensionProperties &extension) {
+        return std::string_view(extension.extensionName) ==
+               VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME;
+      });
+  if (m_externalMemoryHost) {
+    deviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+    m_minImportedHostPointerAlignment =
+        physicalDevice
+            .getProperties2<vk::PhysicalDeviceProperties2,
+                            vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>()
+            .get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>()
+            .minImportedHostPointerAlignment;
+  }
+
+  // Optional: the driver's memory budget rather than VMA's estimate
+  m_memoryBudget = std::ranges::any_of(
+      availableExtensions, [](const vk::ExtensionProperties &extension) {
+        return std::string_view(extension.extensionName) ==
+               VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+      });
+  if (m_memoryBudget) {
+    deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+
   vk::DeviceCreateInfo createInfo{};
-  createInfo.pQueueCreateInfos = &queueCreateInfo;
-  createInfo.queueCreateInfoCount = 1;
+  createInfo.pNext = &vulkan12Features;
+  createInfo.pQueueCreateInfos = queueCreateInfos.data();
+  createInfo.queueCreateInfoCount =
+      static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pEnabledFeatures = &deviceFeatures;
   createInfo.enabledExtensionCount =
       static_cast<uint32_t>(deviceExtensions.size());
   createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
   device = physicalDevice.createDevice(createInfo);
-  queue = device.getQueue(indices.computeFamily.value(), 0);
+  if (m_externalMemoryHost) {
+    m_getMemoryHostPointerProperties =
+        reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(
+            device.getProcAddr("vkGetMemoryHostPointerPropertiesEXT"));
+    m_externalMemoryHost = m_getMemoryHostPointerProperties != nullptr;
+  }
+  const auto makeQueue = [this](uint32_t family, uint32_t index) {
+    m_queues.push_back(std::make_unique<TimelineQueue>(
+        device, device.getQueue(family, index), family));
+    return m_queues.back().get();
+  };
+
+  queueFamilyIndex = indices.computeFamily.value();
+  m_computeQueue = makeQueue(queueFamilyIndex, 0);
+  queue = m_computeQueue->queue();
+
+  // Async compute: the remaining queues of the compute family, then a
+  // compute-only family
+  for (uint32_t i = 1; i < queueCounts[queueFamilyIndex]; ++i) {
+    m_asyncComputeQueues.push_back(makeQueue(queueFamilyIndex, i));
+  }
+  if (indices.asyncComputeFamily.has_value()) {
+    const auto family = indices.asyncComputeFamily.value();
+    for (uint32_t i = 0; i < queueCounts[family]; ++i) {
+      m_asyncComputeQueues.push_back(makeQueue(family, i));
+    }
+  }
+  if (m_asyncComputeQueues.empty()) {
+    m_asyncComputeQueues.push_back(m_computeQueue);
+  }
+
+  m_transferQueue = indices.transferFamily.has_value()
+                        ? makeQueue(indices.transferFamily.value(), 0)
+                        : m_computeQueue;
 
-  fmt::println("Created Vulkan logical device and compute queue.");
+  fmt::println("Created Vulkan logical device with {} queue(s): compute family "
+               "{}, {} async compute, {} transfer queue.",
+               m_queues.size(), queueFamilyIndex, m_asyncComputeQueues.size(),
+               hasDedicatedTransferQueue() ? "dedicated" : "shared");
 }
 
 void VulkanComputeManager::createVmaAllocator() {
@@ -349,7 +722,13 @@ void VulkanComputeManager::createVmaAllocator() {
   info.physicalDevice = physicalDevice;
   info.device = device;
   info.instance = instance;
-  info.vulkanApiVersion = VK_API_VERSION_1_2;
+  info.vulkanApiVersion = VULKAN_API_VERSION;
+  if (m_memoryBudget) {
+    info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+  }
+  if (m_bufferDeviceAddress) {
+    info.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+  }
 
   vmaCreateAllocator(&info, &m_allocator);
 }
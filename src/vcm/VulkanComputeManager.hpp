@@ -1,16 +1,59 @@
 #pragma once
 
+#include "Buffer.hpp"
+#include "CommandPools.hpp"
+#include "Common.hpp"
+#include "ComputeKernel.hpp"
+#include "DescriptorAllocator.hpp"
+#include "MemoryTracker.hpp"
+#include "PipelineCache.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "Timeline.hpp"
 #include "VmaUsage.hpp"
+#include "WorkgroupTuner.hpp"
 #include <fmt/format.h>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 namespace vcm {
 
+// Vulkan version required of the instance, device, VMA and shaders.
+// 1.2 for timeline semaphores.
+constexpr uint32_t VULKAN_API_VERSION = VK_API_VERSION_1_2;
+
+class HostBuffer;
+
+// Wall clock milliseconds spent in each phase of bringing the manager up
+struct StartupTimings {
+  double instanceMs{};
+  double deviceSelectionMs{};
+  double deviceCreationMs{};
+  double allocatorMs{};
+  // Loading the pipeline cache from disk
+  double pipelineCacheMs{};
+  // Creating pipelines in warmUp(), summed over calls
+  double pipelineCreationMs{};
+  // Benchmarking workgroup sizes of untuned kernels in warmUp()
+  double tuningMs{};
+};
+
 class VulkanComputeManager {
 public:
-  VulkanComputeManager();
+  // Pipeline cache blobs are loaded from and saved to pipelineCacheDir
+  explicit VulkanComputeManager(
+      const fs::path &pipelineCacheDir = defaultPipelineCacheDir());
+  // On the suitable physical device ranked deviceRank, 0 being the best.
+  // Managers with the same rank each get their own logical device.
+  explicit VulkanComputeManager(
+      size_t deviceRank,
+      const fs::path &pipelineCacheDir = defaultPipelineCacheDir());
 
   VulkanComputeManager(const VulkanComputeManager &) = delete;
   VulkanComputeManager(VulkanComputeManager &&) = delete;
@@ -21,22 +64,235 @@ public:
 
   static void printInstanceExtensionSupport();
 
+  static fs::path defaultPipelineCacheDir() {
+    return fs::temp_directory_path() / "vcm";
+  }
+
   [[nodiscard]] auto &get_instance() const { return instance; }
   [[nodiscard]] auto &get_physicalDevice() const { return physicalDevice; }
+  [[nodiscard]] auto &get_physicalDeviceName() const {
+    return physicalDeviceName;
+  }
+  // Physical devices pickable by rank
+  [[nodiscard]] auto get_suitableDeviceCount() const {
+    return m_suitableDeviceCount;
+  }
   [[nodiscard]] auto &get_device() const { return device; }
   [[nodiscard]] auto &get_queue() const { return queue; }
+  [[nodiscard]] auto get_queueFamilyIndex() const { return queueFamilyIndex; }
+  // The compute queue with its timeline. Submit through this rather than
+  // get_queue() when other threads may be submitting.
+  [[nodiscard]] auto &get_computeQueue() const { return *m_computeQueue; }
+
+  // Queue for copies. A queue from a transfer-only family when the device has
+  // one, otherwise the compute queue.
+  [[nodiscard]] auto &get_transferQueue() const { return *m_transferQueue; }
+  [[nodiscard]] bool hasDedicatedTransferQueue() const {
+    return m_transferQueue != m_computeQueue;
+  }
+
+  // Extra compute queues to run independent work concurrently with the main
+  // compute queue. Contains just the compute queue if there are none.
+  [[nodiscard]] std::span<TimelineQueue *const> get_asyncComputeQueues() const {
+    return m_asyncComputeQueues;
+  }
+
+  // Whether host allocations can be imported (VK_EXT_external_memory_host),
+  // and the alignment of pointer and size needed to import one
+  [[nodiscard]] bool supportsHostImport() const { return m_externalMemoryHost; }
+  [[nodiscard]] auto get_minImportedHostPointerAlignment() const {
+    return m_minImportedHostPointerAlignment;
+  }
+
+  // Device buffer over the host allocation, without a copy when it can be
+  // imported and falling back to a staged device copy otherwise; see
+  // HostBuffer (HostImport.hpp). allowImport=false forces the fallback.
+  // An empty host span gives an empty HostBuffer, with no vk::Buffer.
+  [[nodiscard]] HostBuffer
+  importHostMemory(std::span<std::byte> host,
+                   vk::BufferUsageFlags usage =
+                       vk::BufferUsageFlagBits::eStorageBuffer,
+                   bool allowImport = true) const;
 
   [[nodiscard]] auto &get_allocator() const { return m_allocator; }
 
-  [[nodiscard]] auto &get_descriptorPool() const { return descriptorPool; }
+  // Kernels can take buffers by device address, see
+  // ComputeKernel::dispatchAddresses()
+  [[nodiscard]] bool supportsBufferDeviceAddress() const {
+    return m_bufferDeviceAddress;
+  }
+
+  // Typed buffer from the manager's allocator, counted under tag by the
+  // memory tracker, with a device address() if the device supports them.
+  // Cached descriptor sets referring to it are forgotten when it is
+  // destroyed.
+  template <typename T>
+  [[nodiscard]] Buffer<T> createBuffer(size_t count, vk::BufferUsageFlags usage,
+                                       HostAccess access = HostAccess::None,
+                                       std::string_view tag = {}) const {
+    if (m_bufferDeviceAddress) {
+      usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+    return Buffer<T>(m_allocator, count, usage, access,
+                     m_descriptorSets.get(), m_memory.get(), tag);
+  }
+
+  // Replace buffer with a new one of count elements if it holds fewer.
+  // Scratch buffers grown this way and kept between calls are never shrunk,
+  // so repeated calls allocate nothing.
+  template <typename T>
+  void growBuffer(Buffer<T> &buffer, size_t count, vk::BufferUsageFlags usage,
+                  HostAccess access = HostAccess::None,
+                  std::string_view tag = {}) const {
+    if (buffer.size() < count) {
+      buffer = createBuffer<T>(count, usage, access, tag);
+    }
+  }
+
+  // Per heap usage and budget, per tag allocations and the soft limit
+  [[nodiscard]] auto &get_memoryTracker() const { return *m_memory; }
+
+  [[nodiscard]] auto get_pipelineCache() const {
+    return m_pipelineCache->get();
+  }
+  [[nodiscard]] auto &get_pipelineCacheManager() const {
+    return *m_pipelineCache;
+  }
+
   [[nodiscard]] auto &get_commandPool() const { return commandPool; }
 
+  // GPU timestamp profiler. Dispatches and copies recorded through the
+  // library are timed while it is enabled.
+  [[nodiscard]] auto &get_profiler() const { return *m_profiler; }
+
+  // Enable or disable profiling at runtime. Enabling (re)calibrates the GPU
+  // clock of each queue family in use against the host clock, which waits
+  // for a small submission on each.
+  void setProfiling(bool enabled) {
+    m_profiler->setEnabled(enabled);
+    if (m_profiler->enabled()) {
+      calibrateProfiler();
+    }
+  }
+
+  // Descriptor sets shared by all kernels' bind(). Call forget() on it before
+  // destroying a buffer that was bound.
+  [[nodiscard]] auto &get_descriptorSetCache() const {
+    return *m_descriptorSets;
+  }
+
+  // Descriptor set from the per-frame allocator. Valid until
+  // resetDescriptorPools().
+  vk::DescriptorSet allocateDescriptorSet(vk::DescriptorSetLayout layout) {
+    return m_frameDescriptors->allocate(layout);
+  }
+
+  // Recycle all descriptor sets from allocateDescriptorSet(), e.g. once per
+  // frame. None of them may still be in use by the GPU.
+  void resetDescriptorPools() { m_frameDescriptors->reset(); }
+
+  // Get a compute kernel, creating its pipeline on first use.
+  // Kernels are cached by SPIR-V hash and live as long as the manager.
+  // Element-wise kernels come back with their workgroup size tuned for this
+  // device, see WorkgroupTuner.
+  // With dynamicOffsets, storage buffers are bound as dynamic descriptors,
+  // see ComputeKernel.
+  ComputeKernel &getKernel(std::span<const uint32_t> spirv,
+                           const char *entryPoint = "Main",
+                           bool dynamicOffsets = false);
+  ComputeKernel &getKernel(const std::string &shaderFileName,
+                           const char *entryPoint = "Main",
+                           bool dynamicOffsets = false);
+
+  // Get the kernels of shaderFileNames, creating their pipelines in parallel
+  // on the worker threads, e.g. at startup before taking work so later
+  // getKernel() calls are lookups. Pipelines are created against the
+  // manager's pipeline cache, which Vulkan synchronizes internally.
+  std::vector<ComputeKernel *>
+  warmUp(std::span<const std::string> shaderFileNames,
+         const char *entryPoint = "Main");
+
+  [[nodiscard]] auto &get_startupTimings() const { return m_startup; }
+
+  [[nodiscard]] auto &get_workgroupTuner() const { return *m_tuner; }
+
+  // Shader modules shared by all kernels created with it, one per SPIR-V
+  [[nodiscard]] auto &get_shaderModuleCache() const { return *m_shaderModules; }
+
+  // Submit to the compute queue without blocking. The returned ticket
+  // completes when the GPU has finished the command buffers; waitFor chains
+  // this submission after others.
+  Ticket submitAsync(std::span<const vk::CommandBuffer> commandBuffers,
+                     std::span<const Ticket> waitFor = {}) const {
+    return m_computeQueue->submit(commandBuffers, waitFor);
+  }
+  Ticket submitAsync(vk::CommandBuffer commandBuffer,
+                     std::span<const Ticket> waitFor = {}) const {
+    return m_computeQueue->submit(commandBuffer, waitFor);
+  }
+
+  // Command buffer for the compute queue from the calling thread's own
+  // command pool. Valid until resetCommandPools().
+  vk::CommandBuffer allocateCommandBuffer(
+      vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary) {
+    return m_threadCommandPools->allocate(level);
+  }
+
+  // Recycle all command buffers from allocateCommandBuffer(), e.g. once per
+  // frame. None of them may still be pending on the GPU.
+  void resetCommandPools() { m_threadCommandPools->reset(); }
+
+  // Records one task into a secondary command buffer
+  using RecordTask =
+      std::function<void(vk::CommandBuffer secondary, size_t task)>;
+
+  // Record taskCount secondary command buffers in parallel on the worker
+  // threads and execute them, in task order, from primary.
+  void recordParallel(vk::CommandBuffer primary, size_t taskCount,
+                      const RecordTask &record);
+
+  // Worker threads shared by the manager's parallel APIs, created on first
+  // use
+  ThreadPool &get_workers();
+
+  // One time submit command buffer for the compute queue, in the recording
+  // state. Reuses command buffers whose earlier submission has completed.
+  [[nodiscard]] vk::CommandBuffer beginOneTimeCommands() const {
+    return m_oneTimeCommands->begin();
+  }
+
+  // End and submit a command buffer from beginOneTimeCommands(). It is
+  // recycled once the returned ticket completes.
+  Ticket submitOneTime(vk::CommandBuffer commandBuffer,
+                       std::span<const Ticket> waitFor = {}) const {
+    return submitOneTime(*m_computeQueue, *m_oneTimeCommands, commandBuffer,
+                         waitFor);
+  }
+
+  // Command buffer allocations vs reuses by the one time command paths
+  // (beginOneTimeCommands and copies), summed over queue families
+  [[nodiscard]] CommandBufferRecycler::Stats get_commandBufferStats() const {
+    const auto compute = m_oneTimeCommands->stats();
+    const auto transfer = m_transferOneTimeCommands->stats();
+    return {compute.allocations + transfer.allocations,
+            compute.reuses + transfer.reuses};
+  }
+
   // If commandBuffer is provided, use it and only record
-  // else allocate a temporary command buffer
+  // else run the copy on the transfer queue and wait for it, moving ownership
+  // of both buffers between the compute and transfer families. Buffers are
+  // owned by the compute family before and after.
   void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer,
                   vk::DeviceSize size,
                   vk::CommandBuffer commandBuffer = nullptr) const;
 
+  // copyBuffer on the transfer queue without waiting. The copy starts after
+  // waitFor; the returned ticket completes once dstBuffer is usable on the
+  // compute queue.
+  Ticket copyBufferAsync(vk::Buffer srcBuffer, vk::Buffer dstBuffer,
+                         vk::DeviceSize size,
+                         std::span<const Ticket> waitFor = {}) const;
+
 private:
   // QVulkanInstance vulkanInstance;
   vk::Instance instance;
@@ -44,28 +300,76 @@ private:
   // Physical device
   vk::PhysicalDevice physicalDevice;
   std::string physicalDeviceName;
+  size_t m_suitableDeviceCount{};
 
   // Logical device
   vk::Device device;
 
   // Compute queue
   vk::Queue queue;
+  uint32_t queueFamilyIndex{};
+
+  // All queues created with the device. The pointers below point into it.
+  std::vector<std::unique_ptr<TimelineQueue>> m_queues;
+  TimelineQueue *m_computeQueue{};
+  TimelineQueue *m_transferQueue{};
+  std::vector<TimelineQueue *> m_asyncComputeQueues;
+
+  // Upper bound on queues created per family
+  static constexpr uint32_t MAX_QUEUES_PER_FAMILY = 4;
 
   // Vulkan memory allocator
   VmaAllocator m_allocator;
+  // VK_EXT_memory_budget is enabled
+  bool m_memoryBudget{false};
+  std::unique_ptr<MemoryTracker> m_memory;
+
+  // Pipeline cache persisted across runs
+  std::unique_ptr<PipelineCache> m_pipelineCache;
 
   // Command pool
   // Manage the memory that is used to store the buffers and command buffers are
   // allocated from them
-  // Command pool should be thread local
+  // Only used from the thread that owns the manager; other threads record
+  // through m_threadCommandPools.
   vk::CommandPool commandPool;
 
+  // Thread local command pools for the compute family
+  std::unique_ptr<CommandPoolRegistry> m_threadCommandPools;
+
+  std::mutex m_workersMutex;
+  std::unique_ptr<ThreadPool> m_workers;
+
+  // Recycled one time command buffers for the compute and transfer queues
+  std::unique_ptr<CommandBufferRecycler> m_oneTimeCommands;
+  std::unique_ptr<CommandBufferRecycler> m_transferOneTimeCommands;
+
   // Command buffer
   vk::CommandBuffer commandBuffer;
 
-  // Descriptor pool
-  // Discriptor sets for buffers are allocated from this
-  vk::DescriptorPool descriptorPool;
+  // Descriptor sets
+  // Long lived, cached sets for kernels' bind()
+  std::unique_ptr<DescriptorSetCache> m_descriptorSets;
+  // Short lived sets, recycled a whole pool at a time
+  std::unique_ptr<DescriptorAllocator> m_frameDescriptors;
+
+  // VK_EXT_external_memory_host is enabled
+  bool m_externalMemoryHost{false};
+  vk::DeviceSize m_minImportedHostPointerAlignment{0};
+  PFN_vkGetMemoryHostPointerPropertiesEXT m_getMemoryHostPointerProperties{};
+
+  // Device supports resetting queries from the host
+  bool m_hostQueryReset{false};
+  // bufferDeviceAddress and shaderInt64 are enabled
+  bool m_bufferDeviceAddress{false};
+  std::unique_ptr<Profiler> m_profiler;
+
+  // Compute kernels created through getKernel, and their shader modules
+  std::unique_ptr<ShaderModuleCache> m_shaderModules;
+  std::unique_ptr<KernelCache> m_kernels;
+  std::unique_ptr<WorkgroupTuner> m_tuner;
+
+  StartupTimings m_startup;
 
   static constexpr std::array<const char *, 1> validationLayers = {
       {"VK_LAYER_KHRONOS_validation"}};
@@ -82,12 +386,17 @@ private:
 
   /* Find physical device */
   // Select a graphics card in the system that supports the features we need.
-  // Stick to the first suitable card we find.
-  void pickPhysicalDevice();
+  // Cards are ranked by rateDeviceSuitability, ties in enumeration order.
+  void pickPhysicalDevice(size_t rank);
   static int rateDeviceSuitability(vk::PhysicalDevice device);
   struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
+    // Main compute family. Prefers a family that also supports graphics.
     std::optional<uint32_t> computeFamily;
+    // Compute but no graphics, distinct from computeFamily
+    std::optional<uint32_t> asyncComputeFamily;
+    // Transfer only, no graphics or compute
+    std::optional<uint32_t> transferFamily;
   };
   static QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice device);
 
@@ -103,34 +412,22 @@ private:
   /* Create command buffer */
   void createCommandBuffer();
 
-  [[nodiscard]] vk::CommandBuffer beginTempOneTimeCommandBuffer() const {
-    vk::CommandBufferAllocateInfo allocInfo{};
-    allocInfo.level = vk::CommandBufferLevel::ePrimary;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
+  // Calibrate the profiler on the compute queue, and on the transfer queue
+  // if it is of another family
+  void calibrateProfiler();
 
-    auto commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
-
-    // Immediately start recording the command buffer
-    vk::CommandBufferBeginInfo beginInfo{};
-    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-    commandBuffer.begin(beginInfo);
-    return commandBuffer;
-  }
-
-  void endOneTimeCommandBuffer(vk::CommandBuffer commandBuffer) const {
+  static Ticket submitOneTime(TimelineQueue &queue,
+                              CommandBufferRecycler &recycler,
+                              vk::CommandBuffer commandBuffer,
+                              std::span<const Ticket> waitFor) {
     commandBuffer.end();
-
-    vk::SubmitInfo submitInfo{};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    queue.submit(submitInfo);
-    queue.waitIdle();
+    const auto ticket = queue.submit(commandBuffer, waitFor);
+    recycler.recycle(commandBuffer, ticket);
+    return ticket;
   }
 
-  /* Create descriptor pool */
-  void createDescriptorPool();
+  /* Create descriptor allocators */
+  void createDescriptorAllocators();
 
   /* Create buffers */
   [[nodiscard]] uint32_t
@@ -171,4 +468,60 @@ inline void memoryBarrierComputeThenTransfer(vk::CommandBuffer &commandBuffer) {
       {}, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
 
+// Insert a memory barrier to wait for a compute shader's writes before the
+// next compute shader reads them
+inline void memoryBarrierComputeThenCompute(vk::CommandBuffer &commandBuffer) {
+  vk::MemoryBarrier memoryBarrier{};
+  memoryBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+  memoryBarrier.dstAccessMask =
+      vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eComputeShader, {},
+                                1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+// Insert a memory barrier making compute shader writes visible to the host
+// once the submission completes, for buffers the host reads directly
+inline void memoryBarrierComputeThenHost(vk::CommandBuffer &commandBuffer) {
+  vk::MemoryBarrier memoryBarrier{};
+  memoryBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+  memoryBarrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eHost, {}, 1,
+                                &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+// Release a buffer range from srcFamily to dstFamily. Record on a command
+// buffer submitted to a queue of srcFamily, followed by the matching acquire on
+// a queue of dstFamily that waits for it.
+inline void releaseBufferOwnership(vk::CommandBuffer commandBuffer,
+                                   vk::Buffer buffer, uint32_t srcFamily,
+                                   uint32_t dstFamily,
+                                   vk::PipelineStageFlags srcStage,
+                                   vk::AccessFlags srcAccess,
+                                   vk::DeviceSize offset = 0,
+                                   vk::DeviceSize size = vk::WholeSize) {
+  const vk::BufferMemoryBarrier barrier{
+      srcAccess, {}, srcFamily, dstFamily, buffer, offset, size};
+  commandBuffer.pipelineBarrier(srcStage,
+                                vk::PipelineStageFlagBits::eBottomOfPipe, {},
+                                nullptr, barrier, nullptr);
+}
+
+// Acquire a buffer range released by releaseBufferOwnership
+inline void acquireBufferOwnership(vk::CommandBuffer commandBuffer,
+                                   vk::Buffer buffer, uint32_t srcFamily,
+                                   uint32_t dstFamily,
+                                   vk::PipelineStageFlags dstStage,
+                                   vk::AccessFlags dstAccess,
+                                   vk::DeviceSize offset = 0,
+                                   vk::DeviceSize size = vk::WholeSize) {
+  const vk::BufferMemoryBarrier barrier{
+      {}, dstAccess, srcFamily, dstFamily, buffer, offset, size};
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                                dstStage, {}, nullptr, barrier, nullptr);
+}
+
 } // namespace vcm
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "WorkgroupTuner.hpp"
+#include "Buffer.hpp"
+#include "VulkanComputeManager.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <sstream>
+#include <string_view>
+
+namespace vcm {
+
+namespace {
+
+// Elements per tuning dispatch, enough to fill a large GPU
+constexpr uint64_t TUNING_ELEMENTS = 1 << 20;
+// Scratch bytes per element, room for a float4/int4 per thread
+constexpr vk::DeviceSize MAX_ELEMENT_BYTES = 16;
+// Dispatches per timed submission, so submit overhead does not dominate
+constexpr int DISPATCHES_PER_RUN = 8;
+// Timed runs per candidate, the fastest counts
+constexpr int RUNS = 3;
+// Upper bound on candidates even if the device allows more
+constexpr uint32_t MAX_CANDIDATE = 1024;
+
+// Scratch storage buffers for one tuning run, one per binding
+class ScratchBuffers {
+public:
+  ScratchBuffers(VulkanComputeManager &manager, size_t count,
+                 vk::DeviceSize bytes)
+      : m_manager(manager) {
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.size = bytes;
+    bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer |
+                       vk::BufferUsageFlagBits::eTransferDst;
+    bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    for (size_t i = 0; i < count; ++i) {
+      m_buffers.emplace_back(manager.get_allocator(), bufferInfo, allocInfo);
+      if (m_buffers.back().buffer == VK_NULL_HANDLE) {
+        m_buffers.pop_back();
+        return;
+      }
+      m_infos.emplace_back(m_buffers.back().buffer, 0, vk::WholeSize);
+    }
+  }
+
+  ScratchBuffers(const ScratchBuffers &) = delete;
+  ScratchBuffers(ScratchBuffers &&) = delete;
+  ScratchBuffers &operator=(const ScratchBuffers &) = delete;
+  ScratchBuffers &operator=(ScratchBuffers &&) = delete;
+
+  ~ScratchBuffers() {
+    for (auto &buffer : m_buffers) {
+      m_manager.get_descriptorSetCache().forget(buffer.buffer);
+      buffer.destroy(m_manager.get_allocator());
+    }
+  }
+
+  [[nodiscard]] auto &infos() const { return m_infos; }
+
+private:
+  VulkanComputeManager &m_manager;
+  std::vector<VcmBuffer> m_buffers;
+  std::vector<vk::DescriptorBufferInfo> m_infos;
+};
+
+} // namespace
+
+WorkgroupTuner::WorkgroupTuner(VulkanComputeManager &manager,
+                               const fs::path &cacheDir)
+    : m_manager(manager) {
+  const auto physicalDevice = m_manager.get_physicalDevice();
+  const auto properties =
+      physicalDevice.getProperties2<vk::PhysicalDeviceProperties2,
+                                    vk::PhysicalDeviceSubgroupProperties>();
+  const auto &deviceProperties =
+      properties.get<vk::PhysicalDeviceProperties2>().properties;
+  const auto &limits = deviceProperties.limits;
+  const auto subgroupSize =
+      std::max(1U, properties.get<vk::PhysicalDeviceSubgroupProperties>()
+                       .subgroupSize);
+
+  m_path = cacheDir / fmt::format("workgroup_sizes_{:04x}_{:04x}.txt",
+                                  deviceProperties.vendorID,
+                                  deviceProperties.deviceID);
+  m_driverVersion = deviceProperties.driverVersion;
+
+  // Whole subgroups only; smaller groups leave lanes idle
+  const auto maxSize =
+      std::min({limits.maxComputeWorkGroupSize[0],
+                limits.maxComputeWorkGroupInvocations, MAX_CANDIDATE});
+  for (auto size = subgroupSize; size <= maxSize; size *= 2) {
+    m_candidates.push_back(size);
+  }
+
+  // NOLINTNEXTLINE(concurrency-mt-unsafe)
+  if (const char *env = std::getenv("VCM_AUTOTUNE");
+      (env != nullptr && std::string_view(env) == "0") ||
+      m_candidates.empty()) {
+    m_enabled = false;
+    return;
+  }
+
+  load();
+}
+
+bool WorkgroupTuner::tunable(const ComputeKernel &kernel) {
+  const auto &reflection = kernel.reflection();
+  // Kernels without bindings take buffer addresses in push constants,
+  // which the tuner cannot fill
+  return kernel.specializable() && reflection.localSize[1] == 1 &&
+         reflection.localSize[2] == 1 && !reflection.bindings.empty() &&
+         reflection.pushConstantSize >= sizeof(uint32_t) &&
+         std::ranges::all_of(reflection.bindings, [](const auto &binding) {
+           return binding.type == vk::DescriptorType::eStorageBuffer &&
+                  binding.count == 1;
+         });
+}
+
+void WorkgroupTuner::apply(ComputeKernel &kernel) {
+  if (!m_enabled) {
+    return;
+  }
+
+  std::unique_lock lock(m_mutex);
+  const auto hash = kernel.hash();
+  if (m_skipped.contains(hash)) {
+    return;
+  }
+  if (const auto it = m_sizes.find(hash); it != m_sizes.end()) {
+    // The pipeline is created unlocked, so already tuned kernels get theirs
+    // in parallel
+    const auto size = it->second.size;
+    lock.unlock();
+    kernel.setWorkgroupSize(size);
+    return;
+  }
+  if (!tunable(kernel)) {
+    m_skipped.insert(hash);
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto size = benchmark(kernel);
+  m_tuningMs += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  if (size == 0) {
+    // Could not run the benchmark; keep the default and try next run
+    m_skipped.insert(hash);
+    return;
+  }
+  kernel.setWorkgroupSize(size);
+  m_sizes.emplace(hash, Entry{size, kernel.name()});
+
+  try {
+    save();
+  } catch (const std::exception &e) {
+    fmt::println("Failed to save workgroup sizes: {}", e.what());
+  }
+}
+
+double WorkgroupTuner::tuningMs() const {
+  std::scoped_lock lock(m_mutex);
+  return m_tuningMs;
+}
+
+uint32_t WorkgroupTuner::benchmark(ComputeKernel &kernel) {
+  const auto limits = m_manager.get_physicalDevice().getProperties().limits;
+
+  // Every candidate's grid must fit maxComputeWorkGroupCount
+  const auto elements = static_cast<uint32_t>(
+      std::min(TUNING_ELEMENTS, uint64_t{m_candidates.front()} *
+                                    limits.maxComputeWorkGroupCount[0]));
+
+  const ScratchBuffers buffers(m_manager, kernel.reflection().bindings.size(),
+                               vk::DeviceSize{elements} * MAX_ELEMENT_BYTES);
+  if (buffers.infos().size() != kernel.reflection().bindings.size()) {
+    return 0;
+  }
+  const auto descriptorSet = kernel.bind(
+      std::span<const vk::DescriptorBufferInfo>(buffers.infos()));
+
+  // Defined contents, so float kernels do not run on NaNs or denormals
+  {
+    auto commandBuffer = m_manager.beginOneTimeCommands();
+    for (const auto &info : buffers.infos()) {
+      commandBuffer.fillBuffer(info.buffer, 0, vk::WholeSize, 0);
+    }
+    memoryBarrierTransferThenCompute(commandBuffer);
+    m_manager.submitOneTime(commandBuffer).wait();
+  }
+
+  // Microseconds for DISPATCHES_PER_RUN back to back dispatches
+  const auto run = [&] {
+    auto commandBuffer = m_manager.beginOneTimeCommands();
+    for (int i = 0; i < DISPATCHES_PER_RUN; ++i) {
+      if (i > 0) {
+        memoryBarrierComputeThenCompute(commandBuffer);
+      }
+      kernel.dispatchElements(commandBuffer, descriptorSet, elements);
+    }
+    return 1e6 *
+           secondsOf([&] { m_manager.submitOneTime(commandBuffer).wait(); });
+  };
+
+  const auto defaultSize = kernel.workgroupSize()[0];
+  double defaultTime = 0.0;
+  uint32_t best = 0;
+  double bestTime = std::numeric_limits<double>::max();
+  for (const auto size : m_candidates) {
+    kernel.setWorkgroupSize(size);
+    const auto time = fastestOf(RUNS, run);
+    if (time < bestTime) {
+      best = size;
+      bestTime = time;
+    }
+    if (size == defaultSize) {
+      defaultTime = time;
+    }
+  }
+  kernel.setWorkgroupSize(defaultSize);
+
+  fmt::println("-- Tuned workgroup size of '{}': {} ({:.1f} us){}",
+               kernel.name(), best, bestTime,
+               defaultTime > 0.0
+                   ? fmt::format(", default {} ({:.1f} us)", defaultSize,
+                                 defaultTime)
+                   : "");
+  return best;
+}
+
+void WorkgroupTuner::load() {
+  std::ifstream file(m_path);
+  if (!file.is_open()) {
+    return;
+  }
+
+  // First line: driver <version>. Results from another driver are stale.
+  std::string line;
+  uint32_t driverVersion = 0;
+  if (!std::getline(file, line) ||
+      std::sscanf(line.c_str(), "driver %u", &driverVersion) != 1 || // NOLINT
+      driverVersion != m_driverVersion) {
+    fmt::println("Discarding workgroup sizes '{}': driver mismatch.",
+                 m_path.string());
+    return;
+  }
+
+  // Then: <hash> <size> <name>
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    uint64_t hash = 0;
+    uint32_t size = 0;
+    std::string name;
+    if (fields >> std::hex >> hash >> std::dec >> size &&
+        std::ranges::find(m_candidates, size) != m_candidates.end()) {
+      std::getline(fields >> std::ws, name);
+      m_sizes.insert_or_assign(hash, Entry{size, std::move(name)});
+    }
+  }
+  fmt::println("Loaded {} workgroup sizes from '{}'.", m_sizes.size(),
+               m_path.string());
+}
+
+void WorkgroupTuner::save() const {
+  writeFileAtomically(m_path, [&](std::ostream &file) {
+    file << fmt::format("driver {}\n", m_driverVersion);
+    for (const auto &[hash, entry] : m_sizes) {
+      file << fmt::format("{:016x} {} {}\n", hash, entry.size, entry.name);
+    }
+  });
+}
+
+} // namespace vcm
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Common.hpp"
+#include "ComputeKernel.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vcm {
+
+class VulkanComputeManager;
+
+/*
+Per-device workgroup size autotuner for element-wise kernels.
+
+The first time a kernel is seen on a device, each candidate X size (the
+subgroup size times powers of two, within maxComputeWorkGroupSize and
+maxComputeWorkGroupInvocations) is timed on a scratch dispatch and the fastest
+is kept. Winners are stored per kernel hash in a small text file next to the
+pipeline cache, keyed by vendor and device ID and invalidated by a driver
+update, so later runs only pay for creating the winning pipeline.
+
+Only kernels following the element-wise contract are tuned: specializable,
+1D, every binding a storage buffer, and the element count as the first push
+constant. Others keep the shader's [numthreads].
+
+Set VCM_AUTOTUNE=0 to disable tuning and keep every kernel's own size.
+*/
+class WorkgroupTuner {
+public:
+  WorkgroupTuner(VulkanComputeManager &manager, const fs::path &cacheDir);
+
+  WorkgroupTuner(const WorkgroupTuner &) = delete;
+  WorkgroupTuner(WorkgroupTuner &&) = delete;
+  WorkgroupTuner &operator=(const WorkgroupTuner &) = delete;
+  WorkgroupTuner &operator=(WorkgroupTuner &&) = delete;
+
+  ~WorkgroupTuner() = default;
+
+  [[nodiscard]] bool enabled() const { return m_enabled; }
+  [[nodiscard]] auto &path() const { return m_path; }
+  // Workgroup sizes tried, smallest first
+  [[nodiscard]] auto &candidates() const { return m_candidates; }
+
+  // Set kernel's workgroup size to the tuned one, benchmarking the
+  // candidates first if it was never tuned on this device. Blocks other
+  // callers while benchmarking. The manager's KernelCache applies each
+  // kernel once, before it is shared.
+  void apply(ComputeKernel &kernel);
+
+  // Time spent benchmarking so far
+  [[nodiscard]] double tuningMs() const;
+
+  // Whether kernel follows the element-wise contract
+  [[nodiscard]] static bool tunable(const ComputeKernel &kernel);
+
+private:
+  VulkanComputeManager &m_manager;
+  fs::path m_path;
+  uint32_t m_driverVersion;
+  std::vector<uint32_t> m_candidates;
+  bool m_enabled{true};
+
+  struct Entry {
+    uint32_t size;
+    std::string name;
+  };
+
+  mutable std::mutex m_mutex;
+  double m_tuningMs{0.0};
+  // Tuned size by kernel hash
+  std::unordered_map<uint64_t, Entry> m_sizes;
+  // Kernels seen that are not tunable
+  std::unordered_set<uint64_t> m_skipped;
+
+  // Fastest candidate for kernel
+  uint32_t benchmark(ComputeKernel &kernel);
+
+  void load();
+  void save() const;
+};
+
+} // namespace vcm